@@ -77,6 +77,10 @@ static const T_CONFIG_TABLE xmame_options[] = {
 
     {364, "pcmbufsize", X_INT, &g_pcm_bufsize, 10, 1000, nullptr, OPT_SAVE},
 
+    {367, "soundthread", X_FIX, &use_sound_thread, true, 0, nullptr, OPT_SAVE},
+    {367, "nosoundthread", X_FIX, &use_sound_thread, false, 0, nullptr, OPT_SAVE},
+    {368, "resample", X_INT, &resample_quality, 0, 3, nullptr, OPT_SAVE},
+
     /* 終端 */
     {0, nullptr, X_INV, 0, 0, 0, nullptr, nullptr},
 };
@@ -116,7 +120,10 @@ void xmame_config_show_option(void) {
                   "    -samplevol <level>      Set SAMPLE level to <level> %%, (0 - 100) [100]\n"
                   "    -samplefreq <rate>      Set the playback sample-frequency/rate [44100]\n"
                   "    -[no]samples            Use/don't use samples (if available) [-nosamples]\n"
-                  "    -pcmbufsize <n>         Set sound-buffer-size to <n> ms (10 - 1000) [100]\n");
+                  "    -pcmbufsize <n>         Set sound-buffer-size to <n> ms (10 - 1000) [100]\n"
+                  "    -[no]soundthread        Render sound in a worker thread (1 frame latency)\n"
+                  "                                                          [-nosoundthread]\n"
+                  "    -resample <i>           Resampler quality (0:linear, 1 - 3:FIR) [1]\n");
 }
 
 /******************************************************************************
@@ -6,6 +6,7 @@ extern "C" {
 
 #include "device.h"
 #include "file-op.h"
+#include "hash-log.h"
 #include "initval.h"
 #include "keyboard.h"
 #include "memory.h"
@@ -77,7 +78,10 @@ void GVRAMWriter(size_t nOffs, unsigned char nVal) { ByteWriter(main_vram[nOffs
 #if RA_ENABLE_EXTRAM
 unsigned char ExtRAMReader(size_t nOffs) { return ByteReader((byte *)ext_ram, nOffs); }
 
-void ExtRAMWriter(size_t nOffs, unsigned char nVal) { ByteWriter((byte *)ext_ram, nOffs, nVal); }
+void ExtRAMWriter(size_t nOffs, unsigned char nVal) {
+  ByteWriter((byte *)ext_ram, nOffs, nVal);
+  hash_log_ext_ram_changed();
+}
 #endif
 
 int GetMenuItemIndex(HMENU hMenu, const char *ItemName) {
@@ -0,0 +1,388 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include "archive.h"
+
+#include "Core/Log.h"
+#include "lodepng.h"
+
+namespace {
+
+/* Prefetched archives kept for archive_extract(), oldest first */
+constexpr size_t PREFETCH_MAX = 4;
+
+uint16_t get16(const unsigned char *p) { return p[0] | (p[1] << 8); }
+uint32_t get32(const unsigned char *p) { return get16(p) | ((uint32_t)get16(p + 2) << 16); }
+
+uint32_t crc32(const unsigned char *p, size_t size) {
+  static const auto table = [] {
+    std::vector<uint32_t> t(256);
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++) {
+        c = (c & 1) ? (0xedb88320 ^ (c >> 1)) : (c >> 1);
+      }
+      t[i] = c;
+    }
+    return t;
+  }();
+
+  uint32_t c = 0xffffffff;
+  while (size--) {
+    c = table[(c ^ *p++) & 0xff] ^ (c >> 8);
+  }
+  return c ^ 0xffffffff;
+}
+
+std::string full_path(const char *path) {
+  std::error_code ec;
+  std::filesystem::path p = std::filesystem::absolute(path, ec);
+  return ec ? std::string(path) : p.string();
+}
+
+bool has_extension(const std::string &name, const char *ext) {
+  size_t len = strlen(ext);
+  if (name.size() < len) {
+    return false;
+  }
+  for (size_t i = 0; i < len; i++) {
+    if (tolower((unsigned char)name[name.size() - len + i]) != ext[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool read_file(const std::string &path, std::vector<unsigned char> &buf) {
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (fp == nullptr) {
+    return false;
+  }
+  bool ok = false;
+  long size;
+  if (fseek(fp, 0, SEEK_END) == 0 && (size = ftell(fp)) >= 0 && fseek(fp, 0, SEEK_SET) == 0) {
+    try {
+      buf.resize(size);
+      ok = (fread(buf.data(), 1, size, fp) == (size_t)size);
+    } catch (const std::bad_alloc &) {
+      ok = false;
+    }
+  }
+  fclose(fp);
+  return ok;
+}
+
+/* Raw deflate stream, checked against the stored size and CRC */
+bool inflate_check(const unsigned char *in, size_t size, uint32_t crc, uint32_t length,
+                   std::vector<unsigned char> &out) {
+  unsigned char *buf = nullptr;
+  size_t buf_size = 0;
+
+  if (lodepng_inflate(&buf, &buf_size, in, size, &lodepng_default_decompress_settings) != 0) {
+    free(buf);
+    return false;
+  }
+  bool ok = ((uint32_t)buf_size == length && crc32(buf, buf_size) == crc);
+  if (ok) {
+    try {
+      out.assign(buf, buf + buf_size);
+    } catch (const std::bad_alloc &) {
+      ok = false;
+    }
+  }
+  free(buf);
+  return ok;
+}
+
+/* RFC 1952. Only the first member of the file is used */
+bool extract_gzip(const std::vector<unsigned char> &src, std::vector<unsigned char> &out) {
+  enum { FHCRC = 0x02, FEXTRA = 0x04, FNAME = 0x08, FCOMMENT = 0x10 };
+
+  size_t size = src.size();
+  const unsigned char *p = src.data();
+  if (size < 18 || p[0] != 0x1f || p[1] != 0x8b || p[2] != 8) {
+    return false;
+  }
+  int flags = p[3];
+  size_t pos = 10;
+  if (flags & FEXTRA) {
+    pos += 2 + get16(&p[pos]);
+  }
+  for (int flag : {FNAME, FCOMMENT}) {
+    if (flags & flag) {
+      while (pos < size && p[pos] != 0) {
+        pos++;
+      }
+      pos++;
+    }
+  }
+  if (flags & FHCRC) {
+    pos += 2;
+  }
+  if (pos + 8 > size) {
+    return false;
+  }
+  return inflate_check(&p[pos], size - 8 - pos, get32(&p[size - 8]), get32(&p[size - 4]), out);
+}
+
+/* PKZIP, stored or deflated entries (no ZIP64) */
+bool extract_zip(const std::vector<unsigned char> &src, std::vector<unsigned char> &out) {
+  static const char *const disk_ext[] = {".d88", ".d77", ".88d", ".d8u", ".d68"};
+
+  size_t size = src.size();
+  const unsigned char *p = src.data();
+  if (size < 22) {
+    return false;
+  }
+
+  /* End of central directory record, followed by a comment of up to 64KB */
+  size_t eocd = size - 22;
+  size_t limit = (size > 22 + 0xffff) ? size - 22 - 0xffff : 0;
+  while (get32(&p[eocd]) != 0x06054b50) {
+    if (eocd == limit) {
+      return false;
+    }
+    eocd--;
+  }
+
+  int nr_entry = get16(&p[eocd + 10]);
+  size_t pos = get32(&p[eocd + 16]);
+  const unsigned char *entry = nullptr;
+
+  for (int i = 0; i < nr_entry; i++) {
+    if (pos + 46 > size || get32(&p[pos]) != 0x02014b50) {
+      return false;
+    }
+    size_t name_len = get16(&p[pos + 28]);
+    if (pos + 46 + name_len > size) {
+      return false;
+    }
+    std::string name((const char *)&p[pos + 46], name_len);
+
+    if (!name.empty() && name.back() != '/') {
+      bool is_disk = std::any_of(std::begin(disk_ext), std::end(disk_ext),
+                                 [&](const char *ext) { return has_extension(name, ext); });
+      if (entry == nullptr || is_disk) {
+        entry = &p[pos];
+      }
+      if (is_disk) {
+        break;
+      }
+    }
+    pos += 46 + name_len + get16(&p[pos + 30]) + get16(&p[pos + 32]);
+  }
+  if (entry == nullptr) {
+    return false;
+  }
+
+  int method = get16(&entry[10]);
+  uint32_t crc = get32(&entry[16]);
+  size_t comp_size = get32(&entry[20]);
+  uint32_t length = get32(&entry[24]);
+  size_t local = get32(&entry[42]);
+
+  if (local + 30 > size || get32(&p[local]) != 0x04034b50) {
+    return false;
+  }
+  size_t data = local + 30 + get16(&p[local + 26]) + get16(&p[local + 28]);
+  if (data > size || comp_size > size - data) {
+    return false;
+  }
+
+  switch (method) {
+  case 0: /* stored */
+    if (comp_size != length || crc32(&p[data], comp_size) != crc) {
+      return false;
+    }
+    try {
+      out.assign(&p[data], &p[data] + comp_size);
+    } catch (const std::bad_alloc &) {
+      return false;
+    }
+    return true;
+
+  case 8: /* deflated */
+    return inflate_check(&p[data], comp_size, crc, length, out);
+
+  default:
+    return false;
+  }
+}
+
+bool extract_file(const std::string &path, std::vector<unsigned char> &out) {
+  std::vector<unsigned char> src;
+  if (!read_file(path, src)) {
+    return false;
+  }
+  if (has_extension(path, ".zip")) {
+    return extract_zip(src, out);
+  }
+  return extract_gzip(src, out);
+}
+
+std::filesystem::file_time_type modified_time(const std::string &path) {
+  std::error_code ec;
+  auto t = std::filesystem::last_write_time(path, ec);
+  return ec ? std::filesystem::file_time_type::min() : t;
+}
+
+/*
+ * Expands archives on one worker thread. Only the latest request waits for
+ * the worker: moving through a list of archives in the file selector
+ * replaces the waiting request instead of starting more expansions.
+ */
+class Prefetcher {
+public:
+  ~Prefetcher() {
+    if (worker.joinable()) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+      }
+      cv_work.notify_one();
+      worker.join();
+    }
+  }
+
+  void request(const std::string &path, std::filesystem::file_time_type mtime) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (busy && busy_path == path) {
+      return; /* Already in progress */
+    }
+    for (const auto &i : done) {
+      if (i.path == path && i.mtime == mtime) {
+        return;
+      }
+    }
+
+    if (!started) {
+      started = true;
+      try {
+        worker = std::thread(&Prefetcher::run, this);
+      } catch (const std::system_error &) {
+        QLOG_WARN("proc", "Can't start archive thread, archives are expanded when opened");
+      }
+    }
+    if (!worker.joinable()) {
+      return;
+    }
+    pending = {path, mtime, {}, false};
+    has_pending = true;
+    cv_work.notify_one();
+  }
+
+  /* Take the expanded archive for path. False if there is none */
+  bool take(const std::string &path, std::filesystem::file_time_type mtime, std::vector<unsigned char> &out) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    if (has_pending && pending.path == path) {
+      has_pending = false; /* The caller expands it now */
+    }
+    cv_done.wait(lock, [&] { return !(busy && busy_path == path); });
+
+    for (auto it = done.begin(); it != done.end(); ++it) {
+      if (it->path == path) {
+        T_PREFETCH prefetched = std::move(*it);
+        done.erase(it);
+        if (prefetched.mtime == mtime && prefetched.ok) {
+          out.swap(prefetched.data);
+          return true;
+        }
+        return false;
+      }
+    }
+    return false;
+  }
+
+private:
+  struct T_PREFETCH {
+    std::string path;
+    std::filesystem::file_time_type mtime;
+    std::vector<unsigned char> data;
+    bool ok;
+  };
+
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      cv_work.wait(lock, [&] { return stop || has_pending; });
+      if (stop) {
+        break;
+      }
+      T_PREFETCH job = std::move(pending);
+      has_pending = false;
+      busy = true;
+      busy_path = job.path;
+      lock.unlock();
+
+      job.ok = extract_file(job.path, job.data);
+
+      lock.lock();
+      if (done.size() >= PREFETCH_MAX) {
+        done.pop_front();
+      }
+      done.push_back(std::move(job));
+      busy = false;
+      busy_path.clear();
+      cv_done.notify_all();
+    }
+  }
+
+  std::thread worker;
+  std::mutex mutex;
+  std::condition_variable cv_work; /* A request, or stop */
+  std::condition_variable cv_done; /* The worker finished an archive */
+  T_PREFETCH pending;
+  bool has_pending = false;
+  bool busy = false;
+  std::string busy_path;
+  std::deque<T_PREFETCH> done;
+  bool started = false;
+  bool stop = false;
+};
+
+Prefetcher prefetcher;
+
+} // namespace
+
+bool archive_is_compressed(const char *path) {
+  std::string name(path);
+  return has_extension(name, ".gz") || has_extension(name, ".zip");
+}
+
+void archive_prefetch(const char *path) {
+  if (!archive_is_compressed(path)) {
+    return;
+  }
+  std::string name = full_path(path);
+  prefetcher.request(name, modified_time(name));
+}
+
+bool archive_extract(const char *path, std::vector<unsigned char> &out) {
+  std::string name = full_path(path);
+
+  if (prefetcher.take(name, modified_time(name), out)) {
+    return true;
+  }
+  if (!extract_file(name, out)) {
+    QLOG_WARN("proc", "Can't extract disk image from {}", name);
+    return false;
+  }
+  return true;
+}
+
+uint32_t archive_crc32(const unsigned char *p, size_t size) { return crc32(p, size); }
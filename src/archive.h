@@ -0,0 +1,31 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#pragma once
+
+/*
+ * Compressed disk images (.gz and .zip).
+ *
+ * An archive is expanded into memory as a whole. Expansion can be started in
+ * advance on a background thread with archive_prefetch(); archive_extract()
+ * then only picks up the result, so opening the image does not stall the
+ * emulation.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* True if the path names a container handled here (by extension) */
+bool archive_is_compressed(const char *path);
+
+/* Start expanding the archive in the background. Ignored for other files */
+void archive_prefetch(const char *path);
+
+/*
+ * Expand the archive into out. Uses the prefetched result if there is one,
+ * otherwise expands on the calling thread. For .zip, the first disk image
+ * (or else the first file) in the archive is used.
+ */
+bool archive_extract(const char *path, std::vector<unsigned char> &out);
+
+/* CRC-32 as used by gzip and zip */
+uint32_t archive_crc32(const unsigned char *p, size_t size);
@@ -3,7 +3,6 @@
 /*                                  */
 /*              この機能は peach氏により実装されました  */
 /************************************************************************/
-#ifdef USE_MONITOR
 
 /*
  *  仮想的に CPU と RAM を用意してぶん回します。
@@ -30,6 +29,12 @@
 #include "screen.h"
 #include "z80.h"
 
+/*
+ *  中間コードの格納位置の設定 (pseudo_set_addr、write_basic_addr) と
+ *  メモリ上の中間コードの読み込みは、テープの高速ロードでも使うので
+ *  モニターモードがなくても有効にしておく。
+ */
+
 #define BASIC_MAX_ERR_NUM 4  /* エラー登録可能数     */
 #define BASIC_MAX_ERR_STR 20 /* エラー表示文字数     */
 
@@ -67,6 +72,7 @@ typedef struct {
   char str[BASIC_MAX_ERR_STR];
 } basic_err;
 
+#ifdef USE_MONITOR
 int basic_mode = false;
 
 static z80arch pseudo_z80_cpu; /* 仮想 CPU               */
@@ -78,6 +84,7 @@ static uint8_t *read_pseudo_mem_0000_7fff; /* 仮想メモリリードポイン
 static uint8_t *read_pseudo_mem_8000_83ff;
 
 static uint8_t *write_pseudo_mem_8000_83ff; /* 仮想メモリライトポインタ  */
+#endif
 
 static uint16_t basic_top_addr_addr; /* 中間コード始点アドレス格納*/
 static uint16_t basic_end_addr_addr; /* 中間コード終点アドレス格納*/
@@ -99,6 +106,7 @@ static uint16_t decode_end_pc;                      /* デコード終了アド
 static basic_err decode_err[BASIC_MAX_ERR_NUM]; /* デコードエラー         */
 static int decode_err_num;                      /* デコードエラー登録数   */
 
+#ifdef USE_MONITOR
 /*------------------------------------------------------*/
 /* 仮想メモリ割り当て                  */
 /*------------------------------------------------------*/
@@ -215,6 +223,7 @@ static int pseudo_mem_init() {
   }
   return 1;
 }
+#endif /* USE_MONITOR */
 
 /*------------------------------------------------------*/
 /* 中間コードの始点・終点アドレスの書き込み     */
@@ -295,6 +304,7 @@ static void pseudo_set_addr() {
   }
 }
 
+#ifdef USE_MONITOR
 /*------------------------------------------------------*/
 /* エンコード用仮想 CPU レジスタ設定          */
 /*------------------------------------------------------*/
@@ -567,5 +577,48 @@ int basic_save_intermediate_code(FILE *fp) {
 
   return (wsize);
 }
-
 #endif /* USE_MONITOR */
+
+/*------------------------------------------------------*/
+/* メモリ上の中間コードをメイン RAM に読み込む     */
+/*------------------------------------------------------*/
+/*
+ *  code は最初の行のリンクポインタから始まる中間コード。リンクポインタは
+ *  標準の格納位置 (basic_buffer_addr) を前提に辿り、終端 (リンク 0) まで
+ *  矛盾なく繋がった場合のみ読み込む。戻り値は読み込んだ中間コードの
+ *  バイト数 (終端を含む)。中間コードでなければ 0 を返す。
+ */
+int basic_load_intermediate_code_mem(const uint8_t *code, int size) {
+  int pos = 0, link, next;
+
+  pseudo_set_addr();
+
+  if (size > basic_buffer_size) {
+    size = basic_buffer_size;
+  }
+
+  while (true) {
+    if (pos + 2 > size) {
+      return 0;
+    }
+    link = READ_WORD(code, pos);
+    if (link == 0) { /* 終端 */
+      pos += 2;
+      break;
+    }
+    /* 次の行は、リンク・行番号・行末の 0 より後ろにある */
+    next = link - basic_buffer_addr;
+    if (next < pos + 5 || next > size || code[next - 1] != 0) {
+      return 0;
+    }
+    pos = next;
+  }
+
+  WRITE_BYTE(main_ram, basic_buffer_addr - 1, 0);
+  memcpy(&main_ram[basic_buffer_addr], code, pos);
+  basic_top_addr = basic_buffer_addr;
+  basic_end_addr = basic_buffer_addr + pos - 1;
+  write_basic_addr();
+
+  return pos;
+}
@@ -7,5 +7,6 @@ int basic_encode_list(FILE *fp);
 int basic_load_intermediate_code(FILE *fp);
 int basic_decode_list(FILE *fp);
 int basic_save_intermediate_code(FILE *fp);
+int basic_load_intermediate_code_mem(const uint8_t *code, int size);
 
 #endif /* BASIC_H_INCLUDED */
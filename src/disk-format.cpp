@@ -0,0 +1,606 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#include "disk-format.h"
+
+#include "drive.h"
+
+namespace {
+
+uint16_t get16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+uint32_t get32(const uint8_t *p) { return get16(p) | ((uint32_t)get16(p + 2) << 16); }
+void put16(std::vector<uint8_t> &v, size_t pos, uint16_t x) {
+  v[pos] = x & 0xff;
+  v[pos + 1] = x >> 8;
+}
+void put32(std::vector<uint8_t> &v, size_t pos, uint32_t x) {
+  put16(v, pos, x & 0xffff);
+  put16(v, pos + 2, x >> 16);
+}
+
+bool has_extension(const std::string &path, const char *ext) {
+  size_t len = strlen(ext);
+  if (path.size() < len) {
+    return false;
+  }
+  for (size_t i = 0; i < len; i++) {
+    if (tolower((unsigned char)path[path.size() - len + i]) != ext[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*----------------------------------------------------------------------
+ * D88
+ *----------------------------------------------------------------------*/
+
+constexpr size_t D88_HEADER_SIZE = DISK_TRACK + 4 * DISK_FORMAT_NR_TRACK;
+
+class D88Disk : public DiskImage {
+public:
+  /* The disk image starts at file[0] and is size bytes long */
+  bool parse(const uint8_t *file, size_t size) {
+    buf.assign(file, file + size);
+    size_t header_end = D88_HEADER_SIZE;
+
+    for (int trk = 0; trk < DISK_FORMAT_NR_TRACK; trk++) {
+      /* Some images have a shorter track table: it ends where track data begins */
+      if (DISK_TRACK + (size_t)trk * 4 + 4 > header_end) {
+        break;
+      }
+      size_t pos = get32(&buf[DISK_TRACK + trk * 4]);
+      if (pos == 0) {
+        continue;
+      }
+      header_end = std::min(header_end, pos);
+      if (pos + SZ_DISK_ID > size) {
+        return false;
+      }
+      int nr = get16(&buf[pos + DISK_SEC_NR]);
+      for (int i = 0; i < nr; i++) {
+        if (pos + SZ_DISK_ID > size) {
+          return false;
+        }
+        size_t sz = get16(&buf[pos + DISK_SEC_SZ]);
+        if (pos + SZ_DISK_ID + sz > size) {
+          return false;
+        }
+        track[trk].push_back(pos);
+        pos += SZ_DISK_ID + sz;
+      }
+    }
+    return true;
+  }
+
+  std::string name() const override {
+    const char *p = (const char *)&buf[DISK_FILENAME];
+    return std::string(p, strnlen(p, 17));
+  }
+  bool write_protected() const override { return buf[DISK_PROTECT] == DISK_PROTECT_TRUE; }
+  int media_type() const override { return buf[DISK_TYPE]; }
+
+  bool get_track(int trk, std::vector<DiskSectorId> &ids) const override {
+    ids.clear();
+    if (trk < 0 || trk >= DISK_FORMAT_NR_TRACK) {
+      return false;
+    }
+    for (size_t pos : track[trk]) {
+      const uint8_t *p = &buf[pos];
+      ids.push_back({p[DISK_C], p[DISK_H], p[DISK_R], p[DISK_N], p[DISK_DENSITY], p[DISK_DELETED], p[DISK_STATUS],
+                     get16(&p[DISK_SEC_SZ])});
+    }
+    return true;
+  }
+
+  bool read_sector(int trk, int index, std::vector<uint8_t> &data) const override {
+    const uint8_t *p = sector(trk, index);
+    if (p == nullptr) {
+      return false;
+    }
+    data.assign(p + SZ_DISK_ID, p + SZ_DISK_ID + get16(&p[DISK_SEC_SZ]));
+    return true;
+  }
+
+  bool write_sector(int trk, int index, const uint8_t *data, size_t size) override {
+    uint8_t *p = const_cast<uint8_t *>(sector(trk, index));
+    if (p == nullptr) {
+      return false;
+    }
+    memcpy(p + SZ_DISK_ID, data, std::min(size, (size_t)get16(&p[DISK_SEC_SZ])));
+    return true;
+  }
+
+private:
+  const uint8_t *sector(int trk, int index) const {
+    if (trk < 0 || trk >= DISK_FORMAT_NR_TRACK || index < 0 || (size_t)index >= track[trk].size()) {
+      return nullptr;
+    }
+    return &buf[track[trk][index]];
+  }
+
+  std::vector<uint8_t> buf;
+  std::vector<size_t> track[DISK_FORMAT_NR_TRACK]; /* Offsets of the sector IDs */
+};
+
+class D88Format : public DiskImageFormat {
+public:
+  const char *name() const override { return "d88"; }
+  const char *extension() const override { return ".d88"; }
+
+  bool probe(const uint8_t *file, size_t size, const std::string &) const override {
+    if (size < D88_HEADER_SIZE) {
+      return false;
+    }
+    size_t disk_size = get32(&file[DISK_SIZE]);
+    return disk_size >= D88_HEADER_SIZE && disk_size <= size;
+  }
+
+  bool open(const uint8_t *file, size_t size, DiskImageSet &disks) const override {
+    size_t pos = 0;
+    while (size - pos >= D88_HEADER_SIZE) {
+      size_t disk_size = get32(&file[pos + DISK_SIZE]);
+      if (disk_size < D88_HEADER_SIZE || disk_size > size - pos) {
+        break;
+      }
+      auto disk = std::make_unique<D88Disk>();
+      if (!disk->parse(&file[pos], disk_size)) {
+        return false;
+      }
+      disks.push_back(std::move(disk));
+      pos += disk_size;
+    }
+    return !disks.empty();
+  }
+
+  bool save(const DiskImageSet &disks, std::vector<uint8_t> &file) const override {
+    std::vector<DiskSectorId> ids;
+    std::vector<uint8_t> data;
+
+    file.clear();
+    for (const auto &disk : disks) {
+      size_t top = file.size();
+      file.resize(top + D88_HEADER_SIZE, 0);
+
+      std::string name = disk->name().substr(0, 16);
+      memcpy(&file[top + DISK_FILENAME], name.data(), name.size());
+      file[top + DISK_PROTECT] = disk->write_protected() ? DISK_PROTECT_TRUE : DISK_PROTECT_FALSE;
+      file[top + DISK_TYPE] = disk->media_type();
+
+      for (int trk = 0; trk < DISK_FORMAT_NR_TRACK; trk++) {
+        if (!disk->get_track(trk, ids) || ids.empty()) {
+          continue;
+        }
+        put32(file, top + DISK_TRACK + trk * 4, file.size() - top);
+        for (size_t i = 0; i < ids.size(); i++) {
+          if (!disk->read_sector(trk, i, data)) {
+            return false;
+          }
+          size_t pos = file.size();
+          file.resize(pos + SZ_DISK_ID + data.size(), 0);
+          file[pos + DISK_C] = ids[i].c;
+          file[pos + DISK_H] = ids[i].h;
+          file[pos + DISK_R] = ids[i].r;
+          file[pos + DISK_N] = ids[i].n;
+          put16(file, pos + DISK_SEC_NR, ids.size());
+          file[pos + DISK_DENSITY] = ids[i].density;
+          file[pos + DISK_DELETED] = ids[i].deleted;
+          file[pos + DISK_STATUS] = ids[i].status;
+          put16(file, pos + DISK_SEC_SZ, data.size());
+          memcpy(&file[pos + SZ_DISK_ID], data.data(), data.size());
+        }
+      }
+      put32(file, top + DISK_SIZE, file.size() - top);
+    }
+    return true;
+  }
+};
+
+/*----------------------------------------------------------------------
+ * Raw sector dumps (.2d, .2dd, .2hd): sectors 1..n of every track in order
+ *----------------------------------------------------------------------*/
+
+struct RawGeometry {
+  int cylinder;
+  int sector; /* per track */
+  int n;
+  int type;
+};
+
+const RawGeometry raw_geometry[] = {
+    {40, 16, 1, DISK_TYPE_2D},  /* 320KB */
+    {80, 16, 1, DISK_TYPE_2DD}, /* 640KB */
+    {77, 26, 1, DISK_TYPE_2HD}, /* 1001KB, 8inch compatible */
+    {77, 8, 3, DISK_TYPE_2HD},  /* 1232KB */
+};
+
+size_t raw_size(const RawGeometry &g) { return (size_t)g.cylinder * 2 * g.sector * (128 << g.n); }
+
+class RawDisk : public DiskImage {
+public:
+  RawDisk(const RawGeometry &g, const uint8_t *file) : geometry(g), buf(file, file + raw_size(g)) {}
+
+  std::string name() const override { return ""; }
+  bool write_protected() const override { return false; }
+  int media_type() const override { return geometry.type; }
+
+  bool get_track(int trk, std::vector<DiskSectorId> &ids) const override {
+    ids.clear();
+    if (trk < 0 || trk >= geometry.cylinder * 2) {
+      return trk >= 0 && trk < DISK_FORMAT_NR_TRACK;
+    }
+    for (int r = 1; r <= geometry.sector; r++) {
+      ids.push_back({(uint8_t)(trk / 2), (uint8_t)(trk % 2), (uint8_t)r, (uint8_t)geometry.n, DISK_DENSITY_DOUBLE,
+                     DISK_DELETED_FALSE, 0, (uint16_t)(128 << geometry.n)});
+    }
+    return true;
+  }
+
+  int find_sector(int trk, uint8_t c, uint8_t h, uint8_t r, uint8_t n) const override {
+    if (trk < 0 || trk >= geometry.cylinder * 2 || c != trk / 2 || h != trk % 2 || n != geometry.n || r < 1 ||
+        r > geometry.sector) {
+      return -1;
+    }
+    return r - 1;
+  }
+
+  bool read_sector(int trk, int index, std::vector<uint8_t> &data) const override {
+    size_t pos = offset(trk, index);
+    if (pos == SIZE_MAX) {
+      return false;
+    }
+    data.assign(&buf[pos], &buf[pos] + (128 << geometry.n));
+    return true;
+  }
+
+  bool write_sector(int trk, int index, const uint8_t *data, size_t size) override {
+    size_t pos = offset(trk, index);
+    if (pos == SIZE_MAX) {
+      return false;
+    }
+    memcpy(&buf[pos], data, std::min(size, (size_t)(128 << geometry.n)));
+    return true;
+  }
+
+private:
+  size_t offset(int trk, int index) const {
+    if (trk < 0 || trk >= geometry.cylinder * 2 || index < 0 || index >= geometry.sector) {
+      return SIZE_MAX;
+    }
+    return ((size_t)trk * geometry.sector + index) * (128 << geometry.n);
+  }
+
+  RawGeometry geometry;
+  std::vector<uint8_t> buf;
+};
+
+class RawFormat : public DiskImageFormat {
+public:
+  const char *name() const override { return "raw"; }
+  const char *extension() const override { return ".2d"; }
+
+  bool probe(const uint8_t *, size_t size, const std::string &path) const override {
+    return (has_extension(path, ".2d") || has_extension(path, ".2dd") || has_extension(path, ".2hd")) &&
+           geometry_of(size) != nullptr;
+  }
+
+  bool open(const uint8_t *file, size_t size, DiskImageSet &disks) const override {
+    const RawGeometry *g = geometry_of(size);
+    if (g == nullptr) {
+      return false;
+    }
+    disks.push_back(std::make_unique<RawDisk>(*g, file));
+    return true;
+  }
+
+  /* Only plain disks fit: every track holds sectors 1..n of the same size */
+  bool save(const DiskImageSet &disks, std::vector<uint8_t> &file) const override {
+    std::vector<DiskSectorId> ids;
+    std::vector<uint8_t> data;
+
+    if (disks.size() != 1 || !disks[0]->get_track(0, ids) || ids.empty()) {
+      return false;
+    }
+    const DiskImage &disk = *disks[0];
+    const RawGeometry *g = nullptr;
+    for (const auto &i : raw_geometry) {
+      if (i.type == disk.media_type() && i.sector == (int)ids.size() && i.n == ids[0].n) {
+        g = &i;
+      }
+    }
+    if (g == nullptr) {
+      return false;
+    }
+
+    file.assign(raw_size(*g), 0);
+    int sector_size = 128 << g->n;
+    for (int trk = 0; trk < DISK_FORMAT_NR_TRACK; trk++) {
+      if (!disk.get_track(trk, ids)) {
+        return false;
+      }
+      if (trk >= g->cylinder * 2) {
+        if (!ids.empty()) {
+          return false;
+        }
+        continue;
+      }
+      for (int r = 1; r <= g->sector; r++) {
+        int index = disk.find_sector(trk, trk / 2, trk % 2, r, g->n);
+        if (index < 0 || !disk.read_sector(trk, index, data) || (int)data.size() != sector_size ||
+            ids[index].status != 0 || ids[index].deleted != DISK_DELETED_FALSE) {
+          return false;
+        }
+        memcpy(&file[((size_t)trk * g->sector + r - 1) * sector_size], data.data(), sector_size);
+      }
+    }
+    return true;
+  }
+
+private:
+  static const RawGeometry *geometry_of(size_t size) {
+    for (const auto &g : raw_geometry) {
+      if (raw_size(g) == size) {
+        return &g;
+      }
+    }
+    return nullptr;
+  }
+};
+
+/*----------------------------------------------------------------------
+ * QDI: indexed internal format
+ *
+ *  "QDI\x1a", number of disks (u32), then for each disk:
+ *    name[17], protect, type, reserved (20 bytes)
+ *    number of sectors of each track (u16 x 164)
+ *    sector table: C H R N density deleted status flags, size (u16),
+ *                  reserved (u16), data offset in file or fill byte (u32)
+ *  followed by the sector data. A sector filled with a single byte value
+ *  (e.g. a freshly formatted one) is stored as that value only.
+ *----------------------------------------------------------------------*/
+
+constexpr char QDI_MAGIC[] = "QDI\x1a";
+constexpr size_t QDI_DISK_HEADER = 20;
+constexpr size_t QDI_ENTRY = 16;
+constexpr uint8_t QDI_FILL = 0x01;
+
+class QdiDisk : public DiskImage {
+public:
+  bool parse(const uint8_t *file, size_t size, size_t &pos) {
+    if (pos + QDI_DISK_HEADER + 2 * DISK_FORMAT_NR_TRACK > size) {
+      return false;
+    }
+    const uint8_t *p = &file[pos];
+    disk_name.assign((const char *)p, strnlen((const char *)p, 17));
+    protect = p[17];
+    type = p[18];
+    pos += QDI_DISK_HEADER;
+
+    size_t nr = 0;
+    for (int trk = 0; trk < DISK_FORMAT_NR_TRACK; trk++) {
+      first[trk] = nr;
+      nr += get16(&file[pos + trk * 2]);
+    }
+    first[DISK_FORMAT_NR_TRACK] = nr;
+    pos += 2 * DISK_FORMAT_NR_TRACK;
+    if (pos + nr * QDI_ENTRY > size) {
+      return false;
+    }
+
+    for (size_t i = 0; i < nr; i++, pos += QDI_ENTRY) {
+      const uint8_t *e = &file[pos];
+      Sector s;
+      s.id = {e[0], e[1], e[2], e[3], e[4], e[5], e[6], get16(&e[8])};
+      uint32_t value = get32(&e[12]);
+      if (e[7] & QDI_FILL) {
+        s.data.assign(s.id.size, (uint8_t)value);
+      } else if (value > size || s.id.size > size - value) {
+        return false;
+      } else {
+        s.data.assign(&file[value], &file[value] + s.id.size);
+      }
+      sector.push_back(std::move(s));
+    }
+    return true;
+  }
+
+  std::string name() const override { return disk_name; }
+  bool write_protected() const override { return protect == DISK_PROTECT_TRUE; }
+  int media_type() const override { return type; }
+
+  bool get_track(int trk, std::vector<DiskSectorId> &ids) const override {
+    ids.clear();
+    if (trk < 0 || trk >= DISK_FORMAT_NR_TRACK) {
+      return false;
+    }
+    for (size_t i = first[trk]; i < first[trk + 1]; i++) {
+      ids.push_back(sector[i].id);
+    }
+    return true;
+  }
+
+  bool read_sector(int trk, int index, std::vector<uint8_t> &data) const override {
+    const Sector *s = find(trk, index);
+    if (s == nullptr) {
+      return false;
+    }
+    data = s->data;
+    return true;
+  }
+
+  bool write_sector(int trk, int index, const uint8_t *data, size_t size) override {
+    Sector *s = const_cast<Sector *>(find(trk, index));
+    if (s == nullptr) {
+      return false;
+    }
+    memcpy(s->data.data(), data, std::min(size, s->data.size()));
+    return true;
+  }
+
+private:
+  struct Sector {
+    DiskSectorId id;
+    std::vector<uint8_t> data;
+  };
+
+  const Sector *find(int trk, int index) const {
+    if (trk < 0 || trk >= DISK_FORMAT_NR_TRACK || index < 0 || first[trk] + index >= first[trk + 1]) {
+      return nullptr;
+    }
+    return &sector[first[trk] + index];
+  }
+
+  std::string disk_name;
+  uint8_t protect = 0;
+  uint8_t type = 0;
+  size_t first[DISK_FORMAT_NR_TRACK + 1] = {}; /* Index of the first sector of each track */
+  std::vector<Sector> sector;
+};
+
+class QdiFormat : public DiskImageFormat {
+public:
+  const char *name() const override { return "qdi"; }
+  const char *extension() const override { return ".qdi"; }
+
+  bool probe(const uint8_t *file, size_t size, const std::string &) const override {
+    return size >= 8 && memcmp(file, QDI_MAGIC, 4) == 0;
+  }
+
+  bool open(const uint8_t *file, size_t size, DiskImageSet &disks) const override {
+    if (!probe(file, size, "")) {
+      return false;
+    }
+    uint32_t nr = get32(&file[4]);
+    size_t pos = 8;
+    for (uint32_t i = 0; i < nr; i++) {
+      auto disk = std::make_unique<QdiDisk>();
+      if (!disk->parse(file, size, pos)) {
+        return false;
+      }
+      disks.push_back(std::move(disk));
+    }
+    return !disks.empty();
+  }
+
+  bool save(const DiskImageSet &disks, std::vector<uint8_t> &file) const override {
+    std::vector<DiskSectorId> ids;
+    std::vector<uint8_t> data;
+    std::vector<uint8_t> blob;
+    std::vector<size_t> fixup; /* Table entries whose offset is relative to the blob */
+
+    file.assign(8, 0);
+    memcpy(file.data(), QDI_MAGIC, 4);
+    put32(file, 4, disks.size());
+
+    for (const auto &disk : disks) {
+      size_t top = file.size();
+      file.resize(top + QDI_DISK_HEADER + 2 * DISK_FORMAT_NR_TRACK, 0);
+      std::string name = disk->name().substr(0, 16);
+      memcpy(&file[top], name.data(), name.size());
+      file[top + 17] = disk->write_protected() ? DISK_PROTECT_TRUE : DISK_PROTECT_FALSE;
+      file[top + 18] = disk->media_type();
+
+      for (int trk = 0; trk < DISK_FORMAT_NR_TRACK; trk++) {
+        if (!disk->get_track(trk, ids)) {
+          return false;
+        }
+        put16(file, top + QDI_DISK_HEADER + trk * 2, ids.size());
+        for (size_t i = 0; i < ids.size(); i++) {
+          if (!disk->read_sector(trk, i, data)) {
+            return false;
+          }
+          size_t pos = file.size();
+          file.resize(pos + QDI_ENTRY, 0);
+          const DiskSectorId &id = ids[i];
+          uint8_t head[] = {id.c, id.h, id.r, id.n, id.density, id.deleted, id.status};
+          memcpy(&file[pos], head, sizeof(head));
+          put16(file, pos + 8, data.size());
+
+          bool fill = !data.empty() && std::all_of(data.begin(), data.end(), [&](uint8_t b) { return b == data[0]; });
+          if (fill) {
+            file[pos + 7] = QDI_FILL;
+            put32(file, pos + 12, data[0]);
+          } else {
+            put32(file, pos + 12, blob.size());
+            fixup.push_back(pos + 12);
+            blob.insert(blob.end(), data.begin(), data.end());
+          }
+        }
+      }
+    }
+
+    size_t base = file.size();
+    for (size_t pos : fixup) {
+      put32(file, pos, base + get32(&file[pos]));
+    }
+    file.insert(file.end(), blob.begin(), blob.end());
+    return true;
+  }
+};
+
+const D88Format d88_format;
+const RawFormat raw_format;
+const QdiFormat qdi_format;
+
+/* Probed in this order; D88 has the weakest signature */
+const DiskImageFormat *const formats[] = {&qdi_format, &raw_format, &d88_format};
+
+} // namespace
+
+int DiskImage::find_sector(int trk, uint8_t c, uint8_t h, uint8_t r, uint8_t n) const {
+  std::vector<DiskSectorId> ids;
+  if (get_track(trk, ids)) {
+    for (size_t i = 0; i < ids.size(); i++) {
+      if (ids[i].c == c && ids[i].h == h && ids[i].r == r && ids[i].n == n) {
+        return (int)i;
+      }
+    }
+  }
+  return -1;
+}
+
+const DiskImageFormat *disk_format_d88() { return &d88_format; }
+
+const DiskImageFormat *disk_format_by_name(const std::string &name) {
+  for (const auto *f : formats) {
+    if (name == f->name()) {
+      return f;
+    }
+  }
+  return nullptr;
+}
+
+const DiskImageFormat *disk_format_by_extension(const std::string &path) {
+  if (has_extension(path, ".2d") || has_extension(path, ".2dd") || has_extension(path, ".2hd")) {
+    return &raw_format;
+  }
+  if (has_extension(path, ".qdi")) {
+    return &qdi_format;
+  }
+  if (has_extension(path, ".d88") || has_extension(path, ".d77") || has_extension(path, ".88d")) {
+    return &d88_format;
+  }
+  return nullptr;
+}
+
+const DiskImageFormat *disk_format_probe(const uint8_t *file, size_t size, const std::string &path) {
+  for (const auto *f : formats) {
+    if (f->probe(file, size, path)) {
+      return f;
+    }
+  }
+  return &d88_format;
+}
+
+bool disk_format_convert(const DiskImageFormat *from, const uint8_t *file, size_t size, const DiskImageFormat *to,
+                         std::vector<uint8_t> &out) {
+  DiskImageSet disks;
+  try {
+    return from->open(file, size, disks) && to->save(disks, out);
+  } catch (const std::bad_alloc &) {
+    return false;
+  }
+}
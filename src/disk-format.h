@@ -0,0 +1,81 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#pragma once
+
+/*
+ * Disk image formats.
+ *
+ * Each file format is a DiskImageFormat backend. It recognizes a file, opens
+ * the disks in it as DiskImage objects (track/sector access independent of
+ * the file layout) and writes a set of disks back in its own layout.
+ *
+ * The emulator core works on D88. Files in other formats are converted to
+ * D88 when they are opened and converted back when they are written (see
+ * file-op.cpp); quasi88-diskconv converts files in bulk.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/* Tracks per disk (cylinder * 2 + head), as in D88 */
+constexpr int DISK_FORMAT_NR_TRACK = 164;
+
+struct DiskSectorId {
+  uint8_t c, h, r, n;
+  uint8_t density; /* DISK_DENSITY_DOUBLE / DISK_DENSITY_SINGLE */
+  uint8_t deleted; /* DISK_DELETED_TRUE / DISK_DELETED_FALSE */
+  uint8_t status;  /* FDC status of the sector (0: normal) */
+  uint16_t size;   /* Size of the data, usually 128 << n */
+};
+
+class DiskImage {
+public:
+  virtual ~DiskImage() = default;
+
+  virtual std::string name() const = 0;
+  virtual bool write_protected() const = 0;
+  virtual int media_type() const = 0; /* DISK_TYPE_2D / 2DD / 2HD */
+
+  /* IDs of the sectors of a track, in rotation order. Empty if unformatted */
+  virtual bool get_track(int trk, std::vector<DiskSectorId> &ids) const = 0;
+
+  /* Position of the sector with the ID in get_track() order, or -1 */
+  virtual int find_sector(int trk, uint8_t c, uint8_t h, uint8_t r, uint8_t n) const;
+
+  virtual bool read_sector(int trk, int index, std::vector<uint8_t> &data) const = 0;
+  virtual bool write_sector(int trk, int index, const uint8_t *data, size_t size) = 0;
+};
+
+typedef std::vector<std::unique_ptr<DiskImage>> DiskImageSet;
+
+class DiskImageFormat {
+public:
+  virtual ~DiskImageFormat() = default;
+
+  virtual const char *name() const = 0;
+  virtual const char *extension() const = 0; /* Default extension, e.g. ".d88" */
+
+  /* True if the file is in this format. path is only used for its extension */
+  virtual bool probe(const uint8_t *file, size_t size, const std::string &path) const = 0;
+
+  /* Open all the disks in the file */
+  virtual bool open(const uint8_t *file, size_t size, DiskImageSet &disks) const = 0;
+
+  /* Write the disks in this format. False if they can't be represented */
+  virtual bool save(const DiskImageSet &disks, std::vector<uint8_t> &file) const = 0;
+};
+
+const DiskImageFormat *disk_format_d88();
+
+/* Backend by name ("d88", "raw", "qdi") or by the extension of path */
+const DiskImageFormat *disk_format_by_name(const std::string &name);
+const DiskImageFormat *disk_format_by_extension(const std::string &path);
+
+/* Backend that recognizes the file; D88 if none does */
+const DiskImageFormat *disk_format_probe(const uint8_t *file, size_t size, const std::string &path);
+
+/* Convert a whole file from one format to another */
+bool disk_format_convert(const DiskImageFormat *from, const uint8_t *file, size_t size, const DiskImageFormat *to,
+                         std::vector<uint8_t> &out);
@@ -94,6 +94,8 @@ int disk_insert(int drv, const char *filename, int img, int readonly);
 int disk_change_image(int drv, int img);
 void disk_eject(int drv);
 int disk_insert_A_to_B(int src, int dst, int img);
+void disk_write_back(int force);
+void disk_track_index_clear(int drv);
 
 void drive_set_empty(int drv);
 void drive_unset_empty(int drv);
@@ -9,12 +9,15 @@
 #include "quasi88.h"
 
 #include "debug.h"
+#include "drive.h"
 #include "emu.h"
 #include "event.h"
 #include "initval.h"
 #include "intr.h"
 #include "keyboard.h"
 #include "pc88cpu.h"
+#include "replay.h"
+#include "runahead.h"
 #include "snddrv.h"
 #include "status.h"
 #include "suspend.h"
@@ -146,6 +149,9 @@ static int target_step; /* この step数に達するまで実行する */
 static int infinity, only_1step;
 static int (*z80_exec)(z80arch *, int);
 
+/* GO 実行中で、ブレークポイントもなければ真 (先行実行できる) */
+int emu_is_free_running() { return (emu_mode_execute == GO && z80_exec == z80_emu); }
+
 void emu_init() {
   /*xmame_sound_update();*/
   xmame_update_video_and_audio();
@@ -267,20 +273,28 @@ void emu_main() {
       if (quasi88_event_flags & EVENT_AUDIO_UPDATE) {
         quasi88_event_flags &= ~EVENT_AUDIO_UPDATE;
 
-        profiler_lapse(PROF_LAPSE_SND);
+        /* 先行実行の隠しフレームでは、音の出力も入力の取り込みもしない */
+        /* (リプレイの再生位置へ移動中も、隠しフレームとして処理する) */
+        if (runahead_hidden == false) {
+          profiler_lapse(PROF_LAPSE_SND);
 
-        xmame_sound_update(); /* サウンド出力 */
+          xmame_sound_update(); /* サウンド出力 */
 
-        profiler_lapse(PROF_LAPSE_AUDIO);
+          profiler_lapse(PROF_LAPSE_AUDIO);
 
-        xmame_update_video_and_audio(); /* サウンド出力 その2 */
+          xmame_update_video_and_audio(); /* サウンド出力 その2 */
 
-        profiler_lapse(PROF_LAPSE_INPUT);
+          profiler_lapse(PROF_LAPSE_INPUT);
 
-        event_update(); /* イベント処理       */
-        keyboard_update();
+          event_update(); /* イベント処理       */
+          keyboard_update();
 
-        profiler_lapse(PROF_LAPSE_CPU2);
+          disk_write_back(false); /* ディスクイメージの書き戻し */
+
+          profiler_lapse(PROF_LAPSE_CPU2);
+        } else if (replay_seeking) {
+          keyboard_update(); /* 再生位置への移動中は、再生する入力だけ取り込む */
+        }
       }
 
       /* ビデオ出力タイミングであれば、CPU処理は一旦中止。上位に抜ける */
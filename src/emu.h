@@ -51,5 +51,6 @@ void set_emu_exec_mode(int mode);
 
 void emu_init();
 void emu_main();
+int emu_is_free_running();
 
 #endif /* EMU_H_INCLUDED */
@@ -25,34 +25,12 @@ extern "C" {
 #endif
 }
 
-/***********************************************************************
- * QUASI88 起動中のステートロード処理関数
- *  TODO 引数で、ファイル名指定？
- ************************************************************************/
-int quasi88_stateload(int serial) {
-  if (serial >= 0) {                   /* 連番指定あり (>=0) なら */
-    filename_set_state_serial(serial); /* 連番を設定する */
-  }
-
-  QLOG_DEBUG("proc", "Stateload: starting {}", filename_get_state());
-
-  if (stateload_check_file_exist() == false) { /* ファイルなし */
-    if (quasi88_is_exec()) {
-      status_message(1, STATUS_INFO_TIME, "State-Load file not found !");
-    } /* メニューではダイアログ表示するので、ステータス表示は無しにする */
-
-    QLOG_WARN("proc", "State-file not found");
-    return false;
-  }
-
-#if USE_RETROACHIEVEMENTS
-  if (!RA_WarnDisableHardcore("load a state")) {
-    if (verbose_proc)
-      printf("State-Load cancelled (RA)\n");
-    return false;
-  }
-#endif
-
+/*
+ * ワークを終了状態にしてステートを復元し、再初期化する。
+ * data が nullptr ならステートファイルから、そうでなければメモリから復元。
+ * 失敗したらリセットする。
+ */
+static int stateload_restart(const uint8_t *data, size_t size) {
   pc88main_term(); /* 念のため、ワークを終了状態に */
   pc88sub_term();
   imagefile_all_close(); /* イメージファイルを全て閉じる */
@@ -62,7 +40,7 @@ int quasi88_stateload(int serial) {
 
   int now_board = sound_board;
 
-  int success = stateload(); /* ステートロード実行 */
+  int success = (data) ? stateload_buffer(data, size) : stateload();
 
   if (now_board != sound_board) { /* サウンドボードが変わったら */
     menu_sound_restart(false);    /* サウンドドライバの再初期化 */
@@ -81,14 +59,49 @@ int quasi88_stateload(int serial) {
     pc88main_init(INIT_STATELOAD);
     pc88sub_init(INIT_STATELOAD);
 
+  } else { /* ステートロード失敗したら・・・ */
+
+    quasi88_reset(nullptr); /* とりあえずリセット */
+  }
+
+  return success;
+}
+
+/***********************************************************************
+ * QUASI88 起動中のステートロード処理関数
+ *  TODO 引数で、ファイル名指定？
+ ************************************************************************/
+int quasi88_stateload(int serial) {
+  if (serial >= 0) {                   /* 連番指定あり (>=0) なら */
+    filename_set_state_serial(serial); /* 連番を設定する */
+  }
+
+  QLOG_DEBUG("proc", "Stateload: starting {}", filename_get_state());
+
+  if (stateload_check_file_exist() == false) { /* ファイルなし */
+    if (quasi88_is_exec()) {
+      status_message(1, STATUS_INFO_TIME, "State-Load file not found !");
+    } /* メニューではダイアログ表示するので、ステータス表示は無しにする */
+
+    QLOG_WARN("proc", "State-file not found");
+    return false;
+  }
+
 #if USE_RETROACHIEVEMENTS
-    RA_OnLoadState(filename_get_state());
+  if (!RA_WarnDisableHardcore("load a state")) {
+    if (verbose_proc)
+      printf("State-Load cancelled (RA)\n");
+    return false;
+  }
 #endif
 
-  } else { /* ステートロード失敗したら・・・ */
+  int success = stateload_restart(nullptr, 0); /* ステートロード実行 */
 
-    quasi88_reset(nullptr); /* とりあえずリセット */
+#if USE_RETROACHIEVEMENTS
+  if (success) {
+    RA_OnLoadState(filename_get_state());
   }
+#endif
 
   if (quasi88_is_exec()) {
     if (success) {
@@ -105,6 +118,22 @@ int quasi88_stateload(int serial) {
   return success;
 }
 
+/***********************************************************************
+ * QUASI88 起動中の、メモリ上のステートからのロード処理関数
+ *  data は statesave_buffer() で保存したもの。巻き戻しで使う。
+ *  ステータス表示は呼び出し元で行う。
+ ************************************************************************/
+int quasi88_stateload_memory(const uint8_t *data, size_t size) {
+  int success = stateload_restart(data, size);
+
+  if (quasi88_is_exec()) {
+    /* quasi88_loop の内部状態を INIT にするため、モード変更扱いとする */
+    quasi88_event_flags |= EVENT_MODE_CHANGED;
+  }
+
+  return success;
+}
+
 /***********************************************************************
  * QUASI88 起動中のステートセーブ処理関数
  *  TODO 引数で、ファイル名指定？
@@ -118,6 +147,12 @@ int quasi88_statesave(int serial) {
 
   int success = statesave(); /* ステートセーブ実行 */
 
+  /* 実行中は書き込みを待たない (失敗すれば後でステータス表示する)。
+     メニューやモニターでは、書き込みが終わるのを待って結果を返す */
+  if (success && quasi88_is_exec() == false) {
+    success = statesave_wait();
+  }
+
   if (success) {
     QLOG_DEBUG("proc", "Statesave: done");
   } else {
@@ -181,6 +216,32 @@ int quasi88_waveout(int start) {
   return success;
 }
 
+/***********************************************************************
+ * 画面とサウンドの動画ファイル出力
+ ************************************************************************/
+int quasi88_videoout(int start) {
+  int success;
+
+  if (start) {
+    success = videoout_save_start(nullptr);
+
+    if (success) {
+      status_message(1, STATUS_INFO_TIME, "Video Record Start ...");
+    } else {
+      status_message(1, STATUS_INFO_TIME, "Video Record Failed !");
+    }
+
+  } else {
+
+    success = true;
+
+    videoout_save_stop();
+    status_message(1, STATUS_INFO_TIME, "Video Record Stopped");
+  }
+
+  return success;
+}
+
 /***********************************************************************
  * ドラッグアンドドロップ
  ************************************************************************/
@@ -502,6 +563,8 @@ void quasi88_disk_image_prev(int drv) { disk_image_sub(drv, TYPE_PREV, 0); }
  * テープイメージファイル設定
  *      ・ロード用テープイメージファイルセット
  *      ・ロード用テープイメージファイル巻き戻し
+ *      ・ロード用テープイメージファイル頭出し
+ *      ・ロード用テープイメージファイル高速ロード
  *      ・ロード用テープイメージファイル取り外し
  *      ・セーブ用テープイメージファイルセット
  *      ・セーブ用テープイメージファイル取り外し
@@ -535,6 +598,8 @@ int quasi88_load_tape_rewind(void) {
   quasi88_load_tape_eject();
   return false;
 }
+int quasi88_load_tape_skip(void) { return sio_tape_skip(); }
+int quasi88_load_tape_fast_load(void) { return sio_tape_fast_load(); }
 int quasi88_load_tape_eject(void) {
 #if USE_RETROACHIEVEMENTS
   if (loaded_title != NULL && loaded_title->file_type == FTYPE_TAPE_LOAD && loaded_title->data_len > 0) {
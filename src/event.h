@@ -1,6 +1,7 @@
 #ifndef EVENT_H_INCLUDED
 #define EVENT_H_INCLUDED
 
+#include <stddef.h>
 #include <stdint.h>
 
 /***********************************************************************
@@ -155,8 +156,10 @@ typedef struct {
 
 int quasi88_stateload(int serial);
 int quasi88_statesave(int serial);
+int quasi88_stateload_memory(const uint8_t *data, size_t size);
 int quasi88_screen_snapshot();
 int quasi88_waveout(int start);
+int quasi88_videoout(int start);
 int quasi88_drag_and_drop(const char *filename);
 
 int quasi88_cfg_now_wait_rate();
@@ -177,6 +180,8 @@ void quasi88_disk_image_prev(int drv);
 
 int quasi88_load_tape_insert(const char *filename);
 int quasi88_load_tape_rewind();
+int quasi88_load_tape_skip();
+int quasi88_load_tape_fast_load();
 int quasi88_load_tape_eject();
 int quasi88_save_tape_insert(const char *filename);
 int quasi88_save_tape_eject();
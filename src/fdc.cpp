@@ -4,7 +4,10 @@
 /*                                  */
 /************************************************************************/
 
+#include <algorithm>
 #include <cstring>
+#include <unordered_map>
+#include <vector>
 
 #include "quasi88.h"
 
@@ -16,8 +19,10 @@
 #include "emu.h" /* emu_mode         */
 #include "fdc.h"
 #include "file-op.h"
+#include "hash64.h"
 #include "image.h"
 #include "initval.h"
+#include "runahead.h"
 #include "snddrv.h"
 #include "status.h"
 #include "suspend.h"
@@ -31,10 +36,12 @@ int disk_ex_drv = 0;        /* ディスク疑似入れ替えドライブ
                             /*    drive 2 ... bit 1         */
 /* 上記処理は、peach氏の提供による */
 
-int FDC_flag = 0; /* FDC 割り込み信号       */
-int fdc_wait = 0; /* FDC の ウエイト 0無 1有   */
+int FDC_flag = 0;    /* FDC 割り込み信号       */
+int fdc_wait = 0;    /* FDC の ウエイト 0無 1有   */
+int fdc_instant = 0; /* 高速ディスク 0無 1有     */
 
 int fdc_ignore_readonly = false; /* 読込専用時、ライトを無視する   */
+int disk_overlay = false;        /* 書き込みを差分ファイルに保存する */
 
 /* FDCのシーク音処理のワーク
    連続でシークした場合、一定間隔で音を出すようにする。
@@ -414,6 +421,39 @@ void drive_reset() {
   disk_ex_drv = 0;
 }
 
+/************************************************************************/
+/* ディスクイメージの書き戻し                        */
+/*  イメージファイルはメモリ上に読み込まれており (file-op.cpp 参照)、    */
+/*  書き込みはメモリ上で行われる。ファイルへは osd_fflush で書き戻す。   */
+/*  セクタ書き込みの度ではなく、最後の書き込みから一定時間経過した時点で */
+/*  まとめて書き戻す。force が真なら、ただちに書き戻す。         */
+/************************************************************************/
+#define DISK_WRITE_BACK_DELAY (60) /* 書き戻しまでのフレーム数 (約1秒) */
+
+static int disk_dirty_count = 0; /* 書き戻しまでの残りフレーム数 */
+
+static void disk_set_dirty() { disk_dirty_count = DISK_WRITE_BACK_DELAY; }
+
+void disk_write_back(int force) {
+  int drv;
+
+  if (disk_dirty_count == 0) {
+    return;
+  }
+  if (force == false && --disk_dirty_count > 0) {
+    return;
+  }
+
+  for (drv = 0; drv < NR_DRIVE; drv++) {
+    if (drive[drv].fp && (drv == 0 || !disk_same_file())) {
+      if (osd_fflush(drive[drv].fp) != 0) {
+        status_message(1, STATUS_WARN_TIME, "DiskI/O Write Error");
+      }
+    }
+  }
+  disk_dirty_count = 0;
+}
+
 /************************************************************************/
 /* ドライブを一時的に空にする／もとに戻す／切替える／どっちの状態か知る   */
 /*  drv…ドライブ(0/1)                     */
@@ -472,6 +512,7 @@ int disk_insert(int drv, const char *filename, int img, int readonly) {
 
   /* "r+b" でファイルを開く。だめなら "rb" でファイルを開く */
 
+  osd_set_disk_overlay(disk_overlay);
   if (open_as_readonly == false) {
     drive[drv].fp = osd_fopen(FTYPE_DISK, filename, "r+b");
   }
@@ -719,6 +760,27 @@ void disk_eject(int drv) {
 /*======================================================================*/
 static int disk_now_sec(int drv);
 
+/*----------------------------------------------------------------------*/
+/* ファイル位置 pos から size バイトを参照する                 */
+/*  イメージがメモリ上にあれば、その位置を直接指すポインタを返す。   */
+/*  そうでなければ buf に読み込んで buf を返す。             */
+/*  失敗時は NULL を返し、*error にエラーコードをセットする。     */
+/*----------------------------------------------------------------------*/
+static const uint8_t *disk_view(int drv, long pos, int size, uint8_t *buf, int *error) {
+  const uint8_t *p = osd_fview(drive[drv].fp, pos, size);
+
+  if (p == nullptr) {
+    if (osd_fseek(drive[drv].fp, pos, SEEK_SET) != 0) {
+      *error = 2;
+    } else if (osd_fread(buf, sizeof(uint8_t), size, drive[drv].fp) != (size_t)size) {
+      *error = 1;
+    } else {
+      p = buf;
+    }
+  }
+  return p;
+}
+
 static void disk_now_track(int drv, int trk) {
   int error = 0;
   int32_t track_top;
@@ -739,28 +801,28 @@ static void disk_now_track(int drv, int trk) {
 
   drive[drv].track = trk;
   drive[drv].sec = 0;
+  disk_track_index_clear(drv);
 
   /* トラックのインデックスで指定されたファイル位置を取得 */
 
-  if (osd_fseek(drive[drv].fp, drive[drv].disk_top + DISK_TRACK + trk * 4, SEEK_SET) == 0) {
-    int32_t r;
-    if (osd_fread(&r, sizeof(r), 1, drive[drv].fp) == 1) {
+  int32_t r;
+  uint8_t buf[sizeof(r)];
+  const uint8_t *p = disk_view(drv, drive[drv].disk_top + DISK_TRACK + trk * 4, sizeof(r), buf, &error);
+  if (p) {
+    memcpy(&r, p, sizeof(r));
 
-      /* トラックおよび、先頭セクタの位置を設定   */
-      /* そのセクタのセクタ情報および、セクタ数を得る */
+    /* トラックおよび、先頭セクタの位置を設定   */
+    /* そのセクタのセクタ情報および、セクタ数を得る */
 
-      track_top = QUASI88::convert_le(r);
-      if (track_top != 0) {
-        drive[drv].track_top = drive[drv].sec_pos = drive[drv].disk_top + track_top;
-        drive[drv].sec_nr = disk_now_sec(drv);
-      } else {
-        drive[drv].track_top = drive[drv].sec_pos = drive[drv].disk_top;
-        drive[drv].sec_nr = -1;
-      }
-    } else
-      error = 1;
-  } else
-    error = 2;
+    track_top = QUASI88::convert_le(r);
+    if (track_top != 0) {
+      drive[drv].track_top = drive[drv].sec_pos = drive[drv].disk_top + track_top;
+      drive[drv].sec_nr = disk_now_sec(drv);
+    } else {
+      drive[drv].track_top = drive[drv].sec_pos = drive[drv].disk_top;
+      drive[drv].sec_nr = -1;
+    }
+  }
 
   if (error) { /* SEEK / READ Error */
     printf_system_error(error);
@@ -785,29 +847,27 @@ static void disk_now_track(int drv, int trk) {
 /*======================================================================*/
 static int disk_now_sec(int drv) {
   int error = 0;
-  uint8_t c[16];
+  uint8_t buf[SZ_DISK_ID];
+  const uint8_t *c;
 
   /* ファイル位置 sec_pos の ID情報 を読み、セクタ数を返す */
 
-  if (osd_fseek(drive[drv].fp, drive[drv].sec_pos, SEEK_SET) == 0) {
-    if (osd_fread(c, sizeof(uint8_t), 16, drive[drv].fp) == 16) {
-      sec_buf.c = c[DISK_C];
-      sec_buf.h = c[DISK_H];
-      sec_buf.r = c[DISK_R];
-      sec_buf.n = c[DISK_N];
-      sec_buf.density = c[DISK_DENSITY];
-      sec_buf.deleted = c[DISK_DELETED];
-      sec_buf.status = c[DISK_STATUS];
-      sec_buf.sec_nr = c[DISK_SEC_NR] + (int)c[DISK_SEC_NR + 1] * 256;
-      sec_buf.size = c[DISK_SEC_SZ] + (int)c[DISK_SEC_SZ + 1] * 256;
-      if (sec_buf.status == STATUS_CM) {
-        sec_buf.deleted = DISK_DELETED_TRUE;
-        sec_buf.status = STATUS_NORMAL;
-      }
-    } else
-      error = 1;
-  } else
-    error = 2;
+  c = disk_view(drv, drive[drv].sec_pos, SZ_DISK_ID, buf, &error);
+  if (c) {
+    sec_buf.c = c[DISK_C];
+    sec_buf.h = c[DISK_H];
+    sec_buf.r = c[DISK_R];
+    sec_buf.n = c[DISK_N];
+    sec_buf.density = c[DISK_DENSITY];
+    sec_buf.deleted = c[DISK_DELETED];
+    sec_buf.status = c[DISK_STATUS];
+    sec_buf.sec_nr = c[DISK_SEC_NR] + (int)c[DISK_SEC_NR + 1] * 256;
+    sec_buf.size = c[DISK_SEC_SZ] + (int)c[DISK_SEC_SZ + 1] * 256;
+    if (sec_buf.status == STATUS_CM) {
+      sec_buf.deleted = DISK_DELETED_TRUE;
+      sec_buf.status = STATUS_NORMAL;
+    }
+  }
 
   if (error) { /* SEEK / READ Error */
     printf_system_error(error);
@@ -866,6 +926,133 @@ static void disk_next_sec(int drv) {
   disk_now_sec(drv);
 }
 
+/*======================================================================*/
+/* トラック内のセクタの索引                         */
+/*  トラックの先頭から disk_next_sec と同じ順にセクタをたどり、各セクタ */
+/*  の ID を記録しておく。fdc_search_id は、これを使って目的のセクタ   */
+/*  までの回転を一度に進める。シークした後の最初の検索時に作成し、   */
+/*  ID が書き換わったら (WRITE DATA / WRITE ID) 作り直す。       */
+/*======================================================================*/
+typedef struct {
+  long pos;        /* ID のファイル位置          */
+  int sec;         /* drive[].sec の値            */
+  uint8_t c, h, r, n;
+  uint8_t density; /* 記録密度              */
+  uint8_t status;  /* ステータス (CM は NORMAL 扱い) */
+} T_SECTOR_INDEX;
+
+static struct {
+  int valid;                                          /* 真なら索引は有効 */
+  long track_top;                                     /* 索引のトラック    */
+  int exist_iam[2];                                   /* FM/MFM の IAM 有無 */
+  std::vector<T_SECTOR_INDEX> sector;                 /* 物理順のセクタ */
+  std::unordered_map<uint32_t, std::vector<int>> chrn; /* CHRN → sector[] */
+} track_index[NR_DRIVE];
+
+#define CHRN_KEY(c, h, r, n) (((uint32_t)(c) << 24) | ((uint32_t)(h) << 16) | ((uint32_t)(r) << 8) | (uint32_t)(n))
+
+/* sector_density_mismatch() と STATUS_MA の判定に同じ */
+#define index_has_iam(e, mf)                                                                                           \
+  ((e).status != STATUS_MA && !(((e).density == DISK_DENSITY_SINGLE && (mf)) ||                                     \
+                                ((e).density == DISK_DENSITY_DOUBLE && !(mf))))
+
+void disk_track_index_clear(int drv) { track_index[drv].valid = false; }
+
+static int track_index_build(int drv) {
+  int error = 0, sec = 0;
+  long pos = drive[drv].track_top;
+  uint8_t buf[SZ_DISK_ID];
+
+  track_index[drv].sector.clear();
+  track_index[drv].chrn.clear();
+  track_index[drv].exist_iam[0] = track_index[drv].exist_iam[1] = false;
+
+  if (disk_unformat(drv)) {
+    return false;
+  }
+
+  while (sec < drive[drv].sec_nr) {
+    const uint8_t *c = disk_view(drv, pos, SZ_DISK_ID, buf, &error);
+    if (c == nullptr) {
+      return false;
+    }
+
+    T_SECTOR_INDEX e;
+    e.pos = pos;
+    e.sec = sec;
+    e.c = c[DISK_C];
+    e.h = c[DISK_H];
+    e.r = c[DISK_R];
+    e.n = c[DISK_N];
+    e.density = c[DISK_DENSITY];
+    e.status = (c[DISK_STATUS] == STATUS_CM) ? STATUS_NORMAL : c[DISK_STATUS];
+
+    track_index[drv].chrn[CHRN_KEY(e.c, e.h, e.r, e.n)].push_back((int)track_index[drv].sector.size());
+    track_index[drv].exist_iam[0] |= index_has_iam(e, 0);
+    track_index[drv].exist_iam[1] |= index_has_iam(e, 1);
+    track_index[drv].sector.push_back(e);
+
+    /* 次のセクタへ (disk_next_sec と同じ計算) */
+    int size = c[DISK_SEC_SZ] + (int)c[DISK_SEC_SZ + 1] * 256;
+    int overwrite_id = 0;
+    if (size != 0x80 && (size & 0xff) != 0) {
+      overwrite_id = std::max(0, (size - (128 << (e.n & 7))) / SZ_DISK_ID);
+    }
+    sec += 1 + overwrite_id;
+    pos += size + SZ_DISK_ID;
+  }
+
+  track_index[drv].track_top = drive[drv].track_top;
+  track_index[drv].valid = true;
+  return true;
+}
+
+/*----------------------------------------------------------------------*/
+/* 索引を使って、現在のセクタから IDR に一致するセクタを探す     */
+/*  *cur に現在のセクタの索引番号をセットし、一致するセクタまでに   */
+/*  通過するセクタ数を返す。一致するセクタが無ければ -1 を返す。    */
+/*  索引が使えない場合 (現在位置が索引上に無い場合など) は -2 を返す  */
+/*----------------------------------------------------------------------*/
+static int track_index_find(int drv, int *cur) {
+  if (!track_index[drv].valid || track_index[drv].track_top != drive[drv].track_top) {
+    if (!track_index_build(drv)) {
+      return -2;
+    }
+  }
+
+  const std::vector<T_SECTOR_INDEX> &sector = track_index[drv].sector;
+  auto it = std::lower_bound(sector.begin(), sector.end(), drive[drv].sec_pos,
+                             [](const T_SECTOR_INDEX &e, long pos) { return e.pos < pos; });
+  if (it == sector.end() || it->pos != drive[drv].sec_pos || it->sec != drive[drv].sec) {
+    return -2;
+  }
+  *cur = (int)(it - sector.begin());
+
+  auto found = track_index[drv].chrn.find(CHRN_KEY(fdc.c, fdc.h, fdc.r, fdc.n));
+  if (found == track_index[drv].chrn.end()) {
+    return -1;
+  }
+
+  int m = (int)sector.size();
+  int skip = -1;
+  for (int i : found->second) {
+    if (index_has_iam(sector[i], fdc.mf)) {
+      int d = (i - *cur + m) % m;
+      if (skip < 0 || d < skip) {
+        skip = d;
+      }
+    }
+  }
+  return skip;
+}
+
+/* 索引番号 i のセクタに移動する */
+static void track_index_seek(int drv, int i) {
+  drive[drv].sec = track_index[drv].sector[i].sec;
+  drive[drv].sec_pos = track_index[drv].sector[i].pos;
+  disk_now_sec(drv);
+}
+
 /************************************************************************/
 /* FDC の初期化                             */
 /************************************************************************/
@@ -922,13 +1109,16 @@ void fdc_TC() { fdc.TC = true; }
 
 /* FDC処理ウェイトの制御 */
 
+/* 高速ディスクモード時は、ウエイトなしとして扱う */
+#define FDC_WAIT() (fdc_wait && !fdc_instant)
+
 #define ICOUNT(x)                                                                                                      \
   do {                                                                                                                 \
     fdc.wait = (x);                                                                                                    \
   } while (0)
 #define REPEAT()                                                                                                       \
   do {                                                                                                                 \
-    if (fdc_wait == false) {                                                                                           \
+    if (FDC_WAIT() == false) {                                                                                         \
       fdc.wait = 0;                                                                                                    \
     }                                                                                                                  \
   } while (0)
@@ -1034,7 +1224,7 @@ static int fdc_check_unit() {
 #ifdef WAIT_FOR_HEADLOAD
   if (fdc.hl_stat[drv] == false) {
     /* ロード音 ? */
-    if ((cpu_timing > 0) && (fdc_wait)) {
+    if ((cpu_timing > 0) && (FDC_WAIT())) {
       /*logfdc("### Head Down ###\n");*/
       xmame_dev_sample_headdown();
     }
@@ -1074,7 +1264,7 @@ static int fdc_check_unit() {
       disk_now_track(drv, ((drive[drv].track & ~1) | fdc.hd));
       fdc.carry = 0;
 
-      if (fdc_wait) {
+      if (FDC_WAIT()) {
         if (!disk_unformat(drv)) {
           for (i = 0; i < s; i++) { /* セクタ位置を移動  */
             if (drive[drv].sec >= s)
@@ -1155,6 +1345,33 @@ static int fdc_search_id() {
   else
     n = 5;
 
+  /* READ / WRITE の場合、索引で目的のセクタを探し、そこまで回転を進める */
+  /* (進めた分のウェイトは、1セクタずつ検索した場合と同じにする)       */
+
+  if (fdc.command != READ_DIAGNOSTIC && fdc.command != READ_ID) {
+    int cur, m, skip;
+
+    skip = track_index_find(drv, &cur);
+    if (skip >= 0) { /* 見つかった      */
+      m = (int)track_index[drv].sector.size();
+      fdc.wait += CLOCK_SECTOR(n) * skip;
+      if (cur > 0 && skip >= m - cur) { /* インデックスホールを通過 */
+        index_cnt++;
+        fdc.wait += CLOCK_GAP4(n) + CLOCK_GAP0();
+      }
+      track_index_seek(drv, (cur + skip) % m); /* 以下のループで即一致 */
+
+    } else if (skip == -1) { /* 見つからない   */
+      m = (int)track_index[drv].sector.size();
+      fdc.wait += CLOCK_SECTOR(n) * ((cur == 0) ? (2 * m) : (2 * m - cur));
+      fdc.wait += CLOCK_GAP4(n) + CLOCK_GAP0() + CLOCK_GAP4(n);
+      index_cnt = 2;
+      exist_iam = track_index[drv].exist_iam[fdc.mf ? 1 : 0];
+      track_index_seek(drv, 0);
+      goto FDC_SEARCH_ID_NOT_FOUND;
+    }
+  }
+
   while (true) {
 
     if (sector_density_mismatch() || /* このセクタには IAM がない         */
@@ -1222,22 +1439,7 @@ static int fdc_search_id() {
       fdc.wait += CLOCK_GAP4(n);
 
       if (index_cnt >= 2) { /* 合計で、2回検出した      */
-
-        fdc.st0 = ST0_IC_AT | (fdc.hd << 2) | fdc.us;
-        fdc.st1 = (exist_iam) ? ST1_ND : ST1_MA; /* IAMが1度でも */
-        fdc.st2 = (exist_iam) ? 0 /*↓*/ : 0;     /* 見つかったら */
-        if (exist_iam) {                         /* ステータスが */
-          if (fdc.c != fdc.pcn[drv]) {
-            fdc.st2 |= ST2_NC; /* 若干異なる   */
-            if (fdc.c == 0xff)
-              fdc.st2 |= ST2_BC;
-          }
-        }
-        if (fdc.command == READ_ID) {
-          fdc.c = fdc.h = fdc.r = fdc.n = 0xff;
-        }
-        fdc.carry = CLOCK_GAP0();
-        return 1;
+        goto FDC_SEARCH_ID_NOT_FOUND;
       }
 
       fdc.wait += CLOCK_GAP0();
@@ -1276,6 +1478,24 @@ static int fdc_search_id() {
   }
 
   return 1;
+
+FDC_SEARCH_ID_NOT_FOUND:
+
+  fdc.st0 = ST0_IC_AT | (fdc.hd << 2) | fdc.us;
+  fdc.st1 = (exist_iam) ? ST1_ND : ST1_MA; /* IAMが1度でも */
+  fdc.st2 = (exist_iam) ? 0 /*↓*/ : 0;     /* 見つかったら */
+  if (exist_iam) {                         /* ステータスが */
+    if (fdc.c != fdc.pcn[drv]) {
+      fdc.st2 |= ST2_NC; /* 若干異なる   */
+      if (fdc.c == 0xff)
+        fdc.st2 |= ST2_BC;
+    }
+  }
+  if (fdc.command == READ_ID) {
+    fdc.c = fdc.h = fdc.r = fdc.n = 0xff;
+  }
+  fdc.carry = CLOCK_GAP0();
+  return 1;
 }
 
 /*===========================================================================
@@ -1286,6 +1506,7 @@ static int fdc_search_id() {
 static int fdc_read_data() {
   int drv = (fdc.us);
   int read_size, size, ptr, error;
+  const uint8_t *p;
 
   print_fdc_status(((fdc.command == READ_DIAGNOSTIC) ? BP_DIAG : BP_READ), drv, drive[drv].track, drive[drv].sec);
 
@@ -1326,13 +1547,11 @@ static int fdc_read_data() {
   while (read_size > 0) { /* -------------------指定サイズ分読み続ける */
 
     size = MIN(read_size, sec_buf.size);
-    if (osd_fseek(drive[drv].fp, drive[drv].sec_pos + SZ_DISK_ID, SEEK_SET) == 0) {
-      if (osd_fread(&data_buf[ptr], sizeof(uint8_t), size, drive[drv].fp) == (size_t)size) {
-        error = 0;
-      } else
-        error = 1;
-    } else
-      error = 2;
+    error = 0;
+    p = disk_view(drv, drive[drv].sec_pos + SZ_DISK_ID, size, &data_buf[ptr], &error);
+    if (p && p != &data_buf[ptr]) {
+      memcpy(&data_buf[ptr], p, size);
+    }
     if (error) {                  /* OSレベルのエラー発生 */
       printf_system_error(error); /* DATA CRC err にする*/
       status_message(1, STATUS_WARN_TIME, "DiskI/O Read Error");
@@ -1569,7 +1788,10 @@ static int fdc_write_data() {
     sys_err = 1;
   }
 
-  osd_fflush(drive[drv].fp);
+  disk_set_dirty();
+  disk_track_index_clear(drv);
+  if (disk_same_file())
+    disk_track_index_clear(drv ^ 1);
 
   /* 途中、システムのエラーが起こったら異常終了する */
 
@@ -1753,7 +1975,7 @@ static int fdc_write_id() {
     printf_system_error(error);
   }
 
-  osd_fflush(drive[drv].fp);
+  disk_set_dirty();
 
   /* 途中、システムのエラーが起こったら異常終了する */
 
@@ -2127,7 +2349,7 @@ static void e_phase_seek() {
     sec_buf.drv = -1;
 
 #ifdef WAIT_FOR_SEEK
-    if (fdc_wait == false) {
+    if (FDC_WAIT() == false) {
 #endif
       fdc.pcn[fdc.us] = fdc.ncn[fdc.us];
       fdc.seek_stat[fdc.us] = SEEK_STAT_END;
@@ -2138,7 +2360,7 @@ static void e_phase_seek() {
 #ifdef WAIT_FOR_SEEK
     } else {
       /* シーク音 ? */
-      if ((cpu_timing > 0) && (fdc_wait)) {
+      if ((cpu_timing > 0) && (FDC_WAIT())) {
         fdc_sound_counter = 0;
         /*logfdc("### Seek ###\n");*/
         xmame_dev_sample_seek();
@@ -2273,7 +2495,7 @@ static int e_phase_read_recv(int interval) {
   if (fdc.limit < 0) { /* 一定時間経過でオーバーラン */
     /* fdc.st1 |= ST1_OR; */
     fdc.limit = 0;
-    if (fdc_wait)
+    if (FDC_WAIT())
       QLOG_DEBUG("fdc", "FDC {}: Over Run", cmd_name[fdc.command]);
   }
 
@@ -2512,7 +2734,7 @@ static int e_phase_write_respond(int interval) {
   if (fdc.limit < 0) { /* 一定時間経過でオーバーラン */
     /* fdc.st1 |= ST1_OR; */
     fdc.limit = 0;
-    if (fdc_wait)
+    if (FDC_WAIT())
       QLOG_DEBUG("fdc", "FDC {}: Over Run\n", cmd_name[fdc.command]);
   }
 
@@ -2702,7 +2924,7 @@ int fdc_ctrl(int interval) {
           fdc.seek_wait[i] = 0;
         } else { /* まだまだ */
           /* シーク音 ? */
-          if ((cpu_timing > 0) && (fdc_wait)) {
+          if ((cpu_timing > 0) && (FDC_WAIT())) {
             fdc_sound_counter++;
             if (fdc_sound_counter >= fdc_sound_skipper) {
               fdc_sound_counter = 0;
@@ -2730,7 +2952,7 @@ int fdc_ctrl(int interval) {
         if (fdc.hl_wait[i] >= fdc.hut_clk) {
           fdc.hl_stat[i] = false;
           /* アンロード音 ? */
-          if ((cpu_timing > 0) && (fdc_wait)) {
+          if ((cpu_timing > 0) && (FDC_WAIT())) {
             /*logfdc("### Head Up ###\n");*/
             xmame_dev_sample_headup();
           }
@@ -2944,6 +3166,10 @@ int fdc_ctrl(int interval) {
             break;
 
           case 3: /* イメージ書き込み - - - - -*/
+            if (runahead_hold_disk_write()) {
+              fdc.wait = -1; /* 先行実行中は、書き込まずに止まる */
+              break;
+            }
             e_phase_writeid_track();
             fdc.step = 4; /* FALLTHROUGH */
           case 4:         /* E-PHASE終了  - - - - - - -*/
@@ -2998,6 +3224,10 @@ int fdc_ctrl(int interval) {
             break;
 
           case 3: /* イメージ書き込み - - - - -*/
+            if (runahead_hold_disk_write()) {
+              fdc.wait = -1; /* 先行実行中は、書き込まずに止まる */
+              break;
+            }
             e_phase_write_sector();
             fdc.step = 4; /* FALLTHROUGH */
           case 4:         /* 1セクタ終了  - - - - - - -*/
@@ -3074,7 +3304,7 @@ int fdc_ctrl(int interval) {
   }
   /* w はシーク完了までの最短クロック数 または -1 がセットされている */
 
-  if (fdc_wait == false || /* ウエイトなし または          */
+  if (FDC_WAIT() == false || /* ウエイトなし または          */
       fdc.wait < 0) {      /* ウェイトありで無限待ちの場合 */
 
     ; /* w (シーク完了ないし無限) まで待つ */
@@ -3089,6 +3319,38 @@ int fdc_ctrl(int interval) {
   return w;
 }
 
+/************************************************************************/
+/* FDC がコマンドを処理していなければ真を返す関数                     */
+/************************************************************************/
+int fdc_idle(void) { return (fdc.command == WAIT); }
+
+/************************************************************************/
+/* 高速ディスクモードで、フレームのウエイトを省略するかどうかを返す関数 */
+/*  FDC がコマンド処理中か、処理終了から一定フレーム以内なら真を返す。  */
+/*  コマンドの合間もサブCPUは次の処理を行っているので、少し余裕を持つ。 */
+/*  1フレームに1回だけ呼び出すこと。                                    */
+/************************************************************************/
+#define FDC_INSTANT_LINGER (30) /* コマンド終了後、早送りを続けるフレーム数 */
+
+int fdc_instant_busy(void) {
+  static int idle_frames = FDC_INSTANT_LINGER;
+
+  if (fdc_instant == false) {
+    idle_frames = FDC_INSTANT_LINGER;
+    return false;
+  }
+
+  if (fdc.command != WAIT) {
+    idle_frames = 0;
+    return true;
+  }
+  if (idle_frames < FDC_INSTANT_LINGER) {
+    idle_frames++;
+    return true;
+  }
+  return false;
+}
+
 /************************************************************************/
 /* ドライブの状態を返す関数                     */
 /************************************************************************/
@@ -3360,6 +3622,8 @@ static T_SUSPEND_W suspend_fdc_work2[] = {
 };
 
 int statesave_fdc() {
+  disk_write_back(true);
+
   image_disk[0] = drive[0].selected_image;
   image_disk[1] = drive[1].selected_image;
 
@@ -3408,6 +3672,12 @@ int stateload_fdc() {
   return true;
 }
 
+uint64_t statehash_fdc() {
+  uint64_t h = statehash_table(suspend_fdc_work, 0);
+  h = hash64(data_buf, DATA_BUF_SIZE, h); /* データバッファ */
+  return statehash_table(suspend_fdc_work2, h);
+}
+
 /* デバッグ用の関数 */
 void monitor_fdc() {
   printf("com = %d phs = %d  step = %d\n", fdc.command, fdc.phase, fdc.step);
@@ -7,12 +7,16 @@ extern int fdc_debug_mode; /* FDC デバッグモードのフラグ        */
 extern int disk_exchange;  /* ディスク疑似入れ替えフラグ      */
 extern int disk_ex_drv;    /* ディスク疑似入れ替えドライブ       */
 
-extern int FDC_flag; /* FDC 割り込み信号   */
-extern int fdc_wait; /* FDC の ウエイト */
+extern int FDC_flag;    /* FDC 割り込み信号   */
+extern int fdc_wait;    /* FDC の ウエイト */
+extern int fdc_instant; /* 高速ディスクモード */
 
 extern int fdc_ignore_readonly; /* 読込専用時、ライトを無視する   */
+extern int disk_overlay;        /* 書き込みを差分ファイルに保存する */
 
 int fdc_ctrl(int interval);
+int fdc_instant_busy(void);
+int fdc_idle(void);
 
 void fdc_write(uint8_t data);
 uint8_t fdc_read();
@@ -5,13 +5,28 @@
 /*                                       */
 /*****************************************************************************/
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <filesystem>
+#include <string>
+#include <vector>
 
 #include "file-op.h"
 
+#include "archive.h"
+#include "disk-format.h"
+
+#include "Core/Log.h"
+
+#if defined(QUASI88_FUNIX)
+#include <sys/mman.h>
+#include <unistd.h>
+#elif defined(QUASI88_FWIN)
+#include <io.h>
+#endif
+
 /*****************************************************************************/
 
 struct T_DIR_INFO_STRUCT {
@@ -25,11 +40,33 @@ struct OSD_FILE_STRUCT {
   int type;     /* File type */
   char *path;   /* File path */
   char mode[4]; /* Mode on open */
+
+  /* Disk image held in memory (see osd_fopen) */
+  bool cached;                    /* Accesses go to data[] instead of fp */
+  long pos;                       /* Current position in data[] */
+  unsigned char *data;            /* Whole file contents (map or buf) */
+  size_t size;                    /* Size of data[] */
+  void *map;                      /* Mapping of the file, if any */
+  std::vector<unsigned char> buf; /* Copy of the file when not mapped */
+  std::vector<bool> dirty;        /* Modified flag per CACHE_PAGE bytes */
+  std::string overlay;            /* Write-back file instead of fp, if any */
+  bool delta;                     /* overlay holds modified pages only */
+  size_t base_size;               /* Size of the image before the overlay */
+  std::vector<long> slot;         /* Record number of each page in overlay */
+  const DiskImageFormat *format;  /* File format, if converted from non-D88 */
 };
 
 #define MAX_STREAM 8
 static OSD_FILE osd_stream[MAX_STREAM];
 
+#define CACHE_PAGE (256)                      /* Write-back unit */
+#define CACHE_MAX_SIZE (256L * 1024L * 1024L) /* Larger files are not cached */
+
+/* Delta overlay file: header, then records of (page number, page data) */
+#define DELTA_MAGIC "Q88DELTA"
+#define DELTA_HEADER_SIZE (20) /* magic[8], page size, base size, image size */
+#define DELTA_RECORD_SIZE (4 + CACHE_PAGE)
+
 /*
  * Following dir names are pre-allocated char arrays with OSD_MAX_FILENAME
  * length. Don't forget to malloc() and free() them.
@@ -44,6 +81,8 @@ static char *dir_save;  // Where to save saves
 static char *dir_home;  // Common directory of configuration
 static char *dir_ini;   // Directory for local configuration
 
+static int file_disk_overlay = false; /* ディスクの書き込みを差分ファイルへ */
+
 /* Gets directory pathnames (osd_dir_cwd should never returns NULL!) */
 const char *osd_dir_cwd() { return dir_cwd; }
 const char *osd_dir_rom() { return dir_rom; }
@@ -82,6 +121,8 @@ int osd_set_dir_lcfg(const char *d) { return set_new_dir(d, dir_ini); }
  * int  osd_fflush(OSD_FILE *stream)
  * int  osd_fseek(OSD_FILE *stream, long offset, int whence)
  * long osd_ftell(OSD_FILE *stream)
+ * const unsigned char *osd_fview(OSD_FILE *stream, long offset, size_t size)
+ * void osd_fprefetch(const char *path)
  * void osd_rewind(OSD_FILE *stream)
  * size_t osd_fread(void *ptr, size_t size, size_t nobj, OSD_FILE *stream)
  * size_t osd_fwrite(const void *ptr,size_t size,size_t nobj,OSD_FILE *stream)
@@ -91,6 +132,428 @@ int osd_set_dir_lcfg(const char *d) { return set_new_dir(d, dir_ini); }
  * int  osd_fputs(const char *str, OSD_FILE *stream)
  *****************************************************************************/
 
+/*
+ * ディスクイメージ ("r+b", "rb") は、開いた時点でファイル全体をメモリに
+ * 置き、以後の読み書きはメモリ上で行う。変更されたページは osd_fflush
+ * および osd_fclose の時点でまとめてファイルに書き戻す。
+ *
+ * QUASI88_FUNIX では、ファイルを mmap (MAP_PRIVATE) するので、開く時点
+ * ではファイルを読み込まない。書き込んだページはプロセス内でのみ複製され、
+ * ファイルへは書き戻しの時点で反映される。それ以外の環境ないし mmap に
+ * 失敗した場合は、ファイル全体を読み込む。
+ * (読み込みに失敗した場合や巨大なファイルは、従来どおり直接アクセスする)
+ *
+ * 圧縮されたディスクイメージ (.gz, .zip) は、展開した内容をメモリに置く。
+ * アーカイブ自体は書き換えず、変更内容は同じ場所の "<アーカイブ名>.d88"
+ * に書き出す。このファイルがあれば、次回以降はそちらを読み込む。
+ *
+ * オプション -diskoverlay 指定時は、"r+b" で開いたディスクイメージも
+ * ファイル自体は "rb" で開き、書き換えない。変更されたページだけを、
+ * セーブ用ディレクトリの差分ファイルに保存し、開く時に重ね合わせる。
+ * 差分ファイルはイメージのパス毎に別なので、共有された読込専用の
+ * イメージでも、それぞれの環境で書き込みができる。
+ *
+ * D88 以外の形式 (disk-format.h 参照) のイメージは、D88 に変換してメモリ
+ * に置く。書き戻す時は、元の形式に変換してファイル全体を書き直す。
+ */
+
+static bool cache_map(OSD_FILE *st, long size) {
+#if defined(QUASI88_FUNIX)
+  if (size > 0) {
+    int prot = (strchr(st->mode, '+')) ? (PROT_READ | PROT_WRITE) : PROT_READ;
+    void *p = mmap(nullptr, size, prot, MAP_PRIVATE, fileno(st->fp), 0);
+    if (p != MAP_FAILED) {
+      st->map = p;
+      st->data = (unsigned char *)p;
+      st->size = size;
+      return true;
+    }
+  }
+#endif
+  return false;
+}
+
+static void cache_unmap(OSD_FILE *st) {
+#if defined(QUASI88_FUNIX)
+  if (st->map) {
+    munmap(st->map, st->size);
+  }
+#endif
+  st->map = nullptr;
+}
+
+static bool cache_load(OSD_FILE *st) {
+  long size;
+
+  st->map = nullptr;
+  if (fseek(st->fp, 0, SEEK_END) != 0 || (size = ftell(st->fp)) < 0) {
+    return false;
+  }
+  try {
+    st->dirty.assign((size + CACHE_PAGE - 1) / CACHE_PAGE, false);
+
+    if (!cache_map(st, size)) {
+      if (size > CACHE_MAX_SIZE) {
+        return false;
+      }
+      st->buf.resize(size);
+      if (fseek(st->fp, 0, SEEK_SET) != 0 || fread(st->buf.data(), 1, size, st->fp) != (size_t)size) {
+        return false;
+      }
+      st->data = st->buf.data();
+      st->size = size;
+    }
+  } catch (const std::bad_alloc &) {
+    return false;
+  }
+  st->pos = 0;
+  st->cached = true;
+  return true;
+}
+
+static bool cache_load_archive(OSD_FILE *st) {
+  st->map = nullptr;
+  st->overlay = std::string(st->path) + ".d88";
+  try {
+    if (osd_file_stat(st->overlay.c_str()) == FILE_STAT_FILE) {
+      FILE *fp = fopen(st->overlay.c_str(), "rb");
+      long size;
+      bool ok = (fp && fseek(fp, 0, SEEK_END) == 0 && (size = ftell(fp)) >= 0 && fseek(fp, 0, SEEK_SET) == 0);
+      if (ok) {
+        st->buf.resize(size);
+        ok = (fread(st->buf.data(), 1, size, fp) == (size_t)size);
+      }
+      if (fp) {
+        fclose(fp);
+      }
+      if (!ok) {
+        return false;
+      }
+    } else if (!archive_extract(st->path, st->buf)) {
+      return false;
+    }
+    st->dirty.assign((st->buf.size() + CACHE_PAGE - 1) / CACHE_PAGE, false);
+  } catch (const std::bad_alloc &) {
+    return false;
+  }
+  st->data = st->buf.data();
+  st->size = st->buf.size();
+  st->pos = 0;
+  st->cached = true;
+  return true;
+}
+
+static bool cache_extend(OSD_FILE *st, size_t end);
+
+/* D88 以外の形式なら、D88 に変換する */
+static bool cache_convert(OSD_FILE *st) {
+  const DiskImageFormat *format = disk_format_probe(st->data, st->size, st->path);
+  if (format == disk_format_d88()) {
+    return true;
+  }
+  std::vector<unsigned char> d88;
+  if (!disk_format_convert(format, st->data, st->size, disk_format_d88(), d88)) {
+    return false;
+  }
+  cache_unmap(st);
+  st->buf.swap(d88);
+  st->data = st->buf.data();
+  st->size = st->buf.size();
+  st->pos = 0;
+  try {
+    st->dirty.assign((st->size + CACHE_PAGE - 1) / CACHE_PAGE, false);
+  } catch (const std::bad_alloc &) {
+    return false;
+  }
+  st->format = format;
+  return true;
+}
+
+/*
+ * "<path>.tmp" に書いてディスクに同期してから、path と置き換える。
+ * 途中で失敗しても、path は元のまま残る。
+ */
+static bool replace_file(const std::string &path, const unsigned char *data, size_t size) {
+  std::string tmp = path + ".tmp";
+  FILE *fp = fopen(tmp.c_str(), "wb");
+  if (fp == nullptr) {
+    return false;
+  }
+  bool ok = (fwrite(data, 1, size, fp) == size && fflush(fp) == 0);
+#if defined(QUASI88_FUNIX)
+  ok = ok && fsync(fileno(fp)) == 0;
+#elif defined(QUASI88_FWIN)
+  ok = ok && _commit(_fileno(fp)) == 0;
+#endif
+  if (fclose(fp) != 0) {
+    ok = false;
+  }
+
+  std::error_code ec;
+  if (ok) {
+    std::filesystem::rename(tmp, path, ec);
+    ok = !ec;
+  }
+  if (!ok) {
+    std::filesystem::remove(tmp, ec);
+  }
+  return ok;
+}
+
+/*
+ * 変換したイメージを元の形式に戻して、ファイル全体を置き換える。
+ * 元の形式で表せない内容になったら、D88 にして "<path>.d88" に保存し、
+ * 以後はそちらに書き戻す。
+ */
+static int cache_write_back_converted(OSD_FILE *st) {
+  if (std::find(st->dirty.begin(), st->dirty.end(), true) == st->dirty.end()) {
+    return 0;
+  }
+  std::vector<unsigned char> file;
+  if (!disk_format_convert(disk_format_d88(), st->data, st->size, st->format, file)) {
+    std::string copy = std::string(st->path) + ".d88";
+    QLOG_WARN("proc", "{}: can't be written as {} any more, saving to {}", st->path, st->format->name(), copy);
+    if (!replace_file(copy, st->data, st->size)) {
+      return EOF;
+    }
+    st->overlay = copy;
+    st->dirty.assign(st->dirty.size(), false);
+    return 0;
+  }
+  if (!replace_file(st->path, file.data(), file.size())) {
+    return EOF;
+  }
+  FILE *fp = fopen(st->path, st->mode); /* 置き換えたファイルを開き直す */
+  if (fp) {
+    fclose(st->fp);
+    st->fp = fp;
+  }
+  st->dirty.assign(st->dirty.size(), false);
+  return 0;
+}
+
+static void put32(unsigned char *p, uint32_t v) {
+  for (int i = 0; i < 4; i++) {
+    p[i] = (unsigned char)(v >> (i * 8));
+  }
+}
+static uint32_t get32(const unsigned char *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+
+/* 差分ファイル名は、イメージのファイル名とフルパスのハッシュから作る */
+static std::string delta_path(const char *path) {
+  uint32_t hash = 2166136261u; /* FNV-1a */
+  for (const char *p = path; *p; p++) {
+    hash = (hash ^ (unsigned char)*p) * 16777619u;
+  }
+  char suffix[16];
+  snprintf(suffix, sizeof(suffix), ".%08x.dlt", hash);
+
+  std::filesystem::path name = std::filesystem::path(path).filename();
+  return (std::filesystem::path(osd_dir_save()) / name).string() + suffix;
+}
+
+/* 差分ファイルがあれば、メモリ上のイメージに重ね合わせる */
+static bool delta_load(OSD_FILE *st) {
+  st->overlay = delta_path(st->path);
+  st->delta = true;
+  st->base_size = st->size; /* 拡張される前のサイズ */
+  st->slot.assign(st->dirty.size(), -1);
+
+  FILE *fp = fopen(st->overlay.c_str(), "rb");
+  if (fp == nullptr) {
+    return true; /* まだ書き込んでいない */
+  }
+
+  bool ok = false;
+  unsigned char header[DELTA_HEADER_SIZE];
+  unsigned char record[DELTA_RECORD_SIZE];
+  if (fread(header, 1, DELTA_HEADER_SIZE, fp) == DELTA_HEADER_SIZE &&
+      memcmp(header, DELTA_MAGIC, 8) == 0 && get32(&header[8]) == CACHE_PAGE) {
+    size_t image_size = get32(&header[16]);
+
+    if (get32(&header[12]) != st->base_size) { /* 元のイメージが変わっている */
+      QLOG_WARN("proc", "{}: image size mismatch, not used", st->overlay);
+    } else if (image_size <= st->size || cache_extend(st, image_size)) {
+      st->slot.resize(st->dirty.size(), -1);
+      st->size = std::min(st->size, image_size);
+      ok = true;
+      for (long n = 0; fread(record, 1, DELTA_RECORD_SIZE, fp) == DELTA_RECORD_SIZE; n++) {
+        size_t page = get32(record);
+        if (page < st->slot.size() && page * CACHE_PAGE < st->size) { /* 縮んだ分は捨てる */
+          size_t offset = page * CACHE_PAGE;
+          memcpy(&st->data[offset], &record[4], std::min((size_t)CACHE_PAGE, st->size - offset));
+          st->slot[page] = n;
+        }
+      }
+    }
+  }
+  fclose(fp);
+  return ok;
+}
+
+/* 変更されたページを差分ファイルに書き出す。既出のページは上書きする */
+static int delta_write_back(OSD_FILE *st) {
+  if (std::find(st->dirty.begin(), st->dirty.end(), true) == st->dirty.end()) {
+    return 0;
+  }
+
+  unsigned char header[DELTA_HEADER_SIZE];
+  unsigned char record[DELTA_RECORD_SIZE];
+  FILE *fp = fopen(st->overlay.c_str(), "r+b");
+  if (fp == nullptr) {
+    fp = fopen(st->overlay.c_str(), "w+b");
+    if (fp == nullptr) {
+      return EOF;
+    }
+    memcpy(header, DELTA_MAGIC, 8);
+    put32(&header[8], CACHE_PAGE);
+    put32(&header[12], (uint32_t)st->base_size); /* 元のイメージのサイズ */
+    put32(&header[16], (uint32_t)st->size);
+    if (fwrite(header, 1, DELTA_HEADER_SIZE, fp) != DELTA_HEADER_SIZE) {
+      fclose(fp);
+      return EOF;
+    }
+  }
+
+  int result = 0;
+  long nr_record = 1 + *std::max_element(st->slot.begin(), st->slot.end());
+  for (size_t page = 0; page < st->dirty.size(); page++) {
+    if (!st->dirty[page]) {
+      continue;
+    }
+    st->dirty[page] = false;
+    if (st->slot[page] < 0) {
+      st->slot[page] = nr_record++;
+    }
+    size_t offset = page * CACHE_PAGE;
+    size_t size = std::min((size_t)CACHE_PAGE, st->size - offset);
+    put32(record, (uint32_t)page);
+    memcpy(&record[4], &st->data[offset], size);
+    memset(&record[4 + size], 0, CACHE_PAGE - size);
+    if (fseek(fp, DELTA_HEADER_SIZE + st->slot[page] * DELTA_RECORD_SIZE, SEEK_SET) != 0 ||
+        fwrite(record, 1, DELTA_RECORD_SIZE, fp) != DELTA_RECORD_SIZE) {
+      result = EOF;
+    }
+  }
+
+  put32(header, (uint32_t)st->size); /* 現在のイメージのサイズ */
+  if (fseek(fp, 16, SEEK_SET) != 0 || fwrite(header, 1, 4, fp) != 4) {
+    result = EOF;
+  }
+  if (fclose(fp) != 0) {
+    result = EOF;
+  }
+  return result;
+}
+
+static void cache_release(OSD_FILE *st) {
+  cache_unmap(st);
+  st->cached = false;
+  st->data = nullptr;
+  st->size = 0;
+  std::vector<unsigned char>().swap(st->buf);
+  std::vector<bool>().swap(st->dirty);
+  st->overlay.clear();
+  st->delta = false;
+  st->base_size = 0;
+  std::vector<long>().swap(st->slot);
+  st->format = nullptr;
+}
+
+/* 変更されたページを、連続する範囲ごとにファイルへ書き戻す */
+static int cache_write_back(OSD_FILE *st) {
+  int result = 0;
+  size_t nr_page = st->dirty.size();
+  FILE *fp = st->fp;
+
+  if (st->delta) {
+    return delta_write_back(st);
+  }
+  if (st->format && st->overlay.empty()) {
+    return cache_write_back_converted(st);
+  }
+  if (!st->overlay.empty()) { /* 圧縮イメージは、別ファイルに書き出す */
+    if (std::find(st->dirty.begin(), st->dirty.end(), true) == st->dirty.end()) {
+      return 0;
+    }
+    fp = fopen(st->overlay.c_str(), "r+b");
+    if (fp == nullptr) { /* 初回は全体を書き出す */
+      fp = fopen(st->overlay.c_str(), "wb");
+      st->dirty.assign(nr_page, true);
+    }
+    if (fp == nullptr) {
+      return EOF;
+    }
+  }
+
+  for (size_t page = 0; page < nr_page;) {
+    if (!st->dirty[page]) {
+      page++;
+      continue;
+    }
+    size_t top = page;
+    while (page < nr_page && st->dirty[page]) {
+      st->dirty[page++] = false;
+    }
+    long offset = (long)(top * CACHE_PAGE);
+    size_t size = std::min(page * CACHE_PAGE, st->size) - top * CACHE_PAGE;
+    if (fseek(fp, offset, SEEK_SET) != 0 || fwrite(&st->data[offset], 1, size, fp) != size) {
+      result = EOF;
+    }
+  }
+  if (((fp == st->fp) ? fflush(fp) : fclose(fp)) != 0) {
+    result = EOF;
+  }
+  return result;
+}
+
+/* ファイルを end バイトに拡張する。マップ中ならメモリ上に複製に切り替える */
+static bool cache_extend(OSD_FILE *st, size_t end) {
+  try {
+    if (st->map) {
+      st->buf.assign(st->data, st->data + st->size);
+      cache_unmap(st);
+    }
+    st->buf.resize(end);
+    st->dirty.resize((end + CACHE_PAGE - 1) / CACHE_PAGE, false);
+    if (st->delta) {
+      st->slot.resize(st->dirty.size(), -1);
+    }
+  } catch (const std::bad_alloc &) {
+    return false;
+  }
+  st->data = st->buf.data();
+  st->size = end;
+  return true;
+}
+
+static size_t cache_read(OSD_FILE *st, void *ptr, size_t size, size_t nobj) {
+  long rest = (long)st->size - st->pos;
+  if (size == 0 || rest <= 0) {
+    return 0;
+  }
+  nobj = std::min(nobj, (size_t)rest / size);
+  memcpy(ptr, &st->data[st->pos], size * nobj);
+  st->pos += (long)(size * nobj);
+  return nobj;
+}
+
+static size_t cache_write(OSD_FILE *st, const void *ptr, size_t size, size_t nobj) {
+  if (strchr(st->mode, '+') == nullptr || size == 0 || nobj == 0) {
+    return 0; /* "rb" で開いたファイルには書けない */
+  }
+  size_t end = st->pos + size * nobj;
+  if (end > st->size && !cache_extend(st, end)) { /* 末尾を越える書き込み */
+    return 0;
+  }
+  memcpy(&st->data[st->pos], ptr, size * nobj);
+  for (size_t page = st->pos / CACHE_PAGE; page < (end + CACHE_PAGE - 1) / CACHE_PAGE; page++) {
+    st->dirty[page] = true;
+  }
+  st->pos = (long)end;
+  return nobj;
+}
+
 /*
  * 全てのファイルに対して排他制御したほうがいいと思うけど、面倒なので、
  * ディスク・テープのイメージに関してのみ、多重にオープンしないようにする。
@@ -153,11 +616,34 @@ OSD_FILE *osd_fopen(int type, const char *path, const char *mode) {
     if (st->path != nullptr) {
       strcpy(st->path, fullpath.string().c_str());
     }
-    st->fp = fopen(st->path, mode); /* ファイルを開く */
+    st->type = type;
+    strncpy(st->mode, mode, sizeof(st->mode));
+    st->cached = false;
+    if (type == FTYPE_DISK && st->path && archive_is_compressed(st->path)) {
+      st->fp = fopen(st->path, "rb"); /* アーカイブは読むだけ */
+      if (st->fp && !(cache_load_archive(st) && cache_convert(st))) {
+        cache_release(st);
+        fclose(st->fp);
+        st->fp = nullptr;
+      }
+    } else if (type == FTYPE_DISK && file_disk_overlay && st->path && strcmp(mode, "r+b") == 0) {
+      st->fp = fopen(st->path, "rb"); /* 書き込みは差分ファイルへ */
+      if (st->fp && !(cache_load(st) && cache_convert(st) && delta_load(st))) {
+        cache_release(st);
+        fclose(st->fp);
+        st->fp = nullptr;
+      }
+    } else {
+      st->fp = fopen(st->path, mode); /* ファイルを開く */
+    }
 
     if (st->fp) {
-      st->type = type;
-      strncpy(st->mode, mode, sizeof(st->mode));
+      if (st->cached) {
+        /* 圧縮イメージ、差分ありのイメージは読込済み */
+      } else if (type == FTYPE_DISK && mode[0] == 'r' && !(cache_load(st) && cache_convert(st))) {
+        cache_release(st);
+        rewind(st->fp);
+      }
       return st;
     } else {
       free(st->path);
@@ -167,44 +653,119 @@ OSD_FILE *osd_fopen(int type, const char *path, const char *mode) {
 }
 
 int osd_fclose(OSD_FILE *stream) {
+  int result = 0;
+  if (stream->cached) {
+    result = cache_write_back(stream); /* fp が開き直されることがある */
+    cache_release(stream);
+  }
   FILE *fp = stream->fp;
   stream->fp = nullptr;
   if (stream->path) {
     free(stream->path);
     stream->path = nullptr;
   }
-  return fclose(fp);
+  if (fclose(fp) != 0) {
+    result = EOF;
+  }
+  return result;
 }
 
 int osd_fflush(OSD_FILE *stream) {
-  if (stream == nullptr)
+  if (stream == nullptr) {
+    for (auto &i : osd_stream) {
+      if (i.fp && i.cached) {
+        cache_write_back(&i);
+      }
+    }
     return fflush(nullptr);
-  else
+  } else if (stream->cached) {
+    return cache_write_back(stream);
+  } else
     return fflush(stream->fp);
 }
 
-int osd_fseek(OSD_FILE *stream, long offset, int whence) { return fseek(stream->fp, offset, whence); }
+int osd_fseek(OSD_FILE *stream, long offset, int whence) {
+  if (stream->cached) {
+    long base = (whence == SEEK_SET) ? 0 : (whence == SEEK_CUR) ? stream->pos : (long)stream->size;
+    if (base + offset < 0) {
+      return -1;
+    }
+    stream->pos = base + offset;
+    return 0;
+  }
+  return fseek(stream->fp, offset, whence);
+}
+
+long osd_ftell(OSD_FILE *stream) { return (stream->cached) ? stream->pos : ftell(stream->fp); }
 
-long osd_ftell(OSD_FILE *stream) { return ftell(stream->fp); }
+void osd_fprefetch(const char *path) { archive_prefetch(path); }
+
+void osd_set_disk_overlay(int enable) { file_disk_overlay = enable; }
+
+const unsigned char *osd_fview(OSD_FILE *stream, long offset, size_t size) {
+  if (!stream->cached || offset < 0 || (size_t)offset > stream->size || size > stream->size - offset) {
+    return nullptr;
+  }
+  return &stream->data[offset];
+}
 
 void osd_rewind(OSD_FILE *stream) {
   (void)osd_fseek(stream, 0L, SEEK_SET);
   osd_fflush(stream);
 }
 
-size_t osd_fread(void *ptr, size_t size, size_t nobj, OSD_FILE *stream) { return fread(ptr, size, nobj, stream->fp); }
+size_t osd_fread(void *ptr, size_t size, size_t nobj, OSD_FILE *stream) {
+  if (stream->cached) {
+    return cache_read(stream, ptr, size, nobj);
+  }
+  return fread(ptr, size, nobj, stream->fp);
+}
 
 size_t osd_fwrite(const void *ptr, size_t size, size_t nobj, OSD_FILE *stream) {
+  if (stream->cached) {
+    return cache_write(stream, ptr, size, nobj);
+  }
   return fwrite(ptr, size, nobj, stream->fp);
 }
 
-int osd_fputc(int c, OSD_FILE *stream) { return fputc(c, stream->fp); }
+int osd_fputc(int c, OSD_FILE *stream) {
+  if (stream->cached) {
+    unsigned char b = (unsigned char)c;
+    return (cache_write(stream, &b, 1, 1) == 1) ? b : EOF;
+  }
+  return fputc(c, stream->fp);
+}
 
-int osd_fgetc(OSD_FILE *stream) { return fgetc(stream->fp); }
+int osd_fgetc(OSD_FILE *stream) {
+  if (stream->cached) {
+    unsigned char b;
+    return (cache_read(stream, &b, 1, 1) == 1) ? b : EOF;
+  }
+  return fgetc(stream->fp);
+}
 
-char *osd_fgets(char *str, int size, OSD_FILE *stream) { return fgets(str, size, stream->fp); }
+char *osd_fgets(char *str, int size, OSD_FILE *stream) {
+  if (stream->cached) {
+    int i = 0, c = 0;
+    while (i < size - 1 && c != '\n' && (c = osd_fgetc(stream)) != EOF) {
+      str[i++] = (char)c;
+    }
+    if (i == 0) {
+      return nullptr;
+    }
+    str[i] = '\0';
+    return str;
+  }
+  return fgets(str, size, stream->fp);
+}
 
-int osd_fputs(const char *str, OSD_FILE *stream) { return fputs(str, stream->fp); }
+int osd_fputs(const char *str, OSD_FILE *stream) {
+  if (stream->cached) {
+    size_t len = strlen(str);
+    return (cache_write(stream, str, 1, len) == len) ? 0 : EOF;
+  }
+  return fputs(str, stream->fp);
+}
 
 /****************************************************************************
  * ディレクトリ閲覧
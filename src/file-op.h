@@ -210,6 +210,11 @@ int osd_set_dir_lcfg(const char *new_dir);
  *  違うモードで開こうとした場合は NULL を、同じモードで開こうとした場合は
  *  その開いているファイルのファイルポインタを返す。
  *  (同じファイルが開いているかどうか検知できる場合のみ)
+ *  type が FTYPE_DISK で "r+b" / "rb" の場合は、ファイル全体をメモリに
+ *  置き (可能ならマップし)、以後の読み書きはメモリ上で行う。書き込んだ内容は osd_fflush
+ *  または osd_fclose を呼び出すまでファイルには反映されない。
+ *  圧縮されたディスクイメージ (.gz, .zip) は、展開した内容を扱う。
+ *  書き込んだ内容は、アーカイブと同じ場所の "<ファイル名>.d88" に反映する。
  *
  * int  osd_fclose(OSD_FILE *stream)
  *  fclose と同じ。失敗時でも EOF を返さなくてもかまわない。
@@ -223,6 +228,20 @@ int osd_set_dir_lcfg(const char *new_dir);
  * long osd_ftell(OSD_FILE *stream)
  *  ftell と同じ。失敗時には -1 を返す。
  *
+ * const unsigned char *osd_fview(OSD_FILE *stream, long offset, size_t size)
+ *  メモリ上に置かれたディスクイメージの、offset から size バイトを直接
+ *  参照するポインタを返す。ファイル位置は変化しない。メモリ上に無い
+ *  ファイルや、範囲がファイル末尾を越える場合は NULL を返す。
+ *  ポインタは、次に osd_fwrite などで書き込むまで有効。
+ *
+ * void osd_fprefetch(const char *path)
+ *  path がまもなくディスクイメージとして開かれることを通知する。
+ *  圧縮されたイメージなら、バックグラウンドで展開を始めておく。
+ *
+ * void osd_set_disk_overlay(int enable)
+ *  真なら、以降 "r+b" で開くディスクイメージには書き込まず、変更を
+ *  差分ファイル (osd_dir_save() 以下) に保存する。
+ *
  * void osd_rewind(OSD_FILE *stream)
  *  rewind と同じ。
  *
@@ -251,6 +270,9 @@ int osd_fclose(OSD_FILE *stream);
 int osd_fflush(OSD_FILE *stream);
 int osd_fseek(OSD_FILE *stream, long offset, int whence);
 long osd_ftell(OSD_FILE *stream);
+const unsigned char *osd_fview(OSD_FILE *stream, long offset, size_t size);
+void osd_fprefetch(const char *path);
+void osd_set_disk_overlay(int enable);
 void osd_rewind(OSD_FILE *stream);
 size_t osd_fread(void *ptr, size_t size, size_t nobj, OSD_FILE *stream);
 size_t osd_fwrite(const void *ptr, size_t size, size_t nobj, OSD_FILE *stream);
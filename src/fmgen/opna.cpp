@@ -323,6 +323,16 @@ void OPN::ResetStatus(uint bit)
         Intr(false);
 }
 
+//  無音判定 (FM 全チャンネルの EG 終了、かつ PSG 音量 0)
+bool OPN::IsSilent()
+{
+    for (int i=0; i<3; i++)
+        for (int j=0; j<4; j++)
+            if (ch[i].op[j].IsOn())
+                return false;
+    return psg.IsSilent();
+}
+
 //  マスク設定
 void OPN::SetChannelMask(uint mask)
 {
@@ -1242,6 +1252,20 @@ void OPNA::Reset()
     OPNABase::Reset();
 }
 
+// ---------------------------------------------------------------------------
+//  無音判定
+//  FM 全チャンネルの EG 終了、PSG 音量 0、ADPCM/リズム 停止中なら真
+//
+bool OPNA::IsSilent()
+{
+    int nch = (reg29 & 0x80) ? 6 : 3;
+    for (int i=0; i<nch; i++)
+        for (int j=0; j<4; j++)
+            if (ch[i].op[j].IsOn())
+                return false;
+    return psg.IsSilent() && !adpcmplay && !(rhythmkey & 0x3f);
+}
+
 // ---------------------------------------------------------------------------
 //  サンプリングレート変更
 //
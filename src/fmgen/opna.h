@@ -236,6 +236,7 @@ namespace FM
         uint    GetReg(uint addr);
         uint    ReadStatus() { return status & 0x03; }
         uint    ReadStatusEx() { return 0xff; }
+        bool    IsSilent();
         
         void    SetChannelMask(uint mask);
         
@@ -272,6 +273,7 @@ namespace FM
         void    Reset();
         void    SetReg(uint addr, uint data);
         uint    GetReg(uint addr);
+        bool    IsSilent();
 
         void    SetVolumeADPCM(int db);
         void    SetVolumeRhythmTotal(int db);
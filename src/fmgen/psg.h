@@ -68,6 +68,7 @@ public:
     void Reset();
     void SetReg(uint regnum, uint8 data);
     uint GetReg(uint regnum) { return reg[regnum & 0x0f]; }
+    bool IsSilent() { return ((reg[8] | reg[9] | reg[10]) & 0x1f) == 0; }
 
 protected:
     void MakeNoiseTable();
@@ -17,14 +17,19 @@
 #include "file-op.h"
 #include "fname.h"
 #include "getconf.h"
+#include "hash-log.h"
 #include "initval.h"
 #include "intr.h"
 #include "keyboard.h"
 #include "memory.h"
 #include "menu.h"
 #include "monitor.h"
+#include "output-sink.h"
 #include "pc88main.h"
 #include "pc88sub.h"
+#include "replay.h"
+#include "rewind.h"
+#include "runahead.h"
 #include "screen.h"
 #include "snapshot.h"
 #include "snddrv.h"
@@ -67,6 +72,8 @@ static const struct {
     {FN_MAX_SPEED, "MAX-SPEED"},
     {FN_MAX_CLOCK, "MAX-CLOCK"},
     {FN_MAX_BOOST, "MAX-BOOST"},
+    {FN_REWIND, "REWIND"},
+    {FN_VIDEO, "VIDEO"},
 };
 
 /*----------------------------------------------------------------------*/
@@ -320,6 +327,7 @@ static int o_diskdir(char *dir) { return oo_setdir(1, dir); }
 static int o_tapedir(char *dir) { return oo_setdir(2, dir); }
 static int o_snapdir(char *dir) { return oo_setdir(3, dir); }
 static int o_statedir(char *dir) { return oo_setdir(4, dir); }
+static int o_savedir(char *dir) { return oo_setdir(5, dir); }
 
 static int oo_image(char **filename) {
   if (strlen(*filename) >= QUASI88_MAX_FILENAME) {
@@ -398,6 +406,8 @@ static const T_CONFIG_TABLE option_table[] = {
     {33, "cpu2us", X_INT, &cpu_slice_us, 1, 1000, nullptr, nullptr},
     {34, "fdc_wait", X_FIX, &fdc_wait, 1, 0, nullptr, OPT_SAVE},
     {34, "fdc_nowait", X_FIX, &fdc_wait, 0, 0, nullptr, OPT_SAVE},
+    {34, "fdc_instant", X_FIX, &fdc_instant, 1, 0, nullptr, OPT_SAVE},
+    {34, "fdc_noinstant", X_FIX, &fdc_instant, 0, 0, nullptr, OPT_SAVE},
     {35, "clock", X_DBL, &cpu_clock_mhz, 0.001, 65536.0, nullptr, OPT_SAVE},
     {36, "speed", X_INT, &wait_rate, 5, 5000, nullptr, OPT_SAVE},
     {37, "nowait", X_FIX, &no_wait, true, 0, nullptr, OPT_SAVE},
@@ -523,6 +533,8 @@ static const T_CONFIG_TABLE option_table[] = {
     {165, "noswapdrv", X_FIX, &menu_swapdrv, false, 0, nullptr, OPT_SAVE},
     {166, "menucursor", X_FIX, &use_swcursor, true, 0, nullptr, nullptr},
     {166, "nomenucursor", X_FIX, &use_swcursor, false, 0, nullptr, nullptr},
+    {167, "wav", X_FIX, &waveout_format, WAVEOUT_FMT_WAV, 0, nullptr, OPT_SAVE},
+    {167, "flac", X_FIX, &waveout_format, WAVEOUT_FMT_FLAC, 0, nullptr, OPT_SAVE},
 
     /* 181〜250: システム設定オプション */
 
@@ -548,6 +560,16 @@ static const T_CONFIG_TABLE option_table[] = {
     {196, "diskimage", X_STR, &config_image.d[DRIVE_1], 0, 0, o_diskimage, nullptr},
     {197, "saveconfig", X_FIX, &save_config, true, 0, nullptr, OPT_SAVE},
     {197, "nosaveconfig", X_FIX, &save_config, false, 0, nullptr, OPT_SAVE},
+    {198, "savedir", X_STR, nullptr, 0, 0, o_savedir, nullptr},
+    {199, "diskoverlay", X_FIX, &disk_overlay, true, 0, nullptr, OPT_SAVE},
+    {199, "nodiskoverlay", X_FIX, &disk_overlay, false, 0, nullptr, OPT_SAVE},
+    {200, "outputdrop", X_FIX, &output_sink_drop, true, 0, nullptr, OPT_SAVE},
+    {200, "nooutputdrop", X_FIX, &output_sink_drop, false, 0, nullptr, OPT_SAVE},
+    {201, "rewind", X_INT, &rewind_interval, 0, 3600, nullptr, OPT_SAVE},
+    {201, "norewind", X_FIX, &rewind_interval, 0, 0, nullptr, OPT_SAVE},
+    {202, "rewindmem", X_INT, &rewind_memory, 1, 4096, nullptr, OPT_SAVE},
+    {203, "runahead", X_INT, &runahead_frames, 0, 8, nullptr, OPT_SAVE},
+    {203, "norunahead", X_FIX, &runahead_frames, 0, 0, nullptr, OPT_SAVE},
 
     /* 251〜299: デバッグ用オプション */
 
@@ -568,6 +590,10 @@ static const T_CONFIG_TABLE option_table[] = {
     {263, "nolinear_ram", X_FIX, &linear_ext_ram, false, 0, nullptr, nullptr},
     {264, "cmd_sing", X_FIX, &use_cmdsing, true, 0, nullptr, nullptr},
     {264, "no_cmd_sing", X_FIX, &use_cmdsing, false, 0, nullptr, nullptr},
+    {265, "playbackseek", X_INT, &replay_seek_seconds, 0, 86400, nullptr, nullptr},
+    {266, "replaykey", X_INT, &replay_key_seconds, 0, 3600, nullptr, nullptr},
+    {267, "hashlog", X_STR, &file_hashlog, 0, 0, nullptr, nullptr},
+    {268, "videoout", X_STR, &file_videoout, 0, 0, nullptr, nullptr},
 
 #ifdef USE_MONITOR
     {271, "debug", X_FIX, &debug_mode, true, 0, nullptr, nullptr},
@@ -622,6 +648,9 @@ static const T_CONFIG_TABLE option_table[] = {
     {0, "noao", X_INV, 0, 0, 0, 0, 0},
     {0, "fmgen", X_INV, 0, 0, 0, 0, 0},
     {0, "nofmgen", X_INV, 0, 0, 0, 0, 0},
+    {0, "soundthread", X_INV, 0, 0, 0, 0, 0},
+    {0, "nosoundthread", X_INV, 0, 0, 0, 0, 0},
+    {0, "resample", X_INV, &invalid_arg, 0, 0, 0, 0},
     {0, "fmvol", X_INV, &invalid_arg, 0, 0, 0, 0},
     {0, "fv", X_INV, &invalid_arg, 0, 0, 0, 0},
     {0, "psgvol", X_INV, &invalid_arg, 0, 0, 0, 0},
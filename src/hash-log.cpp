@@ -0,0 +1,161 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+#include "quasi88.h"
+
+#include "hash-log.h"
+
+#include "Core/Log.h"
+
+#include "file-op.h"
+#include "hash64.h"
+#include "memory.h"
+#include "output-sink.h"
+#include "suspend.h"
+
+char *file_hashlog = nullptr;
+
+static OSD_FILE *fp_log;
+static OutputSink sink_log;
+static uint64_t last[HASH_LOG_NBLOCKS];
+static bool first;
+static std::vector<uint8_t> record;
+
+/* Extended RAM is hashed bank by bank, only the banks that may have changed */
+static std::vector<uint8_t> ext_hash; /* Hash of each bank, 8 bytes each */
+static std::vector<bool> ext_dirty;
+static int ext_writable = -1;
+
+/* Time spent in hash_log_frame(), logged at exit */
+static uint64_t time_frames;
+static std::chrono::nanoseconds time_total, time_max;
+
+static void put32(uint8_t *p, uint32_t v) {
+  p[0] = v & 0xff;
+  p[1] = (v >> 8) & 0xff;
+  p[2] = (v >> 16) & 0xff;
+  p[3] = (v >> 24) & 0xff;
+}
+
+void hash_log_init() {
+  if (file_hashlog == nullptr || file_hashlog[0] == '\0') {
+    return;
+  }
+  fp_log = osd_fopen(FTYPE_WRITE, file_hashlog, "wb");
+  if (fp_log == nullptr) {
+    QLOG_WARN("proc", "Can't open <{}>: Hash log is invalid", file_hashlog);
+    return;
+  }
+  sink_log.attach(fp_log, false); /* Records are deltas of the previous one */
+
+  uint8_t header[HASH_LOG_HEADER_SIZE + 4 * HASH_LOG_NBLOCKS];
+  memcpy(header, HASH_LOG_MAGIC, sizeof(HASH_LOG_MAGIC));
+  put32(&header[8], HASH_LOG_VERSION);
+  put32(&header[12], HASH_LOG_NBLOCKS);
+  for (int i = 0; i < HASH_LOG_NBLOCKS; i++) {
+    memcpy(&header[HASH_LOG_HEADER_SIZE + 4 * i], HASH_LOG_BLOCKS[i], 4);
+  }
+  if (!sink_log.write(header, sizeof(header))) {
+    hash_log_exit();
+    return;
+  }
+  first = true;
+  ext_dirty.clear(); /* All banks in the first frame */
+  time_frames = 0;
+  time_total = time_max = std::chrono::nanoseconds::zero();
+  QLOG_DEBUG("proc", "Hash log file <{}> ... OK", file_hashlog);
+}
+
+void hash_log_ext_ram_writable(int bank) {
+  ext_writable = bank;
+  if (bank >= 0 && (size_t)bank < ext_dirty.size()) {
+    ext_dirty[bank] = true;
+  }
+}
+
+void hash_log_ext_ram_changed() { ext_dirty.assign(ext_dirty.size(), true); }
+
+static uint64_t hash_ext_ram(uint64_t seed) {
+  size_t banks = (size_t)use_extram * 4;
+  if (ext_dirty.size() != banks) {
+    ext_hash.assign(banks * 8, 0);
+    ext_dirty.assign(banks, true);
+  }
+  for (size_t i = 0; i < banks; i++) {
+    if (ext_dirty[i] || (int)i == ext_writable) { /* Still writable, may change again */
+      uint64_t h = hash64(ext_ram[i], 0x8000);
+      put32(&ext_hash[i * 8], (uint32_t)h);
+      put32(&ext_hash[i * 8 + 4], (uint32_t)(h >> 32));
+      ext_dirty[i] = false;
+    }
+  }
+  return hash64(ext_hash.data(), ext_hash.size(), seed);
+}
+
+void hash_log_frame() {
+  if (fp_log == nullptr) {
+    return;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  uint64_t hash[HASH_LOG_NBLOCKS];
+  uint64_t h;
+
+  hash[0] = statehash_pc88main();
+  hash[1] = statehash_pc88sub();
+  h = hash64(main_ram, 0x10000);
+  h = hash64(main_high_ram, 0x1000, h);
+  if (use_extram) {
+    h = hash_ext_ram(h);
+  }
+  hash[2] = h;
+  hash[3] = hash64(main_vram, 4 * 0x4000);
+  hash[4] = hash64(&sub_romram[0x4000], 0x4000);
+  hash[5] = statehash_fdc();
+  hash[6] = statehash_sound();
+
+  /* Only the blocks that changed since the previous frame */
+  uint8_t mask = 0;
+  record.assign(1, 0);
+  for (int i = 0; i < HASH_LOG_NBLOCKS; i++) {
+    if (first || hash[i] != last[i]) {
+      mask |= 1 << i;
+      uint8_t b[8];
+      put32(&b[0], (uint32_t)hash[i]);
+      put32(&b[4], (uint32_t)(hash[i] >> 32));
+      record.insert(record.end(), b, b + 8);
+      last[i] = hash[i];
+    }
+  }
+  record[0] = mask;
+  first = false;
+
+  bool ok = sink_log.write(record.data(), record.size());
+
+  auto time = std::chrono::steady_clock::now() - start;
+  time_frames++;
+  time_total += time;
+  time_max = std::max<std::chrono::nanoseconds>(time_max, time);
+
+  if (!ok) {
+    QLOG_WARN("proc", "Can't write Hash log file <{}>", file_hashlog);
+    hash_log_exit();
+  }
+}
+
+void hash_log_exit() {
+  if (fp_log) {
+    if (time_frames) {
+      double average = time_total.count() / 1000.0 / time_frames;
+      QLOG_INFO("proc", "Hash log: {} frames, {:.1f} us per frame ({:.2f}% of 60Hz), {:.1f} us at most", time_frames,
+                average, average * 60 / 10000, time_max.count() / 1000.0);
+    }
+    sink_log.detach();
+    osd_fclose(fp_log);
+    fp_log = nullptr;
+  }
+}
@@ -0,0 +1,62 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#pragma once
+
+/*
+ * Frame hash log (-hashlog), for checking that two runs or two builds
+ * emulate identically.
+ *
+ * At the end of every emulated frame a 64-bit hash (hash64()) is taken of
+ * each block of the machine below and written to the log. quasi88-hashcmp
+ * compares two logs and reports the first frame that differs, and which
+ * blocks differ in it.
+ *
+ * File format (little endian):
+ *
+ *   Header   "Q88HLOG" and a zero byte   8 bytes
+ *            Version                     4 bytes
+ *            Number of blocks            4 bytes
+ *            ID of each block            4 bytes each
+ *   Frame    Mask                        1 byte, bit n set if block n
+ *                                        changed since the previous frame
+ *            Hash of each changed block  8 bytes each
+ *     :
+ *
+ * All blocks are in the mask of the first frame.
+ *
+ * Extended RAM (up to 8MB) is hashed one 32KB bank at a time, and a bank is
+ * hashed again only after it was writable or changed outside the CPU, so
+ * MRAM costs about the same with any number of cards. tests/hash-benchmark
+ * measures the rest; hash_log_exit() logs the time taken per frame.
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+constexpr char HASH_LOG_MAGIC[8] = {'Q', '8', '8', 'H', 'L', 'O', 'G', '\0'};
+constexpr uint32_t HASH_LOG_VERSION = 1;
+constexpr size_t HASH_LOG_HEADER_SIZE = 16;
+constexpr int HASH_LOG_MAX_BLOCKS = 8;
+
+/* Blocks written by this version */
+constexpr char HASH_LOG_BLOCKS[][5] = {
+    "MAIN", /* Main CPU and main board I/O (statehash_pc88main()) */
+    "SUB ", /* Sub CPU */
+    "MRAM", /* Main RAM, high RAM and extended RAM */
+    "VRAM",
+    "SRAM", /* Sub RAM */
+    "FDC ",
+    "SND ", /* Sound chip registers and ADPCM RAM */
+};
+constexpr int HASH_LOG_NBLOCKS = sizeof(HASH_LOG_BLOCKS) / sizeof(HASH_LOG_BLOCKS[0]);
+static_assert(HASH_LOG_NBLOCKS <= HASH_LOG_MAX_BLOCKS, "the mask is 8 bits");
+
+extern char *file_hashlog; /* -hashlog <file> */
+
+void hash_log_init();
+void hash_log_frame();
+void hash_log_exit();
+
+/* Bank of extended RAM the CPU can write from now on (-1 for none) */
+void hash_log_ext_ram_writable(int bank);
+/* Extended RAM was changed other than by the CPU, e.g. by reset or state load */
+void hash_log_ext_ram_changed();
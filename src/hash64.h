@@ -0,0 +1,12 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#pragma once
+
+/*
+ * 64-bit non-cryptographic hash (the XXH64 algorithm). Fast enough to run
+ * over the whole RAM every frame.
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+uint64_t hash64(const void *data, size_t size, uint64_t seed = 0);
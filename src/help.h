@@ -41,6 +41,8 @@ static  void    help_msg_common(void)
    "  ** EMULATION **\n"
    "    -cpu <0/1/2>            Main-Sub CPU control timing [%d]\n"
    "    -fdc_wait/-fdc_nowait   Enable/Disable FDC wait [-fdc_nowait]\n"
+   "    -fdc_instant/-fdc_noinstant\n"
+   "                            Fast-forward while the disk is accessed [-fdc_noinstant]\n"
    "    -clock <rate>           CPU clock MHz (0.1..999.9) [%6.4f]\n"
    "    -speed <rate>           Set speed rate (5..5000%%) [100]\n"
    "    -nowait                 No wait ( ignore option '-speed' )\n"
@@ -86,7 +88,8 @@ static  void    help_msg_common(void)
    "                               PAUSE,RESIZE,NOWAIT,SPEED-UP,SPEED-DOWN,\n"
    "                               FULLSCREEN,SNAPSHOT,MAX-CLOCK,MAX-BOOST\n"
    "                               IMAGE-NEXT1,IMAGE-PREV1,IMAGE-NEXT2,IMAGE-PREV2,\n"
-   "                               NUMLOCK,RESET,KANA,ROMAJI,CAPS,STATUS,MENU )\n"
+   "                               NUMLOCK,RESET,KANA,ROMAJI,CAPS,STATUS,MENU,\n"
+   "                               REWIND,VIDEO )\n"
    "    -romaji <type>          Set ROMAJI-HENKAN type (0:egg/1:MS-IME/2:ATOK) [0]\n"
    "    -kanjikey               Assign F6-F10 Key for KANJI-input\n"
    "    -joyswap                Swap Joystick Button A<-->B\n"
@@ -99,6 +102,7 @@ static  void    help_msg_common(void)
    "    -bmp/-ppm/-raw/-png     Screen snapshot file format [-bmp]\n"
    "    -swapdrv                Change display position of Menu-Disk-Tab\n"
    "    -menucursor             Display mouse cursor in menu mode\n"
+   "    -wav/-flac              Sound record file format [-wav]\n"
    "  ** MISC **\n"
    "    -romdir <path>          Set directory of ROM image file\n"
    "    -diskdir <path>         Set directory of DISK image file\n"
@@ -113,6 +117,20 @@ static  void    help_msg_common(void)
    "    -sleep/-nosleep         Sleep/Not sleep during idle [-sleep]\n"
    "    -ro/-rw                 Open disk image file as read-only/read-write [-rw]\n"
    "    -ignore_ro              Treat RO disk image file as RW\n"
+   "    -savedir <path>         Set directory of disk overlay files\n"
+   "    -diskoverlay/-nodiskoverlay\n"
+   "                            Save disk writes to overlay files in savedir,\n"
+   "                            leaving the image untouched [-nodiskoverlay]\n"
+   "    -outputdrop/-nooutputdrop\n"
+   "                            Drop/Wait when printer, serial or tape output\n"
+   "                            can't keep up [-nooutputdrop]\n"
+   "    -rewind <frames>/-norewind\n"
+   "                            Keep a state every <frames> frames for the\n"
+   "                            REWIND key (0:off) [-norewind]\n"
+   "    -rewindmem <MB>         Set memory for rewind states [64]\n"
+   "    -runahead <frames>/-norunahead\n"
+   "                            Show the screen <frames> frames ahead to cut\n"
+   "                            input latency (0:off) [-norunahead]\n"
    "  ** DEBUG **\n"
    "    -help                   Print this help page\n"
    "    -verbose <level>        Select debugging messages [0x%02x]\n"
@@ -126,6 +144,12 @@ static  void    help_msg_common(void)
    "    -serialin <filename>    Set serial input from file\n"
    "    -record <filename>      Record all key inputs to the file <filename>\n"
    "    -playback <filename>    Play back all key inputs from the file <filename>\n"
+   "    -playbackseek <sec>     Start playback at <sec> seconds [0]\n"
+   "    -replaykey <sec>        Interval of keyframes in record file (0:first only)\n"
+   "                            [10]\n"
+   "    -hashlog <filename>     Write hashes of the machine state every frame to\n"
+   "                            <filename> (compare with quasi88-hashcmp)\n"
+   "    -videoout <filename>    Capture video and sound to <filename> (AVI)\n"
    "    -timestop               Freeze real-time-clock\n"
    "    -vsync <hz>             Set VSYNC frequency [55.4]\n"
 #ifdef  USE_MONITOR
@@ -39,6 +39,17 @@ int d88_read_header(OSD_FILE *fp, long offset, char header[32]) {
   long current;
   int result = D88_SUCCESS;
 
+  /* メモリ上にあるイメージは、直接参照する (ファイル位置は変化しない) */
+
+  const unsigned char *p = osd_fview(fp, offset, 32);
+  if (p) {
+    memcpy(header, p, 32);
+    size = READ_SIZE_IN_HEADER(header);
+    if (osd_fview(fp, offset + size - 1, 1) == nullptr)
+      result = D88_BAD_IMAGE;
+    return result;
+  }
+
   if ((current = osd_ftell(fp)) < 0)
     result = D88_ERR_SEEK;
 
@@ -485,6 +496,13 @@ int d88_write_unformat(OSD_FILE *fp, int drv, int img) {
     return D88_ERR_SEEK;
   }
 
+  /* ドライブにセットされたファイル更新時は、セクタの索引を破棄 */
+
+  if (result == D88_SUCCESS && drv >= 0) {
+    disk_track_index_clear(0);
+    disk_track_index_clear(1);
+  }
+
   return result;
 }
 
@@ -628,6 +646,7 @@ int d88_write_format(OSD_FILE *fp, int drv, int img) {
 
     for (i = 0; i < 2; i++, drv ^= 1) {
       drive[drv].image[img].type = DISK_TYPE_2D;
+      disk_track_index_clear(drv);
 
       if (drive[0].fp != drive[1].fp)
         break;
@@ -14,8 +14,11 @@
 #include "pause.h"
 #include "pc88cpu.h" /* z80main_cpu          */
 #include "pc88main.h" /* boot_clock_4mhz      */
+#include "replay.h"
+#include "rewind.h"
 #include "romaji.h"
 #include "screen.h"
+#include "snapshot.h"
 #include "snddrv.h"   /* xmame_XXX            */
 #include "soundbd.h" /* sound_reg[]          */
 #include "status.h"
@@ -129,9 +132,6 @@ int romaji_type = 0; /* ローマ字変換のタイプ       */
 char *file_rec = nullptr; /* キー入力記録のファイル名 */
 char *file_pb = nullptr;  /* キー入力再生のファイル名 */
 
-static OSD_FILE *fp_rec;
-static OSD_FILE *fp_pb;
-
 static struct {  /* キー入力記録構造体      */
   uint8_t key[16]; /*  I/O 00H〜0FH       */
   char dx_h;     /*  マウス dx 上位     */
@@ -141,6 +141,7 @@ static struct {  /* キー入力記録構造体      */
   char image[2]; /*  イメージNo -1空,0同,1〜  */
   char resv[2];
 } key_record; /* 24 bytes         */
+static_assert(sizeof(key_record) == REPLAY_INPUT_SIZE, "key_record is a replay input record");
 
 /*---------------------------------------------------------------------------
  * キーのバインディング変更 (キーコード、機能)
@@ -625,14 +626,11 @@ void key_record_playback_init(void) {
   key_record.image[0] = -1;
   key_record.image[1] = -1;
 
-  fp_pb = nullptr;
-  fp_rec = nullptr;
-
-  if (file_pb && file_pb[0]) { /* 再生用ファイルをオープン */
-
-    fp_pb = osd_fopen(FTYPE_KEY_PB, file_pb, "rb");
+  /* 再生は、記録されているステートから始まる。記録は再生の後で開始すると、
+     再生を続きから記録し直せる */
+  if (file_pb && file_pb[0]) { /* 再生用ファイルを読み込む */
 
-    if (fp_pb) {
+    if (replay_playback_start(file_pb)) {
       QLOG_DEBUG("proc", "Key-Input Playback file <{}> ... OK", file_pb);
     } else {
       QLOG_WARN("proc", "Can't open {}: Key-Input PlayBack is invalid", file_pb);
@@ -641,9 +639,7 @@ void key_record_playback_init(void) {
 
   if (file_rec && file_rec[0]) { /* 記録用ファイルをオープン */
 
-    fp_rec = osd_fopen(FTYPE_KEY_REC, file_rec, "wb");
-
-    if (fp_rec) {
+    if (replay_record_start(file_rec)) {
       QLOG_DEBUG("proc", "Key-Input Record file <{}> ... OK", file_rec);
     } else {
       QLOG_WARN("proc", "Can't open <{}>: Key-Input Record is invalid", file_rec);
@@ -652,15 +648,13 @@ void key_record_playback_init(void) {
 }
 
 void key_record_playback_exit(void) {
-  if (fp_pb) {
-    osd_fclose(fp_pb);
-    fp_pb = nullptr;
+  if (replay_playing()) {
+    replay_playback_stop();
     if (file_pb)
       file_pb[0] = '\0';
   }
-  if (fp_rec) {
-    osd_fclose(fp_rec);
-    fp_rec = nullptr;
+  if (replay_recording()) {
+    replay_record_stop();
     if (file_rec)
       file_rec[0] = '\0';
   }
@@ -675,7 +669,7 @@ static void record_playback() {
   if (!quasi88_is_exec())
     return;
 
-  if (fp_rec) {
+  if (replay_recording()) {
     for (i = 0; i < 0x10; i++)
       key_record.key[i] = key_scan[i];
 
@@ -695,18 +689,17 @@ static void record_playback() {
         key_record.image[i] = 0;
     }
 
-    if (osd_fwrite(&key_record, sizeof(char), sizeof(key_record), fp_rec) == sizeof(key_record)) {
+    if (replay_record_input((const uint8_t *)&key_record)) {
       ;
     } else {
       QLOG_WARN("proc", "Can't write Record file <{}>", file_rec);
-      osd_fclose(fp_rec);
-      fp_rec = nullptr;
+      replay_record_stop();
     }
   }
 
-  if (fp_pb) {
+  if (replay_playing()) {
 
-    if (osd_fread(&key_record, sizeof(char), sizeof(key_record), fp_pb) == sizeof(key_record)) {
+    if (replay_playback_input((uint8_t *)&key_record)) {
       for (i = 0; i < 0x10; i++)
         key_scan[i] = key_record.key[i];
 
@@ -727,8 +720,7 @@ static void record_playback() {
     } else {
       QLOG_INFO("proc", "(( {} : Playback file EOF ))", file_pb);
       status_message(1, STATUS_INFO_TIME, "Playback  [EOF]");
-      osd_fclose(fp_pb);
-      fp_pb = nullptr;
+      replay_playback_stop();
     }
   }
 
@@ -1216,6 +1208,16 @@ static int do_func(int func, int on) {
       change_max_boost(fn_max_boost);
     return 0;
 
+  case FN_REWIND: /* 巻き戻し */
+    if (on)
+      rewind_request();
+    return 0;
+
+  case FN_VIDEO: /* 動画記録の開始/停止 */
+    if (on)
+      quasi88_videoout(!videoout_saving());
+    return 0;
+
   case FN_STATUS: /* FDDステータス表示 */
     if (on) {
       if (quasi88_cfg_can_showstatus()) {
@@ -1660,6 +1662,8 @@ static struct { /* ver 0.6.3以降との、機能の対応表 */
     {OLD_FN_FUNC, FN_MAX_SPEED},
     {OLD_FN_FUNC, FN_MAX_CLOCK},
     {OLD_FN_FUNC, FN_MAX_BOOST},
+    {OLD_FN_FUNC, FN_REWIND},
+    {OLD_FN_FUNC, FN_VIDEO},
 
 };
 static int old_func_f[1 + 20];
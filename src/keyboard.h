@@ -52,6 +52,8 @@ enum {          /* ファンクションキーの機能 */
        FN_MAX_SPEED,
        FN_MAX_CLOCK,
        FN_MAX_BOOST,
+       FN_REWIND,
+       FN_VIDEO,
        FN_end
 
        /* この値はステートファイルに記録されてしまう。ということは、この値を
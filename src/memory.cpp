@@ -13,6 +13,7 @@
 #include "Core/Log.h"
 
 #include "file-op.h"
+#include "hash-log.h"
 #include "initval.h"
 #include "memory.h"
 #include "menu.h" /* menu_lang    */
@@ -556,6 +557,7 @@ int memory_allocate_additional() {
 
     memset(&ext_ram[0][0], 0xff, 0x8000 * 4 * use_extram);
     memset(&dummy_rom[0], 0xff, 0x8000);
+    hash_log_ext_ram_changed();
   }
 
   /* 辞書ROM用メモリを確保 */
@@ -4231,6 +4231,8 @@ static Q8tkWidget *tape_rate[2];
 
 static Q8tkWidget *tape_button_eject[2];
 static Q8tkWidget *tape_button_rew;
+static Q8tkWidget *tape_button_skip;
+static Q8tkWidget *tape_button_fast_load;
 
 /*----------------------------------------------------------------------*/
 static void set_tape_name(int c) {
@@ -4274,6 +4276,8 @@ static void cb_tape_eject_do(UNUSED_WIDGET, void *c) {
   q8tk_widget_set_sensitive(tape_button_eject[(intptr_t)c], false);
   if ((intptr_t)c == CLOAD) {
     q8tk_widget_set_sensitive(tape_button_rew, false);
+    q8tk_widget_set_sensitive(tape_button_skip, false);
+    q8tk_widget_set_sensitive(tape_button_fast_load, false);
   }
   q8tk_widget_set_focus(nullptr);
 }
@@ -4293,6 +4297,28 @@ static void cb_tape_rew_do(UNUSED_WIDGET, void *c) {
   }
 }
 
+/*----------------------------------------------------------------------*/
+/* 「頭出し」ボタン押下時の処理                       */
+
+static void cb_tape_skip_do(UNUSED_WIDGET, void *c) {
+  if ((intptr_t)c == CLOAD) {
+    /* 次のデータブロックの先頭まで送る */
+    quasi88_load_tape_skip();
+    set_tape_rate((intptr_t)c);
+  }
+}
+
+/*----------------------------------------------------------------------*/
+/* 「高速ロード」ボタン押下時の処理                     */
+
+static void cb_tape_fast_load_do(UNUSED_WIDGET, void *c) {
+  if ((intptr_t)c == CLOAD) {
+    /* テープの現在位置のプログラムを、直接メモリに読み込む */
+    quasi88_load_tape_fast_load();
+    set_tape_rate((intptr_t)c);
+  }
+}
+
 /*----------------------------------------------------------------------*/
 /* 「OPEN」ボタン押下時の処理                        */
 
@@ -4378,6 +4404,8 @@ static void sub_tape_open_do() {
   q8tk_widget_set_sensitive(tape_button_eject[(int)c], (result ? true : false));
   if ((int)c == CLOAD) {
     q8tk_widget_set_sensitive(tape_button_rew, (result ? true : false));
+    q8tk_widget_set_sensitive(tape_button_skip, (result ? true : false));
+    q8tk_widget_set_sensitive(tape_button_fast_load, (result ? true : false));
   }
 }
 
@@ -4427,6 +4455,10 @@ INLINE Q8tkWidget *menu_tape_image_unit(const t_menulabel *l, int c) {
       if (c == CLOAD) {
         tape_button_rew =
             PACK_BUTTON(hbox, GET_LABEL(l, DATA_TAPE_REWIND), (Q8tkSignalFunc)cb_tape_rew_do, (void *)(intptr_t)c);
+        tape_button_skip =
+            PACK_BUTTON(hbox, GET_LABEL(l, DATA_TAPE_SKIP), (Q8tkSignalFunc)cb_tape_skip_do, (void *)(intptr_t)c);
+        tape_button_fast_load = PACK_BUTTON(hbox, GET_LABEL(l, DATA_TAPE_FAST_LOAD),
+                                            (Q8tkSignalFunc)cb_tape_fast_load_do, (void *)(intptr_t)c);
       }
       if (c == CLOAD) {
         w = PACK_LABEL(hbox, "");
@@ -4439,6 +4471,8 @@ INLINE Q8tkWidget *menu_tape_image_unit(const t_menulabel *l, int c) {
         if (tape_readable() == false) {
           q8tk_widget_set_sensitive(tape_button_eject[c], false);
           q8tk_widget_set_sensitive(tape_button_rew, false);
+          q8tk_widget_set_sensitive(tape_button_skip, false);
+          q8tk_widget_set_sensitive(tape_button_fast_load, false);
         }
       } else {
         if (tape_writable() == false) {
@@ -5000,6 +5034,9 @@ static void sub_misc_waveout_change() {
 
 static void sub_misc_waveout_update() { q8tk_entry_set_text(misc_waveout_entry, filename_get_wav_base()); }
 
+static int get_misc_waveout_format() { return waveout_format; }
+static void cb_misc_waveout_format(UNUSED_WIDGET, void *p) { waveout_format = (intptr_t)p; }
+
 /*----------------------------------------------------------------------*/
 static Q8tkWidget *menu_misc_waveout() {
   Q8tkWidget *hbox, *vbox;
@@ -5035,6 +5072,11 @@ static Q8tkWidget *menu_misc_waveout() {
 
       misc_waveout_stop = PACK_BUTTON(hbox, GET_LABEL(l, DATA_MISC_WAVEOUT_STOP), cb_misc_waveout_stop, nullptr);
 
+      PACK_LABEL(hbox, "  ");
+
+      PACK_RADIO_BUTTONS(PACK_HBOX(hbox), data_misc_waveout_format, COUNTOF(data_misc_waveout_format),
+                         get_misc_waveout_format(), (Q8tkSignalFunc)cb_misc_waveout_format);
+
       PACK_LABEL(hbox, GET_LABEL(l, DATA_MISC_WAVEOUT_PADDING));
 
       misc_waveout_change =
@@ -951,6 +951,11 @@ static const t_menudata data_misc_snapshot_format[] = {
     {{" PNG ", " PNG "}, SNAPSHOT_FMT_PNG},
 };
 
+static const t_menudata data_misc_waveout_format[] = {
+    {{" WAV ", " WAV "}, WAVEOUT_FMT_WAV},
+    {{" FLAC ", " FLAC "}, WAVEOUT_FMT_FLAC},
+};
+
 enum {
   DATA_MISC_WAVEOUT_CHANGE,
   DATA_MISC_WAVEOUT_START,
@@ -962,7 +967,7 @@ static const t_menulabel data_misc_waveout[] = {
     {{" Change ", " ベース名変更 "}},
     {{" START ", " 開始 "}},
     {{" STOP ", " 停止 "}},
-    {{"                                            ", "                                       "}},
+    {{"                    ", "               "}},
     {{" Input (Select) a sound-record base-filename. ", " 出力するファイル (ベース名) を入力して下さい "}},
 };
 
@@ -1020,6 +1025,8 @@ static const t_menudata data_key_fkey_fn[] = {
     {{"MAX-SPEED   : Max Speed", "MAX-SPEED   : 速度最大設定値"}, FN_MAX_SPEED},
     {{"MAX-CLOCK   : Max CPU-Clock", "MAX-CLOCK   : CPUクロック最大設定値"}, FN_MAX_CLOCK},
     {{"MAX-BOOST   : Max Boost", "MAX-BOOST   : ブースト最大設定値"}, FN_MAX_BOOST},
+    {{"REWIND      : Rewind", "REWIND      : 巻き戻し"}, FN_REWIND},
+    {{"VIDEO       : Start/Stop video capture", "VIDEO       : 動画記録の開始／停止"}, FN_VIDEO},
     {{"STATUS      : Display status", "STATUS      : ステータス表示のオン／オフ"}, FN_STATUS},
     {{"MENU        : Go Menu-Mode", "MENU        : メニュー"}, FN_MENU},
 };
@@ -1203,6 +1210,8 @@ enum {
   DATA_TAPE_EJECT,
   DATA_TAPE_FSEL,
   DATA_TAPE_REWIND,
+  DATA_TAPE_SKIP,
+  DATA_TAPE_FAST_LOAD,
   DATA_TAPE_WARN_0,
   DATA_TAPE_WARN_1,
   DATA_TAPE_WARN_APPEND,
@@ -1214,6 +1223,8 @@ static const t_menulabel data_tape_load[] = {
     {{" Eject  ", " 取出し "}},
     {{" Input (Select) a tape-load-image filename. (CMT/T88)", " ロード用テープイメージ(CMT/T88)を入力して下さい"}},
     {{" Rewind ", " 巻戻し "}},
+    {{" Next ", " 頭出し "}},
+    {{" Fast Load ", " 高速ロード "}},
 };
 static const t_menulabel data_tape_save[] = {
     {{" for Save :", " セーブ用："}},
@@ -1221,6 +1232,8 @@ static const t_menulabel data_tape_save[] = {
     {{" Eject  ", " 取出し "}},
     {{" Input (Select) a tape-save-image filename. (CMT)", " セーブ用テープイメージ(CMT)を入力して下さい"}},
     {{NULL, NULL}},
+    {{NULL, NULL}},
+    {{NULL, NULL}},
     {{" This File Already Exist. ", " 指定したファイルはすでに存在します。 "}},
     {{" Append a tape image ? ", " テープイメージを追記していきますか？ "}},
     {{" OK ", " 追記する "}},
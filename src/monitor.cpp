@@ -39,10 +39,14 @@
 #include "memory.h"
 #include "menu.h"
 #include "monitor.h"
+#include "output-sink.h"
 #include "pc88cpu.h"
 #include "pc88main.h"
 #include "pc88sub.h"
 #include "pio.h"
+#include "replay.h"
+#include "rewind.h"
+#include "runahead.h"
 #include "screen.h"
 #include "snapshot.h"
 #include "snddrv.h"
@@ -1234,7 +1238,14 @@ static struct {
     {"disk_exchange", "(-exchange)", MTYPE_INT, &disk_exchange},
     {"fdc_debug_mode", "(-fdcdebug)", MTYPE_INT, &fdc_debug_mode},
     {"fdc_ignore_readonly", "(-ignore_ro)", MTYPE_INT, &fdc_ignore_readonly},
+    {"disk_overlay", "(-diskoverlay)", MTYPE_INT, &disk_overlay},
     {"fdc_wait", "(-fdc_wait)", MTYPE_INT, &fdc_wait},
+    {"fdc_instant", "(-fdc_instant)", MTYPE_INT, &fdc_instant},
+    {"output_sink_drop", "(-outputdrop)", MTYPE_INT, &output_sink_drop},
+    {"rewind_interval", "(-rewind)", MTYPE_INT, &rewind_interval},
+    {"rewind_memory", "(-rewindmem)", MTYPE_INT, &rewind_memory},
+    {"runahead_frames", "(-runahead)", MTYPE_INT, &runahead_frames},
+    {"replay_key_seconds", "(-replaykey)", MTYPE_INT, &replay_key_seconds},
     {"frameskip_rate", "(-frameskip)", MTYPE_FRAMESKIP, &frameskip_rate},
     {"monitor_analog", "(-analog)", MTYPE_INT, &monitor_analog},
     {"use_auto_skip", "(-autoskip)", MTYPE_INT, &use_auto_skip},
@@ -0,0 +1,111 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#include <system_error>
+
+#include "output-sink.h"
+
+#include "Core/Log.h"
+
+int output_sink_drop = false;
+
+void OutputSink::attach(OSD_FILE *file, bool can_drop) {
+  detach();
+
+  fp = file;
+  droppable = can_drop;
+  stop = false;
+  failed = false;
+  dropped_size = 0;
+  queue.reserve(QUEUE_SIZE);
+
+  try {
+    worker = std::thread(&OutputSink::run, this);
+  } catch (const std::system_error &) {
+    QLOG_WARN("proc", "Can't start output thread, writing synchronously");
+  }
+}
+
+void OutputSink::detach() {
+  if (fp == nullptr) {
+    return;
+  }
+  if (worker.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stop = true;
+    }
+    cv_data.notify_one();
+    worker.join();
+  }
+  if (dropped_size) {
+    QLOG_WARN("proc", "Output queue overflow: {} bytes dropped", dropped_size);
+  }
+  fp = nullptr;
+  queue.clear();
+}
+
+bool OutputSink::write(const void *data, size_t size) {
+  if (fp == nullptr) {
+    return false;
+  }
+  const uint8_t *p = static_cast<const uint8_t *>(data);
+
+  if (!worker.joinable()) {
+    if (osd_fwrite(p, 1, size, fp) != size || osd_fflush(fp) != 0) {
+      return false;
+    }
+    return true;
+  }
+
+  std::unique_lock<std::mutex> lock(mutex);
+  if (failed) {
+    return false;
+  }
+  /* A write larger than the queue is accepted once the queue is empty */
+  auto fits = [&] { return queue.empty() || queue.size() + size <= QUEUE_SIZE; };
+  if (!fits()) {
+    if (output_sink_drop && droppable) {
+      dropped_size += size;
+      return true; /* Not an error: the file is still usable */
+    }
+    cv_space.wait(lock, [&] { return fits() || failed; });
+    if (failed) {
+      return false;
+    }
+  }
+  queue.insert(queue.end(), p, p + size);
+  lock.unlock();
+  cv_data.notify_one();
+  return true;
+}
+
+size_t OutputSink::dropped() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return dropped_size;
+}
+
+void OutputSink::run() {
+  std::vector<uint8_t> buf;
+  buf.reserve(QUEUE_SIZE);
+
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    cv_data.wait(lock, [&] { return stop || !queue.empty(); });
+    if (queue.empty()) {
+      break; /* stop, and everything is written */
+    }
+    buf.swap(queue);
+    lock.unlock();
+    cv_space.notify_one();
+
+    bool ok = (osd_fwrite(buf.data(), 1, buf.size(), fp) == buf.size() && osd_fflush(fp) == 0);
+    buf.clear();
+
+    lock.lock();
+    if (!ok) {
+      failed = true;
+      queue.clear();
+      cv_space.notify_one();
+    }
+  }
+}
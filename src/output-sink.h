@@ -0,0 +1,68 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#pragma once
+
+/*
+ * Buffered output to host files (printer, serial and tape output, key
+ * record file).
+ *
+ * Bytes written by the emulation are queued and written to the file by a
+ * background thread, so a slow pipe or network file system does not stall
+ * the emulated machine. The queue is bounded; when it is full, the writer
+ * either waits for space or drops the bytes (output_sink_drop). A write is
+ * queued or dropped as a whole. Files that can't lose bytes are attached as
+ * not droppable and always wait.
+ */
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "file-op.h"
+
+extern int output_sink_drop; /* True: drop output when the queue is full */
+
+class OutputSink {
+public:
+  OutputSink() = default;
+  ~OutputSink() { detach(); }
+
+  OutputSink(const OutputSink &) = delete;
+  OutputSink &operator=(const OutputSink &) = delete;
+
+  /*
+   * Start writing to fp. The file stays owned (and closed) by the caller.
+   * With droppable false, output_sink_drop is ignored for this file.
+   */
+  void attach(OSD_FILE *fp, bool droppable = true);
+  /* Write out everything queued and stop. Call before closing the file */
+  void detach();
+
+  /*
+   * Queue the bytes, all of them or none. False only if the file can't be
+   * written; bytes dropped for a full queue are counted by dropped().
+   */
+  bool write(const void *data, size_t size);
+  bool put(uint8_t c) { return write(&c, 1); }
+
+  /* Bytes dropped so far because the queue was full */
+  size_t dropped();
+
+private:
+  void run();
+
+  static constexpr size_t QUEUE_SIZE = 64 * 1024;
+
+  OSD_FILE *fp = nullptr;
+  std::thread worker;
+  std::mutex mutex;
+  std::condition_variable cv_data;  /* Something queued, or stop */
+  std::condition_variable cv_space; /* The queue was taken by the worker */
+  std::vector<uint8_t> queue;
+  bool droppable = true;
+  bool stop = false;
+  bool failed = false;
+  size_t dropped_size = 0;
+};
@@ -4,30 +4,37 @@
 /*                                  */
 /************************************************************************/
 
+#include <algorithm>
 #include <cstring>
 #include <ctime>
+#include <vector>
 
 #include "quasi88.h"
 
 #include "Core/Log.h"
 
+#include "basic.h"
 #include "crtcdmac.h"
 #include "debug.h"
 #include "drive.h"
 #include "emu.h"
 #include "fdc.h" /* disk_ex_drv */
 #include "getconf.h"
+#include "hash-log.h"
 #include "initval.h"
 #include "intr.h"
 #include "keyboard.h"
 #include "memory.h"
+#include "output-sink.h"
 #include "pc88main.h"
 #include "pio.h"
+#include "runahead.h"
 #include "screen.h"
 #include "snddrv.h"
 #include "soundbd.h"
 #include "status.h"
 #include "suspend.h"
+#include "tape-image.h"
 #include "z80.h"
 
 static OSD_FILE *fp_so = nullptr;  /* シリアル出力用fp      */
@@ -36,6 +43,11 @@ static OSD_FILE *fp_to = nullptr;  /* テープ出力用  fp       */
 static OSD_FILE *fp_ti = nullptr;  /*       入力用  fp      */
 static OSD_FILE *fp_prn = nullptr; /* プリンタ出力用fp      */
 
+/* 出力用のファイルには、別スレッドでまとめて書き込む */
+static OutputSink sink_so;  /* シリアル出力 */
+static OutputSink sink_to;  /* テープ出力   */
+static OutputSink sink_prn; /* プリンタ出力 */
+
 int boot_basic = DEFAULT_BASIC;      /* 起動時の BASICモード      */
 int boot_dipsw = DEFAULT_DIPSW;      /* 起動時のディップ設定       */
 int boot_from_rom = DEFAULT_BOOT;    /* 起動デバイスの設定      */
@@ -87,9 +99,7 @@ int use_siomouse = false; /* 真で、シリアルマウスあり */
 
 /* 以下はテープイメージのファイル依存情報なので、ステートセーブしない */
 
-static int cmt_is_t88;      /* 真…T88、偽…CMT        */
-static int cmt_block_size;  /* データタグ内のサイズ(T88)  */
-static long cmt_size;       /* イメージのサイズ     */
+static TapeImage cmt_image; /* テープイメージ (ブロック単位に解析済み) */
 static int cmt_EOF = false; /* 真で、テープ入力 EOF     */
 static int com_EOF = false; /* 真で、シリアル入力 EOF  */
 static long com_size;       /* イメージのサイズ     */
@@ -105,6 +115,7 @@ static void out_ctrl_signal(uint8_t); /* OUT[40] コントロール信号出力
 static void sio_tape_highspeed_load();
 static void sio_set_intr_base();
 static void sio_check_cmt_error();
+static int sio_tape_read_image();
 
 #define sio_tape_readable() (fp_ti && !cmt_EOF)   /* テープ読込可？   */
 #define sio_tape_writable() (fp_to)               /* テープ書込可？   */
@@ -326,6 +337,13 @@ INLINE void main_memory_mapping_0000_7fff() {
     }
     break;
   }
+
+  /* 書き込める拡張RAMのバンクを、ハッシュ記録に知らせる */
+  if ((ext_ram_ctrl & 0x10) && ext_ram_bank < use_extram * 4) {
+    hash_log_ext_ram_writable(ext_ram_bank);
+  } else {
+    hash_log_ext_ram_writable(-1);
+  }
 }
 
 #else /* こう、すっきりさせるほうがいい？ */
@@ -1651,7 +1669,11 @@ int sio_open_tapeload(const char *filename) {
   if ((fp_ti = osd_fopen(FTYPE_TAPE_LOAD, filename, "rb"))) {
 
     sio_set_intr_base();
-    return sio_tape_rewind();
+    if (sio_tape_read_image()) {
+      return sio_tape_rewind();
+    }
+    printf("\n[[[ Tape image access error ]]]\n\n");
+    sio_close_tapeload();
 
   } else {
     if (!quasi88_is_menu())
@@ -1667,6 +1689,7 @@ void sio_close_tapeload(void) {
   }
   sio_set_intr_base();
 
+  cmt_image.clear();
   cmt_read_chars = 0;
 }
 
@@ -1677,6 +1700,7 @@ int sio_open_tapesave(const char *filename) {
 
   if ((fp_to = osd_fopen(FTYPE_TAPE_SAVE, filename, "ab"))) {
 
+    sink_to.attach(fp_to);
     return true;
 
   } else {
@@ -1687,6 +1711,7 @@ int sio_open_tapesave(const char *filename) {
 }
 void sio_close_tapesave(void) {
   if (fp_to) {
+    sink_to.detach();
     osd_fclose(fp_to);
     fp_to = nullptr;
   }
@@ -1738,6 +1763,7 @@ int sio_open_serialout(const char *filename) {
 
   if ((fp_so = osd_fopen(FTYPE_COM_SAVE, filename, "ab"))) {
 
+    sink_so.attach(fp_so);
     return true;
 
   } else {
@@ -1748,6 +1774,7 @@ int sio_open_serialout(const char *filename) {
 }
 void sio_close_serialout(void) {
   if (fp_so) {
+    sink_so.detach();
     osd_fclose(fp_so);
     fp_so = nullptr;
   }
@@ -1762,77 +1789,84 @@ void sio_mouse_init(int initial) {
   sio_set_intr_base();
 }
 
-/*-------- 開いているテープイメージを巻き戻す --------*/
+/*-------- テープイメージを読み込み、ブロック単位に解析する --------*/
 
-#define T88_HEADER_STR "PC-8801 Tape Image(T88)"
-int sio_tape_rewind(void) {
-  int size;
-  char buf[sizeof(T88_HEADER_STR)];
+/*
+ * テープイメージはオープン時に全体を読み込んで、データ・ブランク・スペース・
+ * マークのブロックに分けておく。以降の読み込みはメモリから行い、巻き戻しや
+ * ステートロード時の早送り、頭出しはブロック表から直接位置を求める。
+ */
+static int sio_tape_read_image() {
+  long size;
+  std::vector<uint8_t> buf;
 
-  cmt_read_chars = 0;
+  if (osd_fseek(fp_ti, 0, SEEK_END))
+    return false;
+  if ((size = osd_ftell(fp_ti)) < 0)
+    return false;
+  if (osd_fseek(fp_ti, 0, SEEK_SET))
+    return false;
 
-  if (fp_ti) {
-    if (osd_fseek(fp_ti, 0, SEEK_END))
-      goto ERR;
-    if ((cmt_size = osd_ftell(fp_ti)) < 0)
-      goto ERR;
+  buf.resize(size);
+  if (osd_fread(buf.data(), sizeof(uint8_t), size, fp_ti) != (size_t)size)
+    return false;
 
-    if (osd_fseek(fp_ti, 0, SEEK_SET))
-      goto ERR;
+  cmt_image.load(std::move(buf));
+  return true;
+}
 
-    size = osd_fread(buf, sizeof(char), sizeof(buf), fp_ti);
-    if (size == sizeof(buf) && memcmp(buf, T88_HEADER_STR, sizeof(buf)) == 0) { /* T88 */
-      cmt_is_t88 = true;
-      cmt_block_size = 0;
-      cmt_EOF = false;
-      cmt_skip = 0;
-    } else { /* CMT */
-      cmt_is_t88 = false;
-      cmt_EOF = false;
-      cmt_skip = 0;
-      if (osd_fseek(fp_ti, 0, SEEK_SET))
-        goto ERR;
-    }
-
-    while (cmt_stateload_chars--) { /* ステートロード時は、テープ早送り */
-      if (sio_getc(true, nullptr) == EOF) {
-        break;
+/*-------- 開いているテープイメージを巻き戻す --------*/
+
+int sio_tape_rewind(void) {
+  if (fp_ti) {
+    cmt_EOF = false;
+    cmt_skip = 0;
+
+    if (cmt_stateload_chars) { /* ステートロード時は、テープ早送り */
+      if (cmt_image.seek_chars(cmt_stateload_chars) == false) {
+        cmt_EOF = true;
+        status_message(1, STATUS_WARN_TIME, "Tape Read  [EOF]");
       }
+      cmt_skip = cmt_stateload_skip;
+    } else {
+      cmt_image.seek_block(0);
     }
-    cmt_skip = cmt_stateload_skip;
+    cmt_read_chars = cmt_image.chars();
     cmt_stateload_chars = 0;
 
-    /*printf("%d\n",osd_ftell(fp_ti));*/
     return true;
   }
 
-ERR:
+  cmt_stateload_chars = 0;
+  return false;
+}
+
+/*-------- 開いているテープを、次のデータブロックの先頭まで送る --------*/
+
+int sio_tape_skip(void) {
   if (fp_ti) {
-    printf("\n[[[ Tape image access error ]]]\n\n");
-  }
-  sio_close_tapeload();
+    cmt_image.seek_next_data();
+    cmt_EOF = false;
+    cmt_skip = 0;
+    cmt_read_chars = cmt_image.chars();
 
-  cmt_stateload_chars = 0;
+    return (cmt_image.current_block() < cmt_image.blocks().size());
+  }
   return false;
 }
 
 /*-------- 開いているテープの現在位置を返す (何%読んだかの確認用) --------*/
 
 int sio_tape_pos(long *cur, long *end) {
-  long v;
-
   if (fp_ti) {
     if (cmt_EOF) { /* 終端なら、位置=0/終端=0 にし、真を返す */
       *cur = 0;
       *end = 0;
       return true;
     } else { /* 途中なら、位置と終端をセットし真を返す */
-      v = osd_ftell(fp_ti);
-      if (v >= 0) {
-        *cur = v;
-        *end = cmt_size;
-        return true;
-      }
+      *cur = cmt_image.file_pos();
+      *end = cmt_image.file_size();
+      return true;
     }
   }
   *cur = 0; /* 不明時は、位置=0/終端=0 にし、偽を返す */
@@ -1866,7 +1900,7 @@ int sio_com_pos(long *cur, long *end) {
  * 開いているsioイメージから1文字読み込む
  */
 static int sio_getc(int is_cmt, int *tick) {
-  int i, c, id, size, time;
+  int c;
 
   if (tick)
     *tick = 0;
@@ -1898,108 +1932,7 @@ static int sio_getc(int is_cmt, int *tick) {
     if (cmt_EOF)
       return EOF;
 
-    if (!cmt_is_t88) { /* CMT形式の場合 */
-
-      c = osd_fgetc(fp_ti);
-
-    } else { /* T88形式の場合 */
-
-      while (cmt_block_size == 0) {
-
-        if ((c = osd_fgetc(fp_ti)) == EOF) {
-          break;
-        }
-        id = c;
-        if ((c = osd_fgetc(fp_ti)) == EOF) {
-          break;
-        }
-        id += c << 8;
-
-        if (id == 0x0000) { /* 終了タグ */
-          c = EOF;
-          break;
-        } else {
-          if ((c = osd_fgetc(fp_ti)) == EOF) {
-            break;
-          }
-          size = c;
-          if ((c = osd_fgetc(fp_ti)) == EOF) {
-            break;
-          }
-          size += c << 8;
-
-          if (id == 0x0101) { /* データタグ */
-
-            if (size < 12) {
-              c = EOF;
-              break;
-            }
-
-            for (i = 0; i < 12; i++) { /* 情報は全て無視 */
-              if ((c = osd_fgetc(fp_ti)) == EOF) {
-                break;
-              }
-            }
-            if (c == EOF)
-              break;
-            cmt_block_size = size - 12;
-
-          } else {
-
-            if (id == 0x0100 || /* ブランクタグ */
-                id == 0x0102 || /* スペースタグ */
-                id == 0x0103) { /* マークタグ   */
-
-              if (size != 8) {
-                c = EOF;
-                break;
-              }
-
-              for (i = 0; i < 4; i++) { /* 開始時間は無視 */
-                if ((c = osd_fgetc(fp_ti)) == EOF) {
-                  break;
-                }
-              }
-              if (c == EOF)
-                break;
-              /* 長さ時間は取得 */
-              if ((c = osd_fgetc(fp_ti)) == EOF) {
-                break;
-              }
-              time = c;
-              if ((c = osd_fgetc(fp_ti)) == EOF) {
-                break;
-              }
-              time += c << 8;
-              if ((c = osd_fgetc(fp_ti)) == EOF) {
-                break;
-              }
-              time += c << 16;
-              if ((c = osd_fgetc(fp_ti)) == EOF) {
-                break;
-              }
-              time += c << 24;
-
-              if (tick)
-                *tick += time;
-
-            } else { /* 他のタグ(無視) */
-
-              for (i = 0; i < size; i++) {
-                if ((c = osd_fgetc(fp_ti)) == EOF) {
-                  break;
-                }
-              }
-              if (c == EOF)
-                break;
-            }
-          }
-        }
-      }
-
-      cmt_block_size--;
-      c = osd_fgetc(fp_ti);
-    }
+    c = cmt_image.get(tick); /* T88 のブランク等の時間は tick に加算 */
 
     if (c == EOF) {
       cmt_EOF = true;
@@ -2018,21 +1951,14 @@ static int sio_getc(int is_cmt, int *tick) {
  * こんなチェック、必要なのか？？
  */
 static void sio_check_cmt_error() {
-  int c;
   if (sio_tape_readable()) {
-    if (cmt_is_t88 && /* T88 かつ、データタグの途中の時のみ */
-        cmt_skip == 0 && cmt_block_size) {
-      cmt_block_size--;
-      c = osd_fgetc(fp_ti);
+    if (cmt_image.is_t88() && /* T88 かつ、データタグの途中の時のみ */
+        cmt_skip == 0 && cmt_image.in_data()) {
+      cmt_image.skip(1);
 
       QLOG_DEBUG("proc", "Tape read: lost 1 byte");
 
-      if (c == EOF) {
-        cmt_EOF = true;
-        status_message(1, STATUS_WARN_TIME, "Tape Read  [EOF]");
-      } else {
-        cmt_read_chars++;
-      }
+      cmt_read_chars++;
     }
   }
 }
@@ -2041,58 +1967,96 @@ static void sio_check_cmt_error() {
  * 開いているsioイメージに1文字書き込む
  */
 static int sio_putc(int is_cmt, int c) {
-  OSD_FILE *fp;
-
+  if (runahead_hidden) { /* 先行実行の隠しフレームの出力は捨てる */
+    return c;            /* (戻した後、同じ出力をもう一度行うので) */
+  }
   if (is_cmt == false) {
-    fp = fp_so;
-  } /* シリアル出力 */
-  else {
-    fp = fp_to;
-  } /* テープ出力 */
-
-  if (fp) {
-    osd_fputc(c, fp);
-    osd_fflush(fp);
+    sink_so.put(c); /* シリアル出力 */
+  } else {
+    sink_to.put(c); /* テープ出力 */
   }
   return c;
 }
 
 /*
- * 高速テープロード …… 詳細不明。こんな機能あったのか…
+ * 高速テープロード
+ *
+ * テープの現在位置のデータを形式ごとに解釈し、ブロック表から直接メモリに
+ * 転送する。形式が合わない時は、テープ位置を元に戻して偽を返す。
+ *   ・マシン語形式 (0x3a ヘッダ)
+ *       I/O 00h への出力 (詳細不明。こんな機能あったのか…) で読み込む。
+ *       メニューの「高速ロード」でも読み込める。
+ *   ・BASIC 中間コード (CSAVE 形式。0xd3 x 10 + ファイル名 6文字)
+ *       メニューの「高速ロード」で読み込み、テキストポインタを設定する。
+ *       CLOAD の代わりで、あとは RUN するだけ。
  */
-static void sio_tape_highspeed_load() {
-  int c, sum, addr, size;
 
-  if (sio_tape_readable() == false)
-    return;
+#define TAPE_BASIC_MAX 0x10000 /* BASIC 形式の先読みバイト数 */
+
+/* テープの現在位置から size バイト先読みする (位置は変えない) */
+static size_t tape_lookahead(uint8_t *buf, size_t size) {
+  size_t start = cmt_image.chars();
+
+  size = cmt_image.read(buf, size);
+  cmt_image.seek_chars(start);
+  return size;
+}
+
+/* メモリにまとめて転送する。ROM/VRAM 等の領域は1バイトずつ */
+static void tape_mem_copy(uint16_t addr, const uint8_t *p, size_t size) {
+  size_t len;
+
+  while (size) {
+    if (addr < 0x8000) {
+      len = std::min(size, (size_t)(0x8000 - addr));
+      memcpy(&write_mem_0000_7fff[addr], p, len);
+    } else if (addr >= 0x8400 && addr < 0xc000) {
+      len = std::min(size, (size_t)(0xc000 - addr));
+      memcpy(&main_ram[addr], p, len);
+    } else {
+      main_mem_write(addr, *p);
+      len = 1;
+    }
+    addr += len;
+    p += len;
+    size -= len;
+  }
+}
+
+/* マシン語形式を読む。転送先アドレスと、データ部をつなげたものを返す */
+static int tape_read_machine(uint16_t *start, std::vector<uint8_t> &data) {
+  int c, sum, addr, size;
+  size_t len;
+  const uint8_t *p;
 
   /* マシン語ヘッダを探す */
 
   do { /* 0x3a が出てくるまでリード */
     if ((c = sio_getc(true, nullptr)) == EOF) {
-      return;
+      return false;
     }
   } while (c != 0x3a);
   /* 転送先アドレス H */
   if ((c = sio_getc(true, nullptr)) == EOF) {
-    return;
+    return false;
   }
   sum = c;
   addr = c * 256;
   /* 転送先アドレス L */
   if ((c = sio_getc(true, nullptr)) == EOF) {
-    return;
+    return false;
   }
   sum += c;
   addr += c;
   /* ヘッダ部サム */
   if ((c = sio_getc(true, nullptr)) == EOF) {
-    return;
+    return false;
   }
   sum += c;
   if ((sum & 0xff) != 0) {
-    return;
+    return false;
   }
+  *start = addr;
 
   /* あとはデータ部の繰り返し */
 
@@ -2100,38 +2064,154 @@ static void sio_tape_highspeed_load() {
 
     do { /* 0x3a が出てくるまでリード */
       if ((c = sio_getc(true, nullptr)) == EOF) {
-        return;
+        return false;
       }
     } while (c != 0x3a);
 
     /* データ数 */
     if ((c = sio_getc(true, nullptr)) == EOF) {
-      return;
+      return false;
     }
     sum = c;
     size = c;
     if (c == 0) { /* データ数==0で終端 */
-      return;
+      return true;
     }
 
-    for (; size; size--) { /* データ数分、転送 */
+    p = cmt_image.peek(&len);
+    if (p && len >= (size_t)size) { /* ブロック内にあれば、まとめて読む */
+      for (int i = 0; i < size; i++) {
+        sum += p[i];
+      }
+      data.insert(data.end(), p, p + size);
+      cmt_image.skip(size);
+      cmt_read_chars += size;
 
-      if ((c = sio_getc(true, nullptr)) == EOF) {
-        return;
+    } else {
+      for (; size; size--) { /* データ数分、読む */
+
+        if ((c = sio_getc(true, nullptr)) == EOF) {
+          return false;
+        }
+        sum += c;
+        data.push_back(c);
       }
-      sum += c;
-      main_mem_write(addr, c);
-      addr++;
     }
     /* データ部サム */
     if ((c = sio_getc(true, nullptr)) == EOF) {
-      return;
+      return false;
     }
     sum += c;
     if ((sum & 0xff) != 0) {
-      return;
+      return false;
+    }
+  }
+}
+
+/*
+ * マシン語形式。strict なら、先頭 (0x00 は除く) がヘッダの時のみ読む。
+ * 最後まで読めてサムも合った時だけメモリに転送する。読めなければ、
+ * テープの位置は元のまま。
+ */
+static int tape_load_machine(int strict) {
+  if (strict) {
+    uint8_t buf[256];
+    size_t n = tape_lookahead(buf, sizeof(buf)), i = 0;
+    while (i < n && buf[i] == 0x00) {
+      i++;
+    }
+    if (i == n || buf[i] != 0x3a) {
+      return false;
+    }
+  }
+
+  size_t chars = cmt_image.chars();
+  long read_chars = cmt_read_chars;
+  int eof = cmt_EOF;
+  uint16_t addr = 0;
+  std::vector<uint8_t> data;
+
+  if (tape_read_machine(&addr, data) == false) {
+    cmt_image.seek_chars(chars);
+    cmt_read_chars = read_chars;
+    cmt_EOF = eof;
+    return false;
+  }
+  tape_mem_copy(addr, data.data(), data.size());
+  return true;
+}
+
+static int tape_load_machine_strict() { return tape_load_machine(true); }
+
+/* BASIC 中間コード (CSAVE 形式) */
+static int tape_load_basic() {
+  std::vector<uint8_t> buf(TAPE_BASIC_MAX);
+  size_t size, pos = 0, n = 0, body, end;
+  int len;
+
+  size = tape_lookahead(buf.data(), buf.size());
+
+  /* ヘッダ: 0xd3 が 10個以上と、ファイル名 6文字 */
+  while (pos < size && buf[pos] == 0x00) {
+    pos++;
+  }
+  while (pos + n < size && buf[pos + n] == 0xd3) {
+    n++;
+  }
+  if (n < 10 || pos + n + 6 > size) {
+    return false;
+  }
+  body = pos + n + 6;
+
+  /* 中間コード。前に 0x00 が 1つ付いていることもある */
+  len = basic_load_intermediate_code_mem(&buf[body], size - body);
+  if (len == 0 && body < size && buf[body] == 0x00) {
+    body++;
+    len = basic_load_intermediate_code_mem(&buf[body], size - body);
+  }
+  if (len == 0) {
+    return false;
+  }
+
+  /* 後ろに続く 0x00 も読み飛ばす */
+  end = body + len;
+  while (end < size && buf[end] == 0x00) {
+    end++;
+  }
+  cmt_image.seek_chars(cmt_image.chars() + end);
+  cmt_read_chars = cmt_image.chars();
+
+  return true;
+}
+
+static const struct {
+  const char *name;
+  int (*load)();
+} tape_loader[] = {
+    {"BASIC", tape_load_basic},
+    {"Machine", tape_load_machine_strict},
+};
+
+static void sio_tape_highspeed_load() {
+  if (sio_tape_readable()) {
+    tape_load_machine(false);
+  }
+}
+
+int sio_tape_fast_load(void) {
+  char buf[64];
+
+  if (sio_tape_readable()) {
+    for (const auto &loader : tape_loader) {
+      if (loader.load()) {
+        QLOG_INFO("proc", "Tape fast load: {} ({} bytes read)", loader.name, cmt_read_chars);
+        snprintf(buf, sizeof(buf), "Tape Fast Load  [%s]", loader.name);
+        status_message(1, STATUS_INFO_TIME, buf);
+        return true;
+      }
     }
   }
+  return false;
 }
 
 /*
@@ -2375,6 +2455,8 @@ int tape_reading(void) { return (fp_ti && (sio_command & 4) && ((sys_ctrl & 0x28
 
 int tape_writing(void) { return (fp_to && (sio_command & 1) && ((sys_ctrl & 0x28) == 0x08)); }
 
+int serial_in_connected(void) { return (fp_si || use_siomouse); }
+
 /*===========================================================================*/
 /* パラレルポート                                 */
 /*===========================================================================*/
@@ -2384,6 +2466,7 @@ int printer_open(const char *filename) {
 
   if ((fp_prn = osd_fopen(FTYPE_PRN, filename, "ab"))) {
 
+    sink_prn.attach(fp_prn);
     return true;
 
   } else {
@@ -2394,6 +2477,7 @@ int printer_open(const char *filename) {
 }
 void printer_close(void) {
   if (fp_prn) {
+    sink_prn.detach();
     osd_fclose(fp_prn);
     fp_prn = nullptr;
   }
@@ -2401,10 +2485,10 @@ void printer_close(void) {
 
 void printer_init() {}
 void printer_stlobe() {
-  if (fp_prn) {
-    osd_fputc(common_out_data, fp_prn);
-    osd_fflush(fp_prn);
+  if (runahead_hidden) { /* 先行実行の隠しフレームの出力は捨てる */
+    return;
   }
+  sink_prn.put(common_out_data);
 }
 void printer_term() {}
 
@@ -2938,6 +3022,25 @@ void pc88main_term(void) {
   sio_term();
 }
 
+/************************************************************************/
+/* 先行実行の後、メモリ上のステートに戻した時の再設定            */
+/*  pc88main_init(INIT_STATELOAD) のうち、ステートに含まれないワークを   */
+/*  作り直す。キー入力とサウンドはそのまま、イメージファイルも開いたまま。*/
+/************************************************************************/
+void pc88main_runahead_restore(void) {
+  main_memory_mapping_0000_7fff();
+  main_memory_mapping_8000_83ff();
+  main_memory_mapping_c000_ffff();
+  main_memory_vram_mapping();
+
+  memory_set_font(); /* 使用するフォントを、ステートの PCG 設定に合わせる */
+
+  set_text_display();
+
+  sio_tape_rewind(); /* テープは、ステートの読込位置まで早送り */
+  sio_set_intr_base();
+}
+
 /************************************************************************/
 /* ブレークポイント関連                           */
 /************************************************************************/
@@ -3212,3 +3315,7 @@ int stateload_pc88main() {
 
   return true;
 }
+
+uint64_t statehash_pc88main() {
+  return statehash_table(suspend_pc88main_work2, statehash_table(suspend_pc88main_work, 0));
+}
@@ -110,6 +110,7 @@ extern int use_siomouse; /* 真で、シリアルマウスあり */
 
 void pc88main_init(int init);
 void pc88main_term(void);
+void pc88main_runahead_restore(void);
 void pc88main_bus_setup(void);
 void power_on_ram_init(void);
 
@@ -130,6 +131,8 @@ int printer_open(const char *filename);
 void printer_close(void);
 void sio_mouse_init(int initial);
 int sio_tape_rewind(void);
+int sio_tape_skip(void);
+int sio_tape_fast_load(void);
 
 int sio_tape_pos(long *cur, long *end);
 int sio_com_pos(long *cur, long *end);
@@ -141,5 +144,6 @@ int tape_readable(void);
 int tape_writable(void);
 int tape_reading(void);
 int tape_writing(void);
+int serial_in_connected(void);
 
 #endif /* PC88MAIN_H_INCLUDED */
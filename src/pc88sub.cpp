@@ -446,3 +446,5 @@ int stateload_pc88sub() {
   else
     return false;
 }
+
+uint64_t statehash_pc88sub() { return statehash_table(suspend_pc88sub_work, 0); }
@@ -3610,6 +3610,11 @@ static void fsel_selected_callback(Q8tkWidget *item, void *fselect) {
 
     q8tk_entry_set_text(Q8TK_FILE_SELECTION((Q8tkWidget *)fselect)->selection_entry, name);
 
+    /* 圧縮イメージなら、OK を押す前に展開を始めておく */
+    if (item->stat.any.data[0] != FILE_STAT_DIR) {
+      osd_fprefetch(q8tk_file_selection_get_filename((Q8tkWidget *)fselect));
+    }
+
   } else {
 
     /* 今回 fsel_selected_callback() だけが呼び出された場合、
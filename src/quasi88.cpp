@@ -29,8 +29,10 @@
 #include "debug.h"
 #include "drive.h"
 #include "emu.h"
+#include "fdc.h"
 #include "event.h"
 #include "fname.h"
+#include "hash-log.h"
 #include "initval.h"
 #include "intr.h"
 #include "keyboard.h"
@@ -46,6 +48,9 @@
 #include "pause.h"
 #include "pc88main.h"
 #include "pc88sub.h"
+#include "replay.h"
+#include "rewind.h"
+#include "runahead.h"
 #include "wait.h"
 #include "z80.h"
 
@@ -142,6 +147,7 @@ void quasi88_start(void) {
   pc88sub_init((resume_flag) ? INIT_STATELOAD : INIT_POWERON);
 
   key_record_playback_init(); /* キー入力記録/再生 初期化  */
+  hash_log_init();            /* フレームごとのハッシュ記録 */
 
   screen_snapshot_init(); /* スナップショット関連初期化   */
 
@@ -194,9 +200,11 @@ void quasi88_stop(int normal_exit) {
 
   switch (proc) {
   case 6: /* 初期化 正常に終わっている */
+    statesave_wait(); /* ステートファイルの書き込み完了を待つ */
     profiler_exit();
     debuglog_exit();
     screen_snapshot_exit();
+    hash_log_exit();
     key_record_playback_exit();
     pc88main_term();
     pc88sub_term();
@@ -315,6 +323,7 @@ int quasi88_loop(void) {
       xmame_sound_resume();
     } else {
       xmame_sound_suspend();
+      disk_write_back(true); /* 停止中はイメージファイルを最新にしておく */
     }
 
     screen_switch();
@@ -356,6 +365,20 @@ int quasi88_loop(void) {
     case EXEC:
       profiler_lapse(PROF_LAPSE_RESET);
       emu_main();
+      if (quasi88_event_flags & EVENT_FRAME_UPDATE) {
+        rewind_frame(); /* 巻き戻し用のステート保存 */
+        replay_frame(); /* リプレイのキーフレームと同期確認 */
+        hash_log_frame();
+        if (!videoout_save_frame()) { /* 書き込みエラーかサイズの上限 */
+          status_message(1, STATUS_INFO_TIME, "Video Record Stopped");
+        }
+      }
+      if (statesave_write_failed()) { /* 別スレッドでの書き込みに失敗 */
+        status_message(1, STATUS_INFO_TIME, "State-Save Failed !");
+      }
+      if (screen_snapshot_write_failed()) {
+        status_message(1, STATUS_INFO_TIME, "Screen Capture Failed !");
+      }
       break;
 #ifdef USE_MONITOR
     case MONITOR:
@@ -383,7 +406,11 @@ int quasi88_loop(void) {
     /* そうでなければ、                WAIT せずに遷移 */
     if (quasi88_event_flags & EVENT_FRAME_UPDATE) {
       quasi88_event_flags &= ~EVENT_FRAME_UPDATE;
-      screen_update();
+      if (mode == EXEC) {
+        runahead_screen_update(); /* 先行実行するなら、先の画面を描画 */
+      } else {
+        screen_update();
+      }
       step = WAIT;
     } else {
       step = step_after_wait;
@@ -404,7 +431,7 @@ int quasi88_loop(void) {
     switch (mode) {
     case EXEC:
       profiler_lapse(PROF_LAPSE_IDLE);
-      if (!no_wait) {
+      if (!no_wait && !fdc_instant_busy()) {
         stat = wait_vsync_update();
       }
       break;
@@ -0,0 +1,559 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#include <algorithm>
+#include <cstring>
+
+#include "quasi88.h"
+
+#include "replay.h"
+
+#include "Core/Log.h"
+
+#include "archive.h"
+#include "emu.h"
+#include "event.h"
+#include "fdc.h"
+#include "intr.h"
+#include "memory.h"
+#include "pc88main.h"
+#include "runahead.h"
+#include "state-file.h"
+#include "status.h"
+#include "suspend.h"
+
+namespace {
+
+/*
+ * File format:
+ *
+ *   Header   "Q88RPLAY"     8 bytes
+ *            Version        4 bytes
+ *            Config CRC     4 bytes, see config_crc()
+ *            Rate           4 bytes, inputs per 1000 seconds
+ *            Key interval   4 bytes, inputs between keyframes (0: none)
+ *            Reserved       8 bytes
+ *   Chunk    Tag            4 bytes
+ *            Length         4 bytes, of the payload
+ *            Payload
+ *     :
+ *
+ *   "STAT"   Frame (4 bytes) and the state at that frame, packed as a state file
+ *   "KEYS"   Frame of the first input (4 bytes), number of inputs (4 bytes) and
+ *            entries of
+ *              Run    varint, frames the record is used
+ *              Mask   4 bytes, bit n set if byte n of the record changed
+ *              Bytes  the changed bytes
+ *            Each chunk starts from a record of all zero.
+ *   "HASH"   Frame (4 bytes) and statesave_hash() at the end of it (4 bytes)
+ *
+ * "Frame" counts input records. All integers are little endian. The first
+ * chunk is the STAT of frame 0.
+ */
+constexpr char MAGIC[8] = {'Q', '8', '8', 'R', 'P', 'L', 'A', 'Y'};
+constexpr uint32_t VERSION = 1;
+constexpr size_t HEADER_SIZE = 32;
+constexpr size_t CHUNK_HEADER_SIZE = 8;
+constexpr size_t KEYS_CHUNK_MAX = 64 * 1024; /* Written out when this large */
+
+static_assert(REPLAY_INPUT_SIZE <= 32, "the change mask is 32 bits");
+
+void put32(uint8_t *p, uint32_t v) {
+  p[0] = v & 0xff;
+  p[1] = (v >> 8) & 0xff;
+  p[2] = (v >> 16) & 0xff;
+  p[3] = (v >> 24) & 0xff;
+}
+
+uint32_t get32(const uint8_t *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+
+void append32(std::vector<uint8_t> &out, uint32_t v) {
+  uint8_t b[4];
+  put32(b, v);
+  out.insert(out.end(), b, b + 4);
+}
+
+void put_varint(std::vector<uint8_t> &out, uint32_t v) {
+  while (v >= 0x80) {
+    out.push_back((v & 0x7f) | 0x80);
+    v >>= 7;
+  }
+  out.push_back(v);
+}
+
+bool get_varint(const uint8_t *p, size_t end, size_t &pos, uint32_t &v) {
+  v = 0;
+  for (int shift = 0; shift < 32; shift += 7) {
+    if (pos >= end) {
+      return false;
+    }
+    uint8_t c = p[pos++];
+    v |= (uint32_t)(c & 0x7f) << shift;
+    if (!(c & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace
+
+/****************************************************************************
+ * ReplayWriter
+ *****************************************************************************/
+void ReplayWriter::start(OSD_FILE *fp, uint32_t config_crc, uint32_t key_interval, uint32_t rate,
+                         const std::vector<uint8_t> &state) {
+  sink.attach(fp, false); /* Chunks can't lose bytes */
+  count = 0;
+  keys_count = 0;
+  run = 0;
+  keys.clear();
+  memset(base, 0, sizeof(base));
+
+  uint8_t header[HEADER_SIZE] = {};
+  memcpy(header, MAGIC, sizeof(MAGIC));
+  put32(&header[8], VERSION);
+  put32(&header[12], config_crc);
+  put32(&header[16], rate);
+  put32(&header[20], key_interval);
+  ok = sink.write(header, sizeof(header));
+
+  keyframe(0, state);
+}
+
+bool ReplayWriter::input(const uint8_t *record) {
+  if (run > 0 && memcmp(record, last, REPLAY_INPUT_SIZE) == 0) {
+    run++;
+  } else {
+    if (run > 0) {
+      emit();
+    }
+    memcpy(last, record, REPLAY_INPUT_SIZE);
+    run = 1;
+  }
+  if (keys_count == 0) {
+    keys_first = count;
+  }
+  keys_count++;
+  count++;
+
+  if (keys.size() >= KEYS_CHUNK_MAX) {
+    flush_inputs();
+  }
+  return ok;
+}
+
+/* Encode the pending record and its run */
+void ReplayWriter::emit() {
+  uint32_t mask = 0;
+  for (size_t i = 0; i < REPLAY_INPUT_SIZE; i++) {
+    if (last[i] != base[i]) {
+      mask |= 1u << i;
+    }
+  }
+  put_varint(keys, run);
+  append32(keys, mask);
+  for (size_t i = 0; i < REPLAY_INPUT_SIZE; i++) {
+    if (mask & (1u << i)) {
+      keys.push_back(last[i]);
+    }
+  }
+  memcpy(base, last, REPLAY_INPUT_SIZE);
+  run = 0;
+}
+
+void ReplayWriter::flush_inputs() {
+  if (run > 0) {
+    emit();
+  }
+  if (keys_count == 0) {
+    return;
+  }
+  work.clear();
+  append32(work, keys_first);
+  append32(work, keys_count);
+  work.insert(work.end(), keys.begin(), keys.end());
+  chunk("KEYS", work);
+
+  keys.clear();
+  keys_count = 0;
+  memset(base, 0, sizeof(base));
+}
+
+void ReplayWriter::keyframe(uint32_t frame, const std::vector<uint8_t> &state) {
+  flush_inputs();
+
+  std::vector<uint8_t> packed;
+  if (!state_file_pack(state, packed)) {
+    return;
+  }
+  work.clear();
+  append32(work, frame);
+  work.insert(work.end(), packed.begin(), packed.end());
+  chunk("STAT", work);
+}
+
+void ReplayWriter::hash(uint32_t frame, uint32_t crc) {
+  flush_inputs();
+
+  work.clear();
+  append32(work, frame);
+  append32(work, crc);
+  chunk("HASH", work);
+}
+
+bool ReplayWriter::finish() {
+  flush_inputs();
+  sink.detach();
+  return ok;
+}
+
+void ReplayWriter::chunk(const char tag[4], const std::vector<uint8_t> &payload) {
+  /* One write, so the header never goes out without its payload */
+  chunk_buf.resize(CHUNK_HEADER_SIZE);
+  memcpy(&chunk_buf[0], tag, 4);
+  put32(&chunk_buf[4], payload.size());
+  chunk_buf.insert(chunk_buf.end(), payload.begin(), payload.end());
+  if (!sink.write(chunk_buf.data(), chunk_buf.size())) {
+    ok = false;
+  }
+}
+
+/****************************************************************************
+ * ReplayReader
+ *****************************************************************************/
+bool ReplayReader::load(std::vector<uint8_t> &file) {
+  data.swap(file);
+  keyframes.clear();
+  hashes.clear();
+  count = 0;
+  run = 0;
+  keys_pos = keys_end = 0;
+
+  if (data.size() < HEADER_SIZE || memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0) {
+    legacy = true; /* Older format: input records only */
+    pos = 0;
+    return true;
+  }
+  legacy = false;
+  if (get32(&data[8]) != VERSION) {
+    return false;
+  }
+  header_crc = get32(&data[12]);
+  header_rate = get32(&data[16]);
+  key_interval = get32(&data[20]);
+
+  size_t p = HEADER_SIZE;
+  while (data.size() - p >= CHUNK_HEADER_SIZE) {
+    const uint8_t *tag = &data[p];
+    uint32_t length = get32(&data[p + 4]);
+    if (length > data.size() - p - CHUNK_HEADER_SIZE) {
+      break;
+    }
+    const uint8_t *payload = &data[p + CHUNK_HEADER_SIZE];
+    if (memcmp(tag, "STAT", 4) == 0 && length >= 4) {
+      keyframes.push_back({get32(payload), p});
+    } else if (memcmp(tag, "HASH", 4) == 0 && length >= 8) {
+      hashes.push_back({get32(payload), get32(payload + 4)});
+    }
+    p += CHUNK_HEADER_SIZE + length;
+  }
+  data.resize(p); /* Drop a chunk cut short (recording didn't finish) */
+
+  pos = HEADER_SIZE;
+  return !keyframes.empty() && keyframes[0].frame == 0;
+}
+
+long ReplayReader::seek(uint32_t frame, std::vector<uint8_t> &state) {
+  if (legacy || keyframes.empty()) {
+    return -1;
+  }
+
+  /* Keyframes are about key_interval apart, so start there */
+  size_t i = key_interval ? std::min<size_t>(frame / key_interval, keyframes.size() - 1) : 0;
+  while (i > 0 && keyframes[i].frame > frame) {
+    i--;
+  }
+  while (i + 1 < keyframes.size() && keyframes[i + 1].frame <= frame) {
+    i++;
+  }
+
+  const Keyframe &key = keyframes[i];
+  uint32_t length = get32(&data[key.offset + 4]);
+  const uint8_t *packed = &data[key.offset + CHUNK_HEADER_SIZE + 4];
+  std::vector<uint8_t> file(packed, packed + length - 4);
+  if (!state_file_unpack(file, state)) {
+    return -1;
+  }
+
+  pos = key.offset + CHUNK_HEADER_SIZE + length;
+  keys_pos = keys_end = 0;
+  run = 0;
+  count = key.frame;
+  return key.frame;
+}
+
+/* Move to the next KEYS chunk */
+bool ReplayReader::next_keys() {
+  while (data.size() - pos >= CHUNK_HEADER_SIZE) {
+    const uint8_t *tag = &data[pos];
+    uint32_t length = get32(&data[pos + 4]);
+    size_t payload = pos + CHUNK_HEADER_SIZE;
+    pos = payload + length;
+    if (memcmp(tag, "KEYS", 4) == 0 && length >= 8) {
+      keys_pos = payload + 8;
+      keys_end = payload + length;
+      memset(last, 0, sizeof(last));
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ReplayReader::input(uint8_t *record) {
+  if (legacy) {
+    if (data.size() - pos < REPLAY_INPUT_SIZE) {
+      return false;
+    }
+    memcpy(record, &data[pos], REPLAY_INPUT_SIZE);
+    pos += REPLAY_INPUT_SIZE;
+    count++;
+    return true;
+  }
+
+  while (run == 0) {
+    if (keys_pos >= keys_end) {
+      if (!next_keys()) {
+        return false;
+      }
+      continue;
+    }
+    uint32_t mask;
+    if (!get_varint(data.data(), keys_end, keys_pos, run) || keys_end - keys_pos < 4) {
+      keys_pos = keys_end = 0;
+      run = 0;
+      return false; /* Broken */
+    }
+    mask = get32(&data[keys_pos]);
+    keys_pos += 4;
+    for (size_t i = 0; i < REPLAY_INPUT_SIZE; i++) {
+      if (mask & (1u << i)) {
+        if (keys_pos >= keys_end) {
+          return false;
+        }
+        last[i] = data[keys_pos++];
+      }
+    }
+  }
+
+  run--;
+  memcpy(record, last, REPLAY_INPUT_SIZE);
+  count++;
+  return true;
+}
+
+bool ReplayReader::hash(uint32_t frame, uint32_t *crc) const {
+  auto it = std::lower_bound(hashes.begin(), hashes.end(), frame,
+                             [](const Hash &h, uint32_t f) { return h.frame < f; });
+  if (it == hashes.end() || it->frame != frame) {
+    return false;
+  }
+  *crc = it->crc;
+  return true;
+}
+
+/****************************************************************************
+ * 記録・再生
+ *****************************************************************************/
+int replay_key_seconds = 10;
+int replay_seek_seconds = 0;
+int replay_seeking = false;
+
+static OSD_FILE *fp_rec;
+static ReplayWriter writer;
+static bool recording = false;
+static uint32_t key_interval; /* Inputs between keyframes */
+static uint32_t hash_interval;
+static uint32_t next_key;
+static uint32_t next_hash;
+
+static ReplayReader reader;
+static bool playing = false;
+static long seek_to = -1;
+static uint32_t checked;      /* Frame whose hash was compared last */
+static bool desynced = false;
+
+static std::vector<uint8_t> state_buf;
+
+/* Inputs per 1000 seconds. One input is read every boost vsyncs */
+static uint32_t input_rate() { return (uint32_t)(vsync_freq_hz * 1000.0 / std::max(boost, 1)); }
+
+/*
+ * Settings that are not in the state but change how the machine runs.
+ * Playback with different ones won't give the same result.
+ */
+static uint32_t config_crc() {
+  std::vector<uint8_t> buf;
+  for (int v : {fdc_wait, fdc_instant, memory_wait, cmt_intr, cmt_speed, highspeed_mode, use_siomouse}) {
+    append32(buf, (uint32_t)v);
+  }
+  buf.insert(buf.end(), main_rom, main_rom + 0x8000);
+  for (int i = 0; i < 4; i++) {
+    buf.insert(buf.end(), main_rom_ext[i], main_rom_ext[i] + 0x2000);
+  }
+  buf.insert(buf.end(), main_rom_n, main_rom_n + 0x8000);
+  buf.insert(buf.end(), sub_romram, sub_romram + 0x2000);
+  return archive_crc32(buf.data(), buf.size());
+}
+
+bool replay_record_start(const char *path) {
+  fp_rec = osd_fopen(FTYPE_KEY_REC, path, "wb");
+  if (fp_rec == nullptr) {
+    return false;
+  }
+  if (!statesave_buffer(state_buf)) {
+    osd_fclose(fp_rec);
+    fp_rec = nullptr;
+    return false;
+  }
+
+  uint32_t rate = input_rate();
+  key_interval = (uint32_t)((uint64_t)replay_key_seconds * rate / 1000);
+  hash_interval = std::max<uint32_t>(rate / 1000, 1); /* About a second */
+  next_key = key_interval;
+  next_hash = hash_interval;
+
+  writer.start(fp_rec, config_crc(), key_interval, rate, state_buf);
+  recording = true;
+  return true;
+}
+
+bool replay_record_input(const uint8_t *record) { return recording && writer.input(record); }
+
+void replay_record_stop() {
+  if (!recording) {
+    return;
+  }
+  if (!writer.finish()) {
+    QLOG_WARN("proc", "Can't write the whole record file");
+  }
+  osd_fclose(fp_rec);
+  fp_rec = nullptr;
+  recording = false;
+}
+
+bool replay_recording() { return recording; }
+
+bool replay_playback_start(const char *path) {
+  OSD_FILE *fp = osd_fopen(FTYPE_KEY_PB, path, "rb");
+  if (fp == nullptr) {
+    return false;
+  }
+  std::vector<uint8_t> file;
+  bool ok = (osd_fseek(fp, 0, SEEK_END) == 0);
+  long size = ok ? osd_ftell(fp) : -1;
+  if (size >= 0 && osd_fseek(fp, 0, SEEK_SET) == 0) {
+    file.resize(size);
+    ok = (osd_fread(file.data(), 1, size, fp) == (size_t)size);
+  } else {
+    ok = false;
+  }
+  osd_fclose(fp);
+
+  if (!ok || !reader.load(file)) {
+    QLOG_WARN("proc", "Playback file <{}> is broken", path);
+    return false;
+  }
+
+  if (reader.is_legacy()) {
+    QLOG_INFO("proc", "Playback file <{}> has no state, playing from the current machine", path);
+  } else {
+    if (reader.config_crc() != config_crc()) {
+      QLOG_WARN("proc", "Playback file <{}> was recorded with other ROMs or settings", path);
+    }
+    if (reader.seek(0, state_buf) < 0 || !quasi88_stateload_memory(state_buf.data(), state_buf.size())) {
+      QLOG_WARN("proc", "Can't load the state of playback file <{}>", path);
+      reader = ReplayReader();
+      return false;
+    }
+  }
+
+  playing = true;
+  desynced = false;
+  checked = UINT32_MAX;
+  seek_to = -1;
+  if (replay_seek_seconds > 0 && !reader.is_legacy()) {
+    seek_to = (long)((uint64_t)replay_seek_seconds * reader.rate() / 1000);
+  }
+  return true;
+}
+
+bool replay_playback_input(uint8_t *record) { return playing && reader.input(record); }
+
+void replay_playback_stop() {
+  playing = false;
+  reader = ReplayReader(); /* Free the file */
+}
+
+bool replay_playing() { return playing; }
+
+/* Load the keyframe before seek_to, and emulate the rest without drawing */
+static void replay_seek() {
+  uint32_t target = (uint32_t)seek_to;
+  seek_to = -1;
+
+  if (reader.seek(target, state_buf) < 0 || !quasi88_stateload_memory(state_buf.data(), state_buf.size())) {
+    QLOG_WARN("proc", "Playback: can't seek to frame {}", target);
+    replay_playback_stop();
+    return;
+  }
+
+  runahead_hidden = true;
+  replay_seeking = true;
+  while (playing && reader.frames() < target) {
+    quasi88_event_flags &= ~EVENT_FRAME_UPDATE;
+    emu_main();
+    if (!(quasi88_event_flags & EVENT_FRAME_UPDATE)) {
+      break; /* Stopped by something else */
+    }
+  }
+  replay_seeking = false;
+  runahead_hidden = false;
+
+  QLOG_INFO("proc", "Playback: seek to frame {}", reader.frames());
+  status_message(1, STATUS_INFO_TIME, "Playback  [Seek]");
+}
+
+void replay_frame() {
+  if (recording) {
+    uint32_t frame = writer.frames();
+    if (key_interval > 0 && frame >= next_key) {
+      if (statesave_buffer(state_buf)) {
+        writer.keyframe(frame, state_buf);
+      }
+      next_key = frame + key_interval;
+    }
+    if (frame >= next_hash) {
+      if (statesave_buffer(state_buf)) {
+        writer.hash(frame, statesave_hash(state_buf));
+      }
+      next_hash = frame + hash_interval;
+    }
+  }
+
+  if (playing && !reader.is_legacy()) {
+    if (seek_to >= 0) {
+      replay_seek();
+    }
+
+    uint32_t frame = reader.frames();
+    uint32_t crc;
+    if (!desynced && frame != checked && reader.hash(frame, &crc)) {
+      checked = frame;
+      if (statesave_buffer(state_buf) && statesave_hash(state_buf) != crc) {
+        desynced = true;
+        QLOG_WARN("proc", "Playback: desync at frame {}", frame);
+        status_message(1, STATUS_INFO_TIME, "Playback  [Desync]");
+      }
+    }
+  }
+}
@@ -0,0 +1,135 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#pragma once
+
+/*
+ * Replay files for key input record and playback (-record / -playback).
+ *
+ * A replay starts with the state of the machine when recording started and
+ * a CRC of the settings that a state doesn't hold (ROMs, FDC and tape
+ * timing options). The inputs, one record per vsync, are stored as runs of
+ * unchanged records and the bytes that changed. Every replay_key_seconds a
+ * state keyframe is added, and about every second a hash of the machine
+ * (RAM, VRAM and CPU registers, see statesave_hash()).
+ *
+ * Playback loads the first state, so it starts from the same machine as the
+ * recording. The hashes are compared as the replay goes on, and the first
+ * mismatch is reported as a desync. With -playbackseek, playback loads the
+ * keyframe before that time and emulates the rest without drawing.
+ *
+ * Key record files of older versions (a bare stream of input records) are
+ * still played back.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "file-op.h"
+#include "output-sink.h"
+
+constexpr size_t REPLAY_INPUT_SIZE = 24; /* Size of one input record */
+
+extern int replay_key_seconds;  /* Seconds between keyframes (0: the first only) */
+extern int replay_seek_seconds; /* Start playback at this time */
+extern int replay_seeking;      /* True while emulating up to the seek position */
+
+class ReplayWriter {
+public:
+  /* Start writing to fp (owned by the caller), with the state at frame 0 */
+  void start(OSD_FILE *fp, uint32_t config_crc, uint32_t key_interval, uint32_t rate,
+             const std::vector<uint8_t> &state);
+  /* False once anything failed to be written */
+  bool input(const uint8_t *record);
+  void keyframe(uint32_t frame, const std::vector<uint8_t> &state);
+  void hash(uint32_t frame, uint32_t crc);
+  /* Write out everything. False if anything failed to be written */
+  bool finish();
+
+  uint32_t frames() const { return count; }
+
+private:
+  void emit();
+  void flush_inputs();
+  void chunk(const char tag[4], const std::vector<uint8_t> &payload);
+
+  OutputSink sink;
+  bool ok = false;
+  uint32_t count = 0;       /* Inputs so far */
+  uint32_t keys_first = 0;  /* Frame of the first input in keys */
+  uint32_t keys_count = 0;  /* Inputs in keys */
+  uint32_t run = 0;         /* Frames the last record repeats */
+  std::vector<uint8_t> keys; /* Encoded inputs not written yet */
+  uint8_t base[REPLAY_INPUT_SIZE] = {}; /* Record the next entry is relative to */
+  uint8_t last[REPLAY_INPUT_SIZE] = {};
+  std::vector<uint8_t> work;
+  std::vector<uint8_t> chunk_buf; /* Header and payload of a chunk */
+};
+
+class ReplayReader {
+public:
+  /* Take the contents of a replay file. False if it is broken */
+  bool load(std::vector<uint8_t> &file);
+
+  bool is_legacy() const { return legacy; }
+  uint32_t config_crc() const { return header_crc; }
+  /* Inputs per 1000 seconds when it was recorded */
+  uint32_t rate() const { return header_rate; }
+
+  /*
+   * Unpack the last keyframe at or before frame into state, and continue
+   * the inputs from there. Returns the frame of the keyframe, or -1.
+   */
+  long seek(uint32_t frame, std::vector<uint8_t> &state);
+
+  /* Next input record. False at the end */
+  bool input(uint8_t *record);
+  uint32_t frames() const { return count; }
+
+  /* The hash recorded at frame. False if there is none */
+  bool hash(uint32_t frame, uint32_t *crc) const;
+
+private:
+  struct Keyframe {
+    uint32_t frame;
+    size_t offset; /* Of the chunk */
+  };
+  struct Hash {
+    uint32_t frame;
+    uint32_t crc;
+  };
+
+  bool next_keys();
+
+  std::vector<uint8_t> data;
+  bool legacy = false;
+  uint32_t header_crc = 0;
+  uint32_t header_rate = 0;
+  uint32_t key_interval = 0;
+  std::vector<Keyframe> keyframes;
+  std::vector<Hash> hashes;
+
+  size_t pos = 0;        /* Next chunk to read */
+  size_t keys_pos = 0;   /* Next entry in the current KEYS chunk */
+  size_t keys_end = 0;
+  uint32_t count = 0;    /* Inputs so far */
+  uint32_t run = 0;      /* Frames the current record still repeats */
+  uint8_t last[REPLAY_INPUT_SIZE] = {};
+};
+
+/* -record: start recording (call after the machine is initialized) */
+bool replay_record_start(const char *path);
+/* False if the replay can't be written any more */
+bool replay_record_input(const uint8_t *record);
+void replay_record_stop();
+bool replay_recording();
+
+/* -playback: load the replay and its first state */
+bool replay_playback_start(const char *path);
+/* Next input record. False at the end of the replay */
+bool replay_playback_input(uint8_t *record);
+void replay_playback_stop();
+bool replay_playing();
+
+/* Called after each emulated frame: keyframes, hashes and seeking */
+void replay_frame();
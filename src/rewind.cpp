@@ -0,0 +1,341 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <system_error>
+
+#include "rewind.h"
+
+#include "Core/Log.h"
+
+#include "event.h"
+#include "status.h"
+#include "suspend.h"
+
+extern "C" {
+#if USE_RETROACHIEVEMENTS
+#include "retroachievements.h"
+#endif
+}
+
+int rewind_interval = 0;
+int rewind_memory = 64;
+
+namespace {
+
+/*
+ * Delta encoding: a sequence of (zero run, literal length, literal bytes),
+ * the lengths as LEB128. Zero runs shorter than MIN_RUN stay in the literal.
+ */
+constexpr size_t MIN_RUN = 8;
+
+void put_length(std::vector<uint8_t> &out, size_t n) {
+  while (n >= 0x80) {
+    out.push_back(static_cast<uint8_t>(n | 0x80));
+    n >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(n));
+}
+
+bool get_length(const uint8_t *&p, const uint8_t *end, size_t *n) {
+  size_t value = 0;
+  for (int shift = 0; p < end && shift < 64; shift += 7) {
+    uint8_t c = *p++;
+    value |= static_cast<size_t>(c & 0x7f) << shift;
+    if ((c & 0x80) == 0) {
+      *n = value;
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Index of the first non-zero byte of d[i..n), or n */
+size_t skip_zero(const uint8_t *d, size_t i, size_t n) {
+  for (; i + 8 <= n; i += 8) {
+    uint64_t w;
+    memcpy(&w, d + i, 8);
+    if (w != 0) {
+      break;
+    }
+  }
+  while (i < n && d[i] == 0) {
+    i++;
+  }
+  return i;
+}
+
+void encode_delta(const uint8_t *d, size_t n, std::vector<uint8_t> &out) {
+  out.clear();
+  size_t i = 0;
+  while (i < n) {
+    size_t lit = skip_zero(d, i, n);
+    size_t end = lit;
+    while (end < n) {
+      if (d[end] != 0) {
+        end++;
+        continue;
+      }
+      size_t z = end;
+      while (z < n && d[z] == 0 && z - end < MIN_RUN) {
+        z++;
+      }
+      if (z == n || z - end >= MIN_RUN) {
+        break;
+      }
+      end = z;
+    }
+    put_length(out, lit - i);
+    put_length(out, end - lit);
+    out.insert(out.end(), d + lit, d + end);
+    i = end;
+  }
+}
+
+/* XOR the decoded delta into dst[0..n) */
+bool apply_delta(const std::vector<uint8_t> &delta, uint8_t *dst, size_t n) {
+  const uint8_t *p = delta.data();
+  const uint8_t *end = p + delta.size();
+  size_t pos = 0;
+  while (p < end) {
+    size_t zero, lit;
+    if (!get_length(p, end, &zero) || !get_length(p, end, &lit)) {
+      return false;
+    }
+    if (zero > n - pos || lit > n - pos - zero || lit > static_cast<size_t>(end - p)) {
+      return false;
+    }
+    pos += zero;
+    for (size_t i = 0; i < lit; i++) {
+      dst[pos + i] ^= p[i];
+    }
+    p += lit;
+    pos += lit;
+  }
+  return true;
+}
+
+} // namespace
+
+RewindRing::~RewindRing() {
+  if (worker.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stop = true;
+    }
+    cv_work.notify_one();
+    worker.join();
+  }
+}
+
+void RewindRing::set_budget(size_t bytes) {
+  std::lock_guard<std::mutex> lock(mutex);
+  budget = bytes;
+}
+
+void RewindRing::push(std::vector<uint8_t> &state) {
+  std::unique_lock<std::mutex> lock(mutex);
+
+  if (!started) {
+    started = true;
+    try {
+      worker = std::thread(&RewindRing::run, this);
+    } catch (const std::system_error &) {
+      QLOG_WARN("proc", "Can't start rewind thread, capturing synchronously");
+    }
+  }
+
+  if (!worker.joinable()) {
+    add(state, budget);
+    return;
+  }
+  if (pending.size() >= MAX_PENDING) {
+    return; /* The worker is behind. Skip this one */
+  }
+
+  pending.push_back(std::move(state));
+  state.clear();
+  if (!spare.empty()) {
+    state.swap(spare.back());
+    spare.pop_back();
+  }
+  lock.unlock();
+  cv_work.notify_one();
+}
+
+void RewindRing::run() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    cv_work.wait(lock, [&] { return stop || !pending.empty(); });
+    if (stop) {
+      break;
+    }
+    std::vector<uint8_t> state = std::move(pending.front());
+    pending.pop_front();
+    size_t limit = budget;
+    busy = true;
+    lock.unlock();
+
+    add(state, limit);
+
+    lock.lock();
+    state.clear();
+    spare.push_back(std::move(state));
+    busy = false;
+    if (pending.empty()) {
+      cv_idle.notify_all();
+    }
+  }
+}
+
+void RewindRing::add(std::vector<uint8_t> &state, size_t limit) {
+  if (!latest.empty()) {
+    /* XOR of the two states, the shorter one padded with zeros */
+    size_t common = std::min(latest.size(), state.size());
+    const std::vector<uint8_t> &longer = (latest.size() > state.size()) ? latest : state;
+    diff.resize(longer.size());
+    for (size_t i = 0; i < common; i++) {
+      diff[i] = latest[i] ^ state[i];
+    }
+    std::copy(longer.begin() + common, longer.end(), diff.begin() + common);
+
+    encode_delta(diff.data(), diff.size(), work);
+    entries.push_back({latest.size(), std::vector<uint8_t>(work.begin(), work.end())});
+    used += entries.back().delta.size();
+  }
+  latest.swap(state); /* state gets the old buffer, to be reused */
+
+  while (!entries.empty() && used + latest.size() > limit) {
+    used -= entries.front().delta.size();
+    entries.pop_front();
+  }
+}
+
+void RewindRing::wait_idle(std::unique_lock<std::mutex> &lock) {
+  cv_idle.wait(lock, [&] { return pending.empty() && !busy; });
+}
+
+bool RewindRing::pop(std::vector<uint8_t> &state) {
+  std::unique_lock<std::mutex> lock(mutex);
+  wait_idle(lock);
+
+  if (latest.empty()) {
+    return false;
+  }
+  state.assign(latest.begin(), latest.end());
+
+  /* The state before it becomes the newest */
+  if (entries.empty()) {
+    latest.clear();
+    return true;
+  }
+  const Entry &e = entries.back();
+  latest.resize(std::max(latest.size(), e.size), 0);
+  if (apply_delta(e.delta, latest.data(), latest.size())) {
+    latest.resize(e.size);
+    used -= e.delta.size();
+    entries.pop_back();
+  } else {
+    QLOG_WARN("proc", "Rewind: broken delta, older states dropped");
+    latest.clear();
+    entries.clear();
+    used = 0;
+  }
+  return true;
+}
+
+void RewindRing::clear() {
+  std::unique_lock<std::mutex> lock(mutex);
+  for (auto &p : pending) {
+    p.clear();
+    spare.push_back(std::move(p));
+  }
+  pending.clear();
+  wait_idle(lock);
+
+  entries.clear();
+  latest.clear();
+  used = 0;
+}
+
+size_t RewindRing::count() {
+  std::unique_lock<std::mutex> lock(mutex);
+  wait_idle(lock);
+  return latest.empty() ? 0 : entries.size() + 1;
+}
+
+/*----------------------------------------------------------------------*/
+
+static RewindRing ring;
+static std::vector<uint8_t> capture_buf;
+static std::vector<uint8_t> load_buf;
+static int frame_count;
+static bool requested;
+static bool captured; /* The ring may hold states */
+static int budget_memory; /* rewind_memory given to the ring (0: not yet) */
+
+static void rewind_step() {
+#if USE_RETROACHIEVEMENTS
+  if (!RA_WarnDisableHardcore("rewind")) {
+    return;
+  }
+#endif
+
+  if (!ring.pop(load_buf)) {
+    status_message(1, STATUS_INFO_TIME, "Rewind: no more states");
+    return;
+  }
+
+  if (quasi88_stateload_memory(load_buf.data(), load_buf.size())) {
+    char msg[32];
+    snprintf(msg, sizeof(msg), "Rewind (%zu left)", ring.count());
+    status_message(1, STATUS_INFO_TIME, msg);
+  } else {
+    status_message(1, STATUS_INFO_TIME, "Rewind Failed !  Reset done ...");
+    rewind_clear();
+  }
+}
+
+void rewind_frame() {
+  if (rewind_interval <= 0) {
+    if (captured) {
+      rewind_clear();
+    }
+    if (requested) {
+      requested = false;
+      status_message(1, STATUS_INFO_TIME, "Rewind is off (-rewind)");
+    }
+    return;
+  }
+
+  if (requested) {
+    requested = false;
+    frame_count = 0;
+    rewind_step();
+    return;
+  }
+
+  if (++frame_count < rewind_interval) {
+    return;
+  }
+  frame_count = 0;
+
+  int memory = std::max(rewind_memory, 1);
+  if (memory != budget_memory) { /* -rewindmem can be changed at run time */
+    budget_memory = memory;
+    ring.set_budget(static_cast<size_t>(memory) << 20);
+  }
+  if (statesave_buffer(capture_buf)) {
+    ring.push(capture_buf);
+    captured = true;
+  }
+}
+
+void rewind_request() { requested = true; }
+
+void rewind_clear() {
+  ring.clear();
+  frame_count = 0;
+  captured = false;
+}
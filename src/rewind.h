@@ -0,0 +1,87 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#pragma once
+
+/*
+ * Rewind: a ring of recent states kept in memory.
+ *
+ * Every rewind_interval frames the state is saved into memory (the same
+ * bytes as a state file) and handed to a background thread. The thread
+ * keeps the newest state as is, and each older one as the XOR of it and the
+ * state after it, compressed by runs of zero bytes. Most of the machine does
+ * not change between two captures, so an entry is usually a few KB. When the
+ * ring grows over rewind_memory MB, the oldest states are dropped.
+ *
+ * The rewind key loads the newest state and steps the ring back by one.
+ */
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+extern int rewind_interval; /* Frames between captures (0: rewind off) */
+extern int rewind_memory;   /* Memory for the ring, in MB */
+
+class RewindRing {
+public:
+  RewindRing() = default;
+  ~RewindRing();
+
+  RewindRing(const RewindRing &) = delete;
+  RewindRing &operator=(const RewindRing &) = delete;
+
+  void set_budget(size_t bytes);
+
+  /*
+   * Add a state to the ring. The contents are taken over, and state gets
+   * an unused buffer back to save the next state into.
+   */
+  void push(std::vector<uint8_t> &state);
+
+  /* Take the newest state out of the ring. False if the ring is empty */
+  bool pop(std::vector<uint8_t> &state);
+
+  void clear();
+
+  /* Number of states in the ring */
+  size_t count();
+
+private:
+  struct Entry {
+    size_t size;                /* Size of this state */
+    std::vector<uint8_t> delta; /* Compressed XOR with the next state */
+  };
+
+  void run();
+  void add(std::vector<uint8_t> &state, size_t limit);
+  void wait_idle(std::unique_lock<std::mutex> &lock);
+
+  static constexpr size_t MAX_PENDING = 4;
+
+  std::thread worker;
+  std::mutex mutex;
+  std::condition_variable cv_work; /* Something pending, or stop */
+  std::condition_variable cv_idle; /* The worker has nothing to do */
+  std::deque<std::vector<uint8_t>> pending;
+  std::vector<std::vector<uint8_t>> spare;
+  bool busy = false;
+  bool stop = false;
+  bool started = false;
+  size_t budget = 0; /* The worker takes a copy with each state */
+
+  /* Below are used by the worker, or by others while the worker is idle */
+  std::deque<Entry> entries; /* Oldest first */
+  std::vector<uint8_t> latest;
+  std::vector<uint8_t> diff;
+  std::vector<uint8_t> work;
+  size_t used = 0; /* Sum of the deltas */
+};
+
+/* Called after each emulated frame: captures, or rewinds if requested */
+void rewind_frame();
+/* Ask for a rewind at the end of the current frame */
+void rewind_request();
+void rewind_clear();
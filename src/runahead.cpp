@@ -0,0 +1,87 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#include <cstdint>
+#include <vector>
+
+#include "quasi88.h"
+
+#include "runahead.h"
+
+#include "Core/Log.h"
+
+#include "emu.h"
+#include "event.h"
+#include "fdc.h"
+#include "pc88main.h"
+#include "screen.h"
+#include "snddrv.h"
+#include "suspend.h"
+
+int runahead_frames = 0;
+int runahead_hidden = false;
+
+static std::vector<uint8_t> state_buf;
+static bool running_ahead = false; /* Not while seeking a replay (also hidden) */
+static bool disk_write_held = false;
+
+bool runahead_hold_disk_write() {
+  if (!running_ahead) {
+    return false;
+  }
+  disk_write_held = true;
+  return true;
+}
+
+static bool can_run_ahead() {
+  if (runahead_frames <= 0) {
+    return false;
+  }
+  if (quasi88_event_flags & (EVENT_MODE_CHANGED | EVENT_DEBUG | EVENT_QUIT)) {
+    return false;
+  }
+  /*
+   * The disk image and serial input are not part of the state, so they
+   * can't be taken back. The hidden frames must not touch them: a disk
+   * command that starts in one is held before it writes (see below).
+   */
+  return emu_is_free_running() && fdc_idle() && !serial_in_connected() && screen_update_will_draw();
+}
+
+void runahead_screen_update() {
+  if (!can_run_ahead() || !statesave_buffer(state_buf)) {
+    screen_update();
+    return;
+  }
+
+  int flags = quasi88_event_flags;
+
+  screen_runahead_begin();
+  xmame_dev_suppress(true);
+  runahead_hidden = true;
+  running_ahead = true;
+  disk_write_held = false;
+
+  for (int i = 0; i < runahead_frames; i++) {
+    quasi88_event_flags &= ~EVENT_FRAME_UPDATE;
+    emu_main();
+    if (!(quasi88_event_flags & EVENT_FRAME_UPDATE) || !fdc_idle() || disk_write_held) {
+      break; /* Stopped by something else, or the disk is accessed */
+    }
+  }
+
+  running_ahead = false;
+  runahead_hidden = false;
+  xmame_dev_suppress(false);
+
+  screen_update_runahead();
+
+  /* Back to the frame actually emulated */
+  quasi88_event_flags = flags;
+  if (stateload_buffer(state_buf.data(), state_buf.size())) {
+    pc88main_runahead_restore();
+  } else {
+    QLOG_ERROR("proc", "Run-ahead: can't load the state back, reset");
+    runahead_frames = 0;
+    quasi88_reset(nullptr);
+  }
+}
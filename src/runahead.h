@@ -0,0 +1,31 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#pragma once
+
+/*
+ * Run-ahead: show a frame that is runahead_frames ahead of the emulation.
+ *
+ * The input is read once per frame, and a program usually reacts to it on
+ * the next frame or later. With run-ahead, after each frame the state is
+ * saved into memory, the following frames are emulated with the same input
+ * (hidden: no sound output, no input, no file output), the last of them is
+ * drawn, and the state is loaded back. The reaction to a key press is then
+ * on the screen runahead_frames earlier.
+ *
+ * Run-ahead is skipped for the frame while the disk is being accessed, a
+ * serial input is connected, a breakpoint is set, or the frame is not drawn.
+ * A disk command started in a hidden frame can still finish within it, so a
+ * write to the image is held back (runahead_hold_disk_write()).
+ */
+
+extern int runahead_frames; /* Frames to run ahead (0: off) */
+extern int runahead_hidden; /* True while emulating a hidden frame */
+
+/*
+ * Asked by the FDC before it writes to a disk image. True in a run-ahead
+ * frame, whose writes could not be taken back: the FDC then stops without
+ * writing, and the run-ahead ends with that frame.
+ */
+bool runahead_hold_disk_write();
+
+/* In place of screen_update() after an emulated frame */
+void runahead_screen_update();
@@ -1644,6 +1644,58 @@ void screen_update_immidiate() {
   screen_update(); /* 描画処理 */
 }
 
+/*
+ * 先行実行したフレームを描画する。
+ *  描画後にステートを先行実行前に戻すので、先行実行中に書き換えた部分は、
+ *  次の描画の時には書き換わっていないかもしれない。そこで、先行実行の前に
+ *  メイン領域の更新フラグを退避・クリアしておき、先行実行中に立ったフラグ
+ *  だけを描画後に立て直して、次の描画でもう一度描くようにする。
+ */
+static char runahead_dirty_flag[sizeof(screen_dirty_flag)];
+static int runahead_dirty_all;
+static int runahead_dirty_palette;
+
+void screen_runahead_begin() {
+  memcpy(runahead_dirty_flag, screen_dirty_flag, sizeof(screen_dirty_flag));
+  runahead_dirty_all = screen_dirty_all;
+  runahead_dirty_palette = screen_dirty_palette;
+
+  memset(screen_dirty_flag, 0, sizeof(screen_dirty_flag));
+  screen_dirty_all = false;
+  screen_dirty_palette = false;
+}
+
+void screen_update_runahead() {
+  size_t i;
+  int ahead_all = screen_dirty_all;
+  int ahead_palette = screen_dirty_palette;
+
+  /* 退避したフラグと、先行実行中に立ったフラグを入れ替えて合わせる */
+  for (i = 0; i < sizeof(screen_dirty_flag); i++) {
+    char ahead = screen_dirty_flag[i];
+    screen_dirty_flag[i] |= runahead_dirty_flag[i];
+    runahead_dirty_flag[i] = ahead;
+  }
+  screen_dirty_all |= runahead_dirty_all;
+  screen_dirty_palette |= runahead_dirty_palette;
+
+  screen_update(); /* 描画処理 */
+
+  for (i = 0; i < sizeof(screen_dirty_flag); i++) {
+    screen_dirty_flag[i] |= runahead_dirty_flag[i];
+  }
+  screen_dirty_all |= ahead_all;
+  screen_dirty_palette |= ahead_palette;
+}
+
+/* 次の screen_update() でメイン領域を描画するなら真 (スキップなら偽) */
+int screen_update_will_draw() {
+  if ((frame_counter % frameskip_rate) != 0) {
+    return false;
+  }
+  return (no_wait || !use_auto_skip || !do_skip_draw);
+}
+
 int quasi88_info_draw_count() { return drawn_count; }
 
 /***********************************************************************
@@ -237,6 +237,9 @@ void screen_get_menu_palette(PC88_PALETTE_T pal[16]);
  ************************************************************************/
 void screen_update();           /* 描画   (1/60sec毎)  */
 void screen_update_immidiate(); /* 即描画 (モニター用) */
+void screen_runahead_begin();   /* 先行実行の開始     */
+void screen_update_runahead();  /* 描画   (先行実行用) */
+int screen_update_will_draw();  /* 次の描画でメイン領域を描くか */
 
 /***********************************************************************
  * フレームスキップ
@@ -0,0 +1,269 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <system_error>
+
+#include "snapshot-file.h"
+
+#include "Core/Log.h"
+#include "lodepng.h"
+#include "snapshot.h"
+
+namespace {
+
+constexpr size_t PIXELS = SNAPSHOT_WIDTH * SNAPSHOT_HEIGHT;
+
+void put_rgb(std::vector<uint8_t> &file, const uint8_t *pixels, const uint8_t (*palette)[3]) {
+  size_t pos = file.size();
+  file.resize(pos + PIXELS * 3);
+  uint8_t *p = &file[pos];
+  for (size_t i = 0; i < PIXELS; i++) {
+    const uint8_t *rgb = palette[pixels[i]];
+    *p++ = rgb[0];
+    *p++ = rgb[1];
+    *p++ = rgb[2];
+  }
+}
+
+/* 24-bit BMP. Lines are stored bottom up, in BGR order */
+void encode_bmp(const uint8_t *pixels, const uint8_t (*palette)[3], std::vector<uint8_t> &file) {
+  static const uint8_t header[] = {
+      /* Header */
+      'B', 'M',               /* BM */
+      0x36, 0xb8, 0x0b, 0x00, /* File size (0xbb836 / 768054) */
+      0x00, 0x00, 0x00, 0x00, /* Reserved */
+      0x36, 0x00, 0x00, 0x00, /* Image data offset (0x36) */
+      /* InfoHeader */
+      0x28, 0x00, 0x00, 0x00, /* Information size (0x28) */
+      0x80, 0x02, 0x00, 0x00, /* Horizontal width of bitmap in pixels (0x280 / 640) */
+      0x90, 0x01, 0x00, 0x00, /* Vertical height of bitmap in pixels (0x190 / 400) */
+      0x01, 0x00,             /* Number of Planes */
+      0x18, 0x00,             /* Bits per Pixel (0x18 / 24 - 24bit RGB) */
+      0x00, 0x00, 0x00, 0x00, /* Compression (0 -  BI_RGB, no compression) */
+      0x00, 0x00, 0x00, 0x00, /* (compressed) Size of Image */
+      0x00, 0x00, 0x00, 0x00, /* Horizontal resolution: Pixels/meter */
+      0x00, 0x00, 0x00, 0x00, /* Vertical resolution: Pixels/meter */
+      0x00, 0x00, 0x00, 0x00, /* Number of actually used colors */
+      0x00, 0x00, 0x00, 0x00, /* Number of important colors */
+  };
+
+  file.assign(header, header + sizeof(header));
+  file.resize(sizeof(header) + PIXELS * 3);
+  uint8_t *p = &file[sizeof(header)];
+  for (int y = SNAPSHOT_HEIGHT - 1; y >= 0; y--) {
+    const uint8_t *line = &pixels[y * SNAPSHOT_WIDTH];
+    for (int x = 0; x < SNAPSHOT_WIDTH; x++) {
+      const uint8_t *rgb = palette[line[x]];
+      *p++ = rgb[2];
+      *p++ = rgb[1];
+      *p++ = rgb[0];
+    }
+  }
+}
+
+void encode_ppm(const uint8_t *pixels, const uint8_t (*palette)[3], std::vector<uint8_t> &file) {
+  static const char header[] = "P6\n"
+                               "# QUASI88kai\n"
+                               "640 400\n"
+                               "255\n";
+
+  file.assign(header, header + strlen(header));
+  put_rgb(file, pixels, palette);
+}
+
+void encode_raw(const uint8_t *pixels, const uint8_t (*palette)[3], std::vector<uint8_t> &file) {
+  file.clear();
+  put_rgb(file, pixels, palette);
+}
+
+/*
+ * Palette PNG. Only the colours in use go into the palette (entries of the
+ * same colour are merged), so the depth is 4 bits or less unless all 17
+ * entries are used and differ.
+ */
+bool encode_png(const uint8_t *pixels, const uint8_t (*palette)[3], std::vector<uint8_t> &file) {
+  bool used[SNAPSHOT_COLORS] = {};
+  for (size_t i = 0; i < PIXELS; i++) {
+    used[pixels[i]] = true;
+  }
+
+  uint8_t map[SNAPSHOT_COLORS] = {};
+  uint8_t colors[SNAPSHOT_COLORS][3];
+  unsigned ncolors = 0;
+  for (int i = 0; i < SNAPSHOT_COLORS; i++) {
+    if (!used[i]) {
+      continue;
+    }
+    unsigned j = 0;
+    while (j < ncolors && memcmp(colors[j], palette[i], 3) != 0) {
+      j++;
+    }
+    if (j == ncolors) {
+      memcpy(colors[ncolors++], palette[i], 3);
+    }
+    map[i] = j;
+  }
+
+  unsigned depth = (ncolors <= 2) ? 1 : (ncolors <= 4) ? 2 : (ncolors <= 16) ? 4 : 8;
+  unsigned per_byte = 8 / depth;
+
+  /* Pack the pixels; a line is a whole number of bytes at any depth */
+  std::vector<uint8_t> packed(PIXELS / per_byte);
+  for (size_t i = 0, o = 0; i < PIXELS; o++) {
+    uint8_t b = 0;
+    for (unsigned k = 0; k < per_byte; k++) {
+      b = (b << depth) | map[pixels[i++]];
+    }
+    packed[o] = b;
+  }
+
+  LodePNGState state;
+  lodepng_state_init(&state);
+  state.encoder.auto_convert = 0; /* Already in its smallest form */
+  state.info_raw.colortype = LCT_PALETTE;
+  state.info_raw.bitdepth = depth;
+  state.info_png.color.colortype = LCT_PALETTE;
+  state.info_png.color.bitdepth = depth;
+  for (unsigned j = 0; j < ncolors; j++) {
+    lodepng_palette_add(&state.info_raw, colors[j][0], colors[j][1], colors[j][2], 255);
+    lodepng_palette_add(&state.info_png.color, colors[j][0], colors[j][1], colors[j][2], 255);
+  }
+
+  unsigned char *buf = nullptr;
+  size_t size = 0;
+  unsigned error = lodepng_encode(&buf, &size, packed.data(), SNAPSHOT_WIDTH, SNAPSHOT_HEIGHT, &state);
+  lodepng_state_cleanup(&state);
+  if (error == 0) {
+    file.assign(buf, buf + size);
+  }
+  free(buf);
+  return error == 0;
+}
+
+} // namespace
+
+bool snapshot_file_encode(int format, const uint8_t *pixels, const uint8_t (*palette)[3], std::vector<uint8_t> &file) {
+  switch (format) {
+  case SNAPSHOT_FMT_BMP:
+    encode_bmp(pixels, palette, file);
+    return true;
+  case SNAPSHOT_FMT_PPM:
+    encode_ppm(pixels, palette, file);
+    return true;
+  case SNAPSHOT_FMT_RAW:
+    encode_raw(pixels, palette, file);
+    return true;
+  case SNAPSHOT_FMT_PNG:
+    return encode_png(pixels, palette, file);
+  default:
+    return false;
+  }
+}
+
+SnapshotFileWriter::~SnapshotFileWriter() {
+  if (worker.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stop = true;
+    }
+    cv_work.notify_one();
+    worker.join(); /* Everything queued is still written */
+  }
+}
+
+void SnapshotFileWriter::write(const char *path, int format, std::vector<uint8_t> &pixels,
+                               const uint8_t (*palette)[3]) {
+  std::unique_lock<std::mutex> lock(mutex);
+
+  if (!started) {
+    started = true;
+    try {
+      worker = std::thread(&SnapshotFileWriter::run, this);
+    } catch (const std::system_error &) {
+      QLOG_WARN("proc", "Can't start snapshot thread, writing synchronously");
+    }
+  }
+
+  Job job{path, format, std::move(pixels), {}};
+  memcpy(job.palette, palette, sizeof(job.palette));
+  pixels.clear();
+
+  if (!worker.joinable()) {
+    if (!store(job)) {
+      failed = true;
+      failed_path = path;
+    }
+    pixels.swap(job.pixels);
+    return;
+  }
+
+  cv_idle.wait(lock, [&] { return queue.size() < MAX_QUEUED; });
+  queue.push_back(std::move(job));
+  if (!spare.empty()) {
+    pixels.swap(spare.back());
+    spare.pop_back();
+  }
+  lock.unlock();
+  cv_work.notify_one();
+}
+
+void SnapshotFileWriter::wait() {
+  std::unique_lock<std::mutex> lock(mutex);
+  cv_idle.wait(lock, [&] { return queue.empty() && !busy; });
+}
+
+bool SnapshotFileWriter::take_failure(std::string &path) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!failed) {
+    return false;
+  }
+  failed = false;
+  path = failed_path;
+  return true;
+}
+
+void SnapshotFileWriter::run() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    cv_work.wait(lock, [&] { return stop || !queue.empty(); });
+    if (queue.empty()) {
+      break; /* stop, and everything is written */
+    }
+    Job job = std::move(queue.front());
+    queue.pop_front();
+    busy = true;
+    lock.unlock();
+    cv_idle.notify_all(); /* Room in the queue */
+
+    bool ok = store(job);
+
+    lock.lock();
+    if (!ok) {
+      failed = true;
+      failed_path = job.path;
+    }
+    spare.push_back(std::move(job.pixels));
+    busy = false;
+    if (queue.empty()) {
+      cv_idle.notify_all();
+    }
+  }
+}
+
+bool SnapshotFileWriter::store(const Job &job) {
+  if (job.pixels.size() != PIXELS || !snapshot_file_encode(job.format, job.pixels.data(), job.palette, file)) {
+    return false;
+  }
+
+  FILE *fp = fopen(job.path.c_str(), "wb");
+  if (fp == nullptr) {
+    return false;
+  }
+  bool ok = (fwrite(file.data(), 1, file.size(), fp) == file.size());
+  if (fclose(fp) != 0) {
+    ok = false;
+  }
+  return ok;
+}
@@ -0,0 +1,78 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#pragma once
+
+/*
+ * Snapshot files (BMP, PPM, RAW and PNG) made from the palette-indexed
+ * snapshot image.
+ *
+ * PNG files are written with a palette of the colours the image uses, at
+ * the smallest bit depth that holds them (4 bits for a usual PC-8801 screen),
+ * straight from the indices. The other formats are 24-bit RGB.
+ *
+ * Files are encoded and written by a background thread, so a snapshot costs
+ * the emulation only a copy of the indices.
+ */
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+constexpr int SNAPSHOT_WIDTH = 640;
+constexpr int SNAPSHOT_HEIGHT = 400;
+constexpr int SNAPSHOT_COLORS = 16 + 1; /* Index 16 is black */
+
+/* Make a file of format (SNAPSHOT_FMT_xxx) from WIDTH*HEIGHT indices */
+bool snapshot_file_encode(int format, const uint8_t *pixels, const uint8_t (*palette)[3], std::vector<uint8_t> &file);
+
+class SnapshotFileWriter {
+public:
+  SnapshotFileWriter() = default;
+  ~SnapshotFileWriter();
+
+  SnapshotFileWriter(const SnapshotFileWriter &) = delete;
+  SnapshotFileWriter &operator=(const SnapshotFileWriter &) = delete;
+
+  /*
+   * Queue the image to be written to path. The contents of pixels are taken
+   * over, and pixels gets an unused buffer back.
+   */
+  void write(const char *path, int format, std::vector<uint8_t> &pixels, const uint8_t (*palette)[3]);
+
+  /* Wait until everything queued is written */
+  void wait();
+
+  /* True once after a write failed. Its file name is set to path */
+  bool take_failure(std::string &path);
+
+private:
+  static constexpr size_t MAX_QUEUED = 8; /* write() waits beyond this */
+
+  struct Job {
+    std::string path;
+    int format;
+    std::vector<uint8_t> pixels;
+    uint8_t palette[SNAPSHOT_COLORS][3];
+  };
+
+  void run();
+  bool store(const Job &job);
+
+  std::thread worker;
+  std::mutex mutex;
+  std::condition_variable cv_work; /* Something queued, or stop */
+  std::condition_variable cv_idle; /* The worker took a job, or has nothing to do */
+  std::deque<Job> queue;
+  std::vector<std::vector<uint8_t>> spare;
+  bool busy = false;
+  bool stop = false;
+  bool started = false;
+  bool failed = false;
+  std::string failed_path;
+
+  std::vector<uint8_t> file; /* Used by the worker */
+};
@@ -5,6 +5,7 @@
 /************************************************************************/
 
 #include <algorithm>
+#include <string>
 #include <vector>
 
 #include <cstdio>
@@ -14,13 +15,17 @@
 
 #include "quasi88.h"
 
+#include "Core/Log.h"
+
 #include "crtcdmac.h"
 #include "file-op.h"
-#include "lodepng.h"
+#include "intr.h"
 #include "screen.h"
 #include "screen-func.h"
 #include "snapshot.h"
+#include "snapshot-file.h"
 #include "snddrv.h"
+#include "video-capture.h"
 
 char file_snap[QUASI88_MAX_FILENAME];   /* スナップショットベース部 */
 int snapshot_format = SNAPSHOT_FMT_BMP; /* スナップショットフォーマット   */
@@ -58,8 +63,18 @@ void screen_snapshot_init() {
   if (file_wav[0] == '\0') {
     filename_init_wav(false);
   }
+
+  if (file_videoout && file_videoout[0]) { /* -videoout なら、記録開始 */
+    if (!videoout_save_start(file_videoout)) {
+      QLOG_WARN("proc", "Can't open <{}>: Video capture is invalid", file_videoout);
+    }
+  }
+}
+void screen_snapshot_exit() {
+  videoout_save_stop();
+  waveout_save_stop();
+  screen_snapshot_wait();
 }
-void screen_snapshot_exit() { waveout_save_stop(); }
 
 /* Generate screen image */
 typedef int (*SNAPSHOT_FUNC)();
@@ -132,100 +147,17 @@ static void make_snapshot() {
   pal[16].blue = 0;
 }
 
-/* Create raw image from palette screen */
-static std::vector<unsigned char> make_raw_image() {
-  std::vector<unsigned char> raw;
-  raw.reserve(640 * 400 * 3);
-  for (auto i : screen_snapshot) {
-    raw.push_back(pal[i].red);
-    raw.push_back(pal[i].green);
-    raw.push_back(pal[i].blue);
+/* make_snapshot() のパレットを、RGB の配列に変換 */
+static void snapshot_palette(uint8_t rgb[16 + 1][3]) {
+  for (int i = 0; i < 16 + 1; i++) {
+    rgb[i][0] = pal[i].red;
+    rgb[i][1] = pal[i].green;
+    rgb[i][2] = pal[i].blue;
   }
-  return raw;
 }
 
-/* Output the captured content to a file in bmp format (win) */
-static bool save_snapshot_bmp(OSD_FILE *fp, std::vector<uint8_t> raw) {
-  static const unsigned char header[] = {
-      /* Header */
-      'B', 'M',               /* BM */
-      0x36, 0xb8, 0x0b, 0x00, /* File size (0xbb836 / 768054) */
-      0x00, 0x00, 0x00, 0x00, /* Reserved */
-      0x36, 0x00, 0x00, 0x00, /* Image data offset (0x36) */
-      /* InfoHeader */
-      0x28, 0x00, 0x00, 0x00, /* Information size (0x28) */
-      0x80, 0x02, 0x00, 0x00, /* Horizontal width of bitmap in pixels (0x280 / 640) */
-      0x90, 0x01, 0x00, 0x00, /* Vertical height of bitmap in pixels (0x190 / 400) */
-      0x01, 0x00,             /* Number of Planes */
-      0x18, 0x00,             /* Bits per Pixel (0x18 / 24 - 24bit RGB) */
-      0x00, 0x00, 0x00, 0x00, /* Compression (0 -  BI_RGB, no compression) */
-      0x00, 0x00, 0x00, 0x00, /* (compressed) Size of Image */
-      0x00, 0x00, 0x00, 0x00, /* Horizontal resolution: Pixels/meter */
-      0x00, 0x00, 0x00, 0x00, /* Vertical resolution: Pixels/meter */
-      0x00, 0x00, 0x00, 0x00, /* Number of actually used colors */
-      0x00, 0x00, 0x00, 0x00, /* Number of important colors */
-  };
-
-  size_t size_write = sizeof(header);
-  if (osd_fwrite(header, sizeof(char), size_write, fp) < size_write) {
-    return false;
-  }
-
-  const int length = 3 * 640;
-
-  // BMP creators, shame on you
-  for (int y = 400; y > 0; y--) {
-    auto first = raw.begin() + length * (y - 1);
-    auto last = raw.end() + length * y;
-    std::vector<uint8_t> line(first, last);
-    if (osd_fwrite(reinterpret_cast<char *>(line.data()), sizeof(char), length, fp) < length) {
-      return false;
-    }
-  }
-
-  return true;
-}
-
-/* Output the captured content to a file in ppm format (raw) */
-static bool save_snapshot_ppm(OSD_FILE *fp, std::vector<uint8_t> raw) {
-  unsigned char buf[32];
-
-  strcpy((char *)buf, "P6\n"
-                      "# QUASI88kai\n"
-                      "640 400\n"
-                      "255\n");
-  size_t size_write = strlen((char *)buf);
-  if (osd_fwrite(buf, sizeof(char), size_write, fp) < size_write) {
-    return false;
-  }
-  if (osd_fwrite(reinterpret_cast<char *>(raw.data()), sizeof(char), raw.size(), fp) < raw.size()) {
-    return false;
-  }
-
-  return true;
-}
-
-/* Output the captured content to a file in raw format */
-static bool save_snapshot_raw(OSD_FILE *fp, std::vector<uint8_t> raw) {
-  if (osd_fwrite(reinterpret_cast<char *>(raw.data()), sizeof(char), raw.size(), fp) < raw.size()) {
-    return false;
-  }
-
-  return true;
-}
-
-static bool save_snapshot_png(OSD_FILE *fp, std::vector<uint8_t> raw) {
-  unsigned char *buf;
-  size_t length;
-  if (lodepng_encode24(&buf, &length, reinterpret_cast<unsigned char *>(raw.data()), 640, 400)) {
-    return false;
-  }
-  if (osd_fwrite(buf, sizeof(char), length, fp) < length) {
-    return false;
-  }
-
-  return true;
-}
+/* ファイルの作成と書き込みは、別スレッドで行う */
+static SnapshotFileWriter snapshot_writer;
 
 /***********************************************************************
  * 画面のスナップショットをセーブする
@@ -269,7 +201,8 @@ static bool save_snapshot_png(OSD_FILE *fp, std::vector<uint8_t> raw) {
    suffix は拡張子で、以下のものを対象とする。*/
 static const char *snap_suffix[] = {".ppm",  ".PPM",  ".xpm", ".XPM", ".png",  ".PNG",  ".bmp", ".BMP",  ".rgb",
                                     ".RGB",  ".raw",  ".RAW", ".gif", ".GIF",  ".xwd",  ".XWD", ".pict", ".PICT",
-                                    ".tiff", ".TIFF", ".tif", ".TIF", ".jpeg", ".JPEG", ".jpg", ".JPG",  nullptr};
+                                    ".tiff", ".TIFF", ".tif", ".TIF", ".jpeg", ".JPEG", ".jpg", ".JPG",  ".avi",
+                                    ".AVI",  nullptr};
 static void truncate_filename(char filename[], const char *suffix[]) {
   int i;
   char *p;
@@ -313,7 +246,8 @@ int screen_snapshot_save() {
       ".png",
   };
 
-  OSD_FILE *fp;
+  static std::vector<uint8_t> pixels;
+  uint8_t rgb[16 + 1][3];
   int i, j, success;
 
   if (snapshot_format >= COUNTOF(suffix))
@@ -352,45 +286,23 @@ int screen_snapshot_save() {
     }
   }
 
-  /* ファイルを開いて、スナップショットデータを書き込む */
+  /* スナップショットを作成し、ファイルへの書き込みを依頼する。
+     書き込みの結果は screen_snapshot_write_failed() で確認する */
 
   if (success) {
-
-    success = false;
-    if ((fp = osd_fopen(FTYPE_SNAPSHOT_PPM, filename, "wb"))) {
-
-      make_snapshot();
-      std::vector<uint8_t> raw = make_raw_image();
-
-      switch (snapshot_format) {
-      case SNAPSHOT_FMT_BMP:
-        success = save_snapshot_bmp(fp, raw);
-        break;
-      case SNAPSHOT_FMT_PPM:
-        success = save_snapshot_ppm(fp, raw);
-        break;
-      case SNAPSHOT_FMT_RAW:
-        success = save_snapshot_raw(fp, raw);
-        break;
-      case SNAPSHOT_FMT_PNG:
-        success = save_snapshot_png(fp, raw);
-        break;
-      default:
-        success = false;
-      }
-
-      osd_fclose(fp);
-    }
-    /*
-        printf("screen-snapshot : %s ... %s\n",
-                    filename, (success) ? "OK" : "FAILED");
-    */
+    make_snapshot();
+    snapshot_palette(rgb);
+    pixels.assign(screen_snapshot, screen_snapshot + sizeof(screen_snapshot));
+    snapshot_writer.write(filename, snapshot_format, pixels, rgb);
   }
 
   /* 書き込み成功後、コマンドを実行する */
 
 #ifdef USE_SSS_CMD
 
+  if (success && snapshot_cmd_enable && snapshot_cmd_do && snapshot_cmd[0]) {
+    success = screen_snapshot_wait(); /* 書き込みが終わってから */
+  }
   if (success && snapshot_cmd_enable && snapshot_cmd_do && snapshot_cmd[0]) {
 
     size_t a_len, b_len;
@@ -470,10 +382,29 @@ int screen_snapshot_save() {
   return success;
 }
 
+/* 書き込みが全て終わるのを待つ。失敗したものがあれば偽 */
+int screen_snapshot_wait() {
+  snapshot_writer.wait();
+  return (screen_snapshot_write_failed() == false);
+}
+
+/* 書き込みに失敗していたら、一度だけ真を返す (待たない) */
+int screen_snapshot_write_failed() {
+  std::string path;
+
+  if (snapshot_writer.take_failure(path)) {
+    QLOG_ERROR("proc", "Screen snapshot: can't write {}", path);
+    return true;
+  }
+  return false;
+}
+
 /* Save sound output */
 char file_wav[QUASI88_MAX_FILENAME]; /* サウンド出力ベース部   */
 
-static const char *wav_suffix[] = {".wav", ".WAV", nullptr};
+int waveout_format = WAVEOUT_FMT_WAV; /* サウンド出力フォーマット */
+
+static const char *wav_suffix[] = {".wav", ".WAV", ".flac", ".FLAC", nullptr};
 
 void filename_set_wav_base(const char *filename) {
   if (filename) {
@@ -492,7 +423,7 @@ int waveout_save_start() {
   static char filename[QUASI88_MAX_FILENAME + sizeof("NNNN.suffix")];
   static int waveout_no = 0; /* 連番 */
 
-  static const char *suffix = ".wav";
+  const char *suffix = (waveout_format == WAVEOUT_FMT_FLAC) ? ".flac" : ".wav";
 
   int i, j, len, success;
 
@@ -539,3 +470,109 @@ int waveout_save_start() {
 }
 
 void waveout_save_stop() { xmame_wavout_close(); }
+
+/* Save video (and sound) */
+char *file_videoout = nullptr; /* 起動時から記録する動画ファイル */
+
+static VideoCapture video_capture;
+static OSD_FILE *fp_video = nullptr;
+
+/* サウンドドライバ (のスレッド) から、ミックス済みのサウンドを受け取る */
+static void videoout_audio(const int16_t *data, int samples) { video_capture.audio(data, samples); }
+
+int videoout_save_start(const char *filename) {
+  static char auto_filename[QUASI88_MAX_FILENAME + sizeof("NNNN.suffix")];
+  static int videoout_no = 0; /* 連番 */
+
+  int i, j;
+
+  videoout_save_stop();
+
+  if (filename == nullptr) {
+
+    /* ファイル名が未指定の場合、初期ファイル名にする */
+
+    if (file_snap[0] == '\0') {
+      filename_init_snap(false);
+    }
+    truncate_filename(file_snap, snap_suffix);
+
+    /* 存在しないファイル名を探しだす (0000.avi〜 9999.avi) */
+
+    for (j = 0; j < 10000; j++) {
+
+      size_t len = sprintf(auto_filename, "%s%04d", file_snap, videoout_no);
+      if (++videoout_no > 9999)
+        videoout_no = 0;
+
+      for (i = 0; snap_suffix[i]; i++) {
+        auto_filename[len] = '\0';
+        strcat(auto_filename, snap_suffix[i]);
+        if (osd_file_stat(auto_filename) != FILE_STAT_NOEXIST)
+          break;
+      }
+      if (snap_suffix[i] == nullptr) { /* 見つかった */
+        auto_filename[len] = '\0';
+        strcat(auto_filename, ".avi");
+        filename = auto_filename;
+        break;
+      }
+    }
+    if (filename == nullptr) {
+      return false;
+    }
+  }
+
+  fp_video = osd_fopen(FTYPE_WRITE, filename, "wb");
+  if (fp_video == nullptr) {
+    return false;
+  }
+
+  make_snapshot();
+  uint8_t rgb[16 + 1][3];
+  snapshot_palette(rgb);
+
+  /* サウンドなしの場合は、映像のみ */
+  int sample_rate = xmame_audio_capture(nullptr);
+
+  if (!video_capture.start(fp_video, vsync_freq_hz, sample_rate, rgb, 16 + 1)) {
+    osd_fclose(fp_video);
+    fp_video = nullptr;
+    return false;
+  }
+  if (sample_rate) {
+    xmame_audio_capture(videoout_audio);
+  }
+  QLOG_DEBUG("proc", "Video capture <{}> ... OK", filename);
+  return true;
+}
+
+void videoout_save_stop() {
+  if (fp_video == nullptr) {
+    return;
+  }
+  xmame_audio_capture(nullptr); /* サウンドスレッドからの呼び出しを止めてから */
+  if (!video_capture.stop()) {
+    QLOG_WARN("proc", "Video capture: write failed");
+  }
+  osd_fclose(fp_video);
+  fp_video = nullptr;
+}
+
+int videoout_saving() { return fp_video != nullptr; }
+
+int videoout_save_frame() {
+  if (fp_video == nullptr) {
+    return true;
+  }
+  make_snapshot();
+  uint8_t rgb[16 + 1][3];
+  snapshot_palette(rgb);
+  video_capture.frame((const uint8_t *)screen_snapshot, rgb, 16 + 1);
+
+  if (video_capture.failed()) { /* 書き込みエラーか、サイズの上限 */
+    videoout_save_stop();
+    return false;
+  }
+  return true;
+}
@@ -18,13 +18,28 @@ const char *filename_get_snap_base();
 void screen_snapshot_init();
 void screen_snapshot_exit();
 
+/* ファイルの書き込みは別スレッドで行う。結果は以下で確認する */
 int screen_snapshot_save();
+int screen_snapshot_wait();
+int screen_snapshot_write_failed();
 
 void filename_init_wav(int synchronize);
 void filename_set_wav_base(const char *filename);
 const char *filename_get_wav_base();
 
+enum { WAVEOUT_FMT_WAV, WAVEOUT_FMT_FLAC };
+extern int waveout_format; /* サウンド出力フォーマット */
+
 int waveout_save_start();
 void waveout_save_stop();
 
+extern char *file_videoout; /* 起動時から記録する動画ファイル */
+
+/* 動画記録 (filename が nullptr なら、スナップショットと同じベース名 + NNNN.avi) */
+int videoout_save_start(const char *filename);
+void videoout_save_stop();
+int videoout_saving();
+/* 1フレーム毎に呼ぶ。書き込めなくなったら記録を止めて偽を返す */
+int videoout_save_frame();
+
 #endif /* SNAPSHOT_H_INCLUDED */
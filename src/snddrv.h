@@ -1,6 +1,8 @@
 #ifndef SNDDRV_H_INCLUDED
 #define SNDDRV_H_INCLUDED
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -93,6 +95,7 @@ void xmame_dev_sample_headdown(void);
 void xmame_dev_sample_headup(void);
 void xmame_dev_sample_seek(void);
 void xmame_dev_sound_timer_over(int timer);
+void xmame_dev_suppress(int suppress);
 
 int xmame_cfg_get_mastervolume(void);
 void xmame_cfg_set_mastervolume(int vol);
@@ -109,6 +112,7 @@ int xmame_wavout_open(const char *filename);
 int xmame_wavout_opened(void);
 void xmame_wavout_close(void);
 int xmame_wavout_damaged(void);
+int xmame_audio_capture(void (*callback)(const int16_t *data, int samples));
 
 const char *xmame_version_mame(void);
 const char *xmame_version_fmgen(void);
@@ -154,6 +158,7 @@ const char *xmame_version_fmgen(void);
 #define xmame_dev_sample_headup()
 #define xmame_dev_sample_seek()
 #define xmame_dev_sound_timer_over(t)
+#define xmame_dev_suppress(s)
 
 #define xmame_cfg_get_mastervolume() (0)
 #define xmame_cfg_set_mastervolume(v)
@@ -170,6 +175,7 @@ const char *xmame_version_fmgen(void);
 #define xmame_wavout_opened() (false)
 #define xmame_wavout_close()
 #define xmame_wavout_damaged() (false)
+#define xmame_audio_capture(c) (0)
 
 #define xmame_version_mame() ""
 #define xmame_version_fmgen() ""
@@ -2,6 +2,8 @@
 // QUASI88 - xmame - fmgen interface of YM2203(fmgen)
 //
 
+#include <cstdint>
+
 #include "pc88cpu.h"
 
 extern "C" {
@@ -18,7 +20,8 @@ extern "C" {
 struct fmgen2203_info {
   sound_stream *stream;
   FM::OPN *opn;
-  uint32 last_state;
+  uint32 rate;
+  uint32 count_frac;
   INT16 *buf;
   size_t buf_size;
   int control_port_w;
@@ -31,7 +34,7 @@ static void fmgen2203_stream_update(void *param, stream_sample_t **inputs, strea
   INT16 *p;
   stream_sample_t *bufL = buffer[0];
   stream_sample_t *bufR = buffer[1];
-  uint32 last_count;
+  uint64_t total_us;
 
   if (info->buf_size < length) {
     if (info->buf) {
@@ -47,13 +50,18 @@ static void fmgen2203_stream_update(void *param, stream_sample_t **inputs, strea
     }
   }
 
-  // test
-  // info->opn->Count( int(1/wait_freq_hz * 1000*1000) );
+  /* タイマは生成したサンプル数ぶん進める (端数は次回に持ち越し) */
+  total_us = (uint64_t)length * 1000000 + info->count_frac;
+  info->opn->Count((int32)(total_us / info->rate));
+  info->count_frac = (uint32)(total_us % info->rate);
 
-  last_count = (uint32)((state_of_cpu - info->last_state) / cpu_clock_mhz);
-  if (last_count > 0)
-    info->opn->Count(last_count);
-  info->last_state = 0;
+  /* 無音なら合成を省略 */
+  if (info->opn->IsSilent()) {
+    memset(bufL, 0, length * sizeof(stream_sample_t));
+    memset(bufR, 0, length * sizeof(stream_sample_t));
+    stream_mark_silent(info->stream);
+    return;
+  }
 
   if (info->buf) {
 
@@ -79,11 +87,17 @@ static void *fmgen2203_start(int sndindex, int clock, const void *config) {
   memset(info, 0, sizeof(*info));
 
   /* stream system initialize */
-  info->stream = stream_create(0, 2, Machine->sample_rate, info, fmgen2203_stream_update);
+  /* 高品質リサンプル時は、チップ本来のレートで合成して streams.c で変換する */
+  if (resample_quality > 0) {
+    info->rate = clock / 72;
+  } else {
+    info->rate = Machine->sample_rate ? Machine->sample_rate : 44100;
+  }
+  info->stream = stream_create(0, 2, info->rate, info, fmgen2203_stream_update);
 
   info->opn = new FM::OPN;
 
-  if (info->opn->Init(clock, Machine->sample_rate ? Machine->sample_rate : 44100)) {
+  if (info->opn->Init(clock, info->rate)) {
     return info;
   }
 
@@ -154,41 +168,36 @@ WRITE8_HANDLER(FMGEN2203_control_port_4_w) {
 
 WRITE8_HANDLER(FMGEN2203_write_port_0_w) {
   struct fmgen2203_info *info = (struct fmgen2203_info *)sndti_token(SOUND_FMGEN2203, 0);
-  uint32 total_state = (state_of_cpu + z80main_cpu.state0);
-  info->opn->Count(uint32((total_state - info->last_state) / cpu_clock_mhz));
-  info->last_state = total_state;
+  /* 書き込み時点までを旧レジスタ値で合成してから反映 */
+  stream_update(info->stream);
 
   info->opn->SetReg(info->control_port_w, data);
 }
 WRITE8_HANDLER(FMGEN2203_write_port_1_w) {
   struct fmgen2203_info *info = (struct fmgen2203_info *)sndti_token(SOUND_FMGEN2203, 1);
-  uint32 total_state = (state_of_cpu + z80main_cpu.state0);
-  info->opn->Count(uint32((total_state - info->last_state) / cpu_clock_mhz));
-  info->last_state = total_state;
+  /* 書き込み時点までを旧レジスタ値で合成してから反映 */
+  stream_update(info->stream);
 
   info->opn->SetReg(info->control_port_w, data);
 }
 WRITE8_HANDLER(FMGEN2203_write_port_2_w) {
   struct fmgen2203_info *info = (struct fmgen2203_info *)sndti_token(SOUND_FMGEN2203, 2);
-  uint32 total_state = (state_of_cpu + z80main_cpu.state0);
-  info->opn->Count(uint32((total_state - info->last_state) / cpu_clock_mhz));
-  info->last_state = total_state;
+  /* 書き込み時点までを旧レジスタ値で合成してから反映 */
+  stream_update(info->stream);
 
   info->opn->SetReg(info->control_port_w, data);
 }
 WRITE8_HANDLER(FMGEN2203_write_port_3_w) {
   struct fmgen2203_info *info = (struct fmgen2203_info *)sndti_token(SOUND_FMGEN2203, 3);
-  uint32 total_state = (state_of_cpu + z80main_cpu.state0);
-  info->opn->Count(uint32((total_state - info->last_state) / cpu_clock_mhz));
-  info->last_state = total_state;
+  /* 書き込み時点までを旧レジスタ値で合成してから反映 */
+  stream_update(info->stream);
 
   info->opn->SetReg(info->control_port_w, data);
 }
 WRITE8_HANDLER(FMGEN2203_write_port_4_w) {
   struct fmgen2203_info *info = (struct fmgen2203_info *)sndti_token(SOUND_FMGEN2203, 4);
-  uint32 total_state = (state_of_cpu + z80main_cpu.state0);
-  info->opn->Count(uint32((total_state - info->last_state) / cpu_clock_mhz));
-  info->last_state = total_state;
+  /* 書き込み時点までを旧レジスタ値で合成してから反映 */
+  stream_update(info->stream);
 
   info->opn->SetReg(info->control_port_w, data);
 }
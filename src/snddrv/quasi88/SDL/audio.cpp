@@ -97,6 +97,9 @@ static const T_CONFIG_TABLE xmame_options[] = {
     {365, "sdlbufnum", X_INV, &invalid_arg, 0, 0, nullptr, nullptr},
     {366, "close", X_FIX, &close_device, true, 0, nullptr, OPT_SAVE},
     {366, "noclose", X_FIX, &close_device, false, 0, nullptr, OPT_SAVE},
+    {367, "soundthread", X_FIX, &use_sound_thread, true, 0, nullptr, OPT_SAVE},
+    {367, "nosoundthread", X_FIX, &use_sound_thread, false, 0, nullptr, OPT_SAVE},
+    {368, "resample", X_INT, &resample_quality, 0, 3, nullptr, OPT_SAVE},
 
     /* 終端 */
     {0, nullptr, X_INV, nullptr, 0, 0, nullptr, nullptr},
@@ -132,7 +135,10 @@ void xmame_config_show_option(void) {
                   "    -samplefreq / -sf <i>   Set the playback sample-frequency/rate [44100]\n"
                   "    -[no]samples / -[no]sam Use/don't use samples (if available) [-nosamples]\n"
                   "    -sdlbufsize <i>         buffer size of sound stream (power of 2) [2048]\n"
-                  "    -[no]close              Close/no close sound device in MENU mode [-noclose]\n");
+                  "    -[no]close              Close/no close sound device in MENU mode [-noclose]\n"
+                  "    -[no]soundthread        Render sound in a worker thread (1 frame latency)\n"
+                  "                                                          [-nosoundthread]\n"
+                  "    -resample <i>           Resampler quality (0:linear, 1 - 3:FIR) [1]\n");
 }
 
 /******************************************************************************
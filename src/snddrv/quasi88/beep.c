@@ -18,6 +18,17 @@ typedef struct beep88_f {
   unsigned char port40; /* Output value of port 40 */
 } BEEP88;
 
+/* ---------- check if the output is off ----------- */
+int BEEP88IsSilent(void *chip) {
+  BEEP88 *BEEP = chip;
+
+  if (BEEP->port40 & 0x20)
+    return false;
+  if (BEEP->cmd_sing && (BEEP->port40 & 0x80))
+    return false;
+  return true;
+}
+
 /* ---------- update one of chip ----------- */
 void BEEP88UpdateOne(void *chip, stream_sample_t *buffer, int length) {
   BEEP88 *BEEP = chip;
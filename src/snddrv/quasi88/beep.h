@@ -11,6 +11,7 @@ void *BEEP88Init(void *param, int index, int clock, int sample_rate);
 void BEEP88Shutdown(void *chip);
 void BEEP88ResetChip(void *chip);
 void BEEP88UpdateOne(void *chip, stream_sample_t *buffer, int length);
+int BEEP88IsSilent(void *chip);
 
 void BEEP88Write(void *chip, int v);
 void BEEP88Control(void *chip, int v);
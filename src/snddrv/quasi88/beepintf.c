@@ -16,6 +16,12 @@ void BEEP88UpdateRequest(void *param) {
 
 static void beep88_stream_update(void *param, stream_sample_t **inputs, stream_sample_t **buffer, int length) {
   struct beep88_info *info = param;
+
+  if (BEEP88IsSilent(info->chip)) {
+    memset(buffer[0], 0, length * sizeof(stream_sample_t));
+    stream_mark_silent(info->stream);
+    return;
+  }
   BEEP88UpdateOne(info->chip, buffer[0], length);
 }
 
@@ -27,6 +33,7 @@ static void *beep88_start(int sndindex, int clock, const void *config) {
 
   /* stream system initialize */
   info->stream = stream_create(0, 1, Machine->sample_rate, info, beep88_stream_update);
+  stream_set_skip_muted(info->stream, TRUE);
 
   /* Initialize beep emurator */
   info->chip = BEEP88Init(info, sndindex, clock, Machine->sample_rate);
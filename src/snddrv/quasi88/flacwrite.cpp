@@ -0,0 +1,530 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "file-op.h"
+#include "flacwrite.h"
+
+namespace {
+
+constexpr int BLOCK_SIZE = 4096;
+constexpr int MAX_FIXED_ORDER = 4;
+constexpr int MAX_PARTITION_ORDER = 8;
+constexpr int MAX_RICE_PARAM = 14;
+
+/* offset of the STREAMINFO body: "fLaC" + metadata block header */
+constexpr long STREAMINFO_OFFSET = 8;
+constexpr int STREAMINFO_LENGTH = 34;
+
+enum { SUBFRAME_CONSTANT, SUBFRAME_VERBATIM, SUBFRAME_FIXED };
+
+/* channel assignment for stereo; independent channels are coded as channels - 1 */
+enum {
+  CHANNEL_LEFT_SIDE = 8,
+  CHANNEL_RIGHT_SIDE = 9,
+  CHANNEL_MID_SIDE = 10,
+};
+
+class BitWriter {
+public:
+  void put(uint32_t value, int bits) {
+    if (bits == 0) {
+      return;
+    }
+    acc_ = (acc_ << bits) | (value & ((uint64_t(1) << bits) - 1));
+    nbits_ += bits;
+    while (nbits_ >= 8) {
+      nbits_ -= 8;
+      buf_.push_back(uint8_t(acc_ >> nbits_));
+    }
+  }
+
+  void put_signed(int32_t value, int bits) { put(uint32_t(value), bits); }
+
+  void put_unary(uint32_t q) {
+    while (q >= 32) {
+      put(0, 32);
+      q -= 32;
+    }
+    put(1, q + 1);
+  }
+
+  void put_rice(uint32_t u, int k) {
+    put_unary(u >> k);
+    put(u, k);
+  }
+
+  void align() {
+    if (nbits_) {
+      put(0, 8 - nbits_);
+    }
+  }
+
+  size_t size() const { return buf_.size(); }
+  const std::vector<uint8_t> &bytes() const { return buf_; }
+  void clear() {
+    buf_.clear();
+    acc_ = 0;
+    nbits_ = 0;
+  }
+
+private:
+  std::vector<uint8_t> buf_;
+  uint64_t acc_ = 0;
+  int nbits_ = 0;
+};
+
+uint8_t crc8(const uint8_t *p, size_t len) {
+  uint8_t crc = 0;
+  while (len--) {
+    crc ^= *p++;
+    for (int i = 0; i < 8; i++) {
+      crc = (crc & 0x80) ? uint8_t((crc << 1) ^ 0x07) : uint8_t(crc << 1);
+    }
+  }
+  return crc;
+}
+
+uint16_t crc16(const uint8_t *p, size_t len) {
+  uint16_t crc = 0;
+  while (len--) {
+    crc ^= uint16_t(*p++) << 8;
+    for (int i = 0; i < 8; i++) {
+      crc = (crc & 0x8000) ? uint16_t((crc << 1) ^ 0x8005) : uint16_t(crc << 1);
+    }
+  }
+  return crc;
+}
+
+inline uint32_t zigzag(int32_t v) { return (uint32_t(v) << 1) ^ uint32_t(v >> 31); }
+
+/* How one channel of one frame is going to be coded */
+struct SubframePlan {
+  int type = SUBFRAME_VERBATIM;
+  int order = 0;
+  int partition_order = 0;
+  int params[1 << MAX_PARTITION_ORDER] = {};
+  uint64_t bits = 0;
+  std::vector<int32_t> residual;
+};
+
+void fixed_residual(const int32_t *x, int n, int order, int32_t *e) {
+  for (int i = order; i < n; i++) {
+    switch (order) {
+    case 0:
+      e[i] = x[i];
+      break;
+    case 1:
+      e[i] = x[i] - x[i - 1];
+      break;
+    case 2:
+      e[i] = x[i] - 2 * x[i - 1] + x[i - 2];
+      break;
+    case 3:
+      e[i] = x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3];
+      break;
+    default:
+      e[i] = x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4];
+      break;
+    }
+  }
+}
+
+int best_rice_param(uint64_t sum, uint32_t count, uint64_t *bits) {
+  int best = 0;
+  uint64_t best_bits = UINT64_MAX;
+  for (int k = 0; k <= MAX_RICE_PARAM; k++) {
+    uint64_t b = uint64_t(count) * (k + 1) + (sum >> k);
+    if (b < best_bits) {
+      best_bits = b;
+      best = k;
+    }
+  }
+  *bits = best_bits;
+  return best;
+}
+
+/* Choose partition order and Rice parameters; returns the residual size in bits */
+uint64_t plan_residual(SubframePlan &plan, int n) {
+  uint64_t sums[1 << MAX_PARTITION_ORDER];
+  uint64_t best_bits = UINT64_MAX;
+
+  int max_porder = 0;
+  while (max_porder < MAX_PARTITION_ORDER && (n % (2 << max_porder)) == 0 && (n >> (max_porder + 1)) > plan.order) {
+    max_porder++;
+  }
+
+  /* sums at the finest level, then merged pairwise for coarser orders */
+  int parts = 1 << max_porder;
+  int psize = n >> max_porder;
+  for (int p = 0; p < parts; p++) {
+    uint64_t s = 0;
+    for (int i = (p == 0) ? plan.order : p * psize; i < (p + 1) * psize; i++) {
+      s += zigzag(plan.residual[i]);
+    }
+    sums[p] = s;
+  }
+
+  for (int porder = max_porder; porder >= 0; porder--) {
+    int np = 1 << porder;
+    int ps = n >> porder;
+    int params[1 << MAX_PARTITION_ORDER];
+    uint64_t bits = 2 + 4;
+
+    for (int p = 0; p < np; p++) {
+      uint64_t b;
+      uint32_t count = (p == 0) ? ps - plan.order : ps;
+      params[p] = best_rice_param(sums[p], count, &b);
+      bits += 4 + b;
+    }
+    if (bits < best_bits) {
+      best_bits = bits;
+      plan.partition_order = porder;
+      for (int p = 0; p < np; p++) {
+        plan.params[p] = params[p];
+      }
+    }
+    for (int p = 0; p < np / 2; p++) {
+      sums[p] = sums[2 * p] + sums[2 * p + 1];
+    }
+  }
+  return best_bits;
+}
+
+void plan_subframe(const int32_t *x, int n, int bps, SubframePlan &plan) {
+  const uint64_t header = 8;
+
+  bool constant = true;
+  for (int i = 1; i < n && constant; i++) {
+    constant = (x[i] == x[0]);
+  }
+  if (constant) {
+    plan.type = SUBFRAME_CONSTANT;
+    plan.bits = header + bps;
+    return;
+  }
+
+  /* pick the fixed predictor with the smallest residual magnitude */
+  int max_order = (n > MAX_FIXED_ORDER) ? MAX_FIXED_ORDER : n - 1;
+  uint64_t best_sum = UINT64_MAX;
+  plan.residual.resize(n);
+  for (int order = 0; order <= max_order; order++) {
+    fixed_residual(x, n, order, plan.residual.data());
+    uint64_t s = 0;
+    for (int i = max_order; i < n; i++) {
+      s += zigzag(plan.residual[i]);
+    }
+    if (s < best_sum) {
+      best_sum = s;
+      plan.order = order;
+    }
+  }
+  fixed_residual(x, n, plan.order, plan.residual.data());
+
+  plan.type = SUBFRAME_FIXED;
+  plan.bits = header + uint64_t(plan.order) * bps + plan_residual(plan, n);
+
+  if (plan.bits >= header + uint64_t(n) * bps) {
+    plan.type = SUBFRAME_VERBATIM;
+    plan.bits = header + uint64_t(n) * bps;
+  }
+}
+
+void write_subframe(BitWriter &bw, const int32_t *x, int n, int bps, const SubframePlan &plan) {
+  switch (plan.type) {
+  case SUBFRAME_CONSTANT:
+    bw.put(0x00 << 1, 8);
+    bw.put_signed(x[0], bps);
+    break;
+
+  case SUBFRAME_VERBATIM:
+    bw.put(0x01 << 1, 8);
+    for (int i = 0; i < n; i++) {
+      bw.put_signed(x[i], bps);
+    }
+    break;
+
+  case SUBFRAME_FIXED: {
+    bw.put((0x08 | plan.order) << 1, 8);
+    for (int i = 0; i < plan.order; i++) {
+      bw.put_signed(x[i], bps);
+    }
+
+    bw.put(0, 2); /* Rice coding, 4-bit parameters */
+    bw.put(plan.partition_order, 4);
+    int np = 1 << plan.partition_order;
+    int ps = n >> plan.partition_order;
+    for (int p = 0; p < np; p++) {
+      int k = plan.params[p];
+      bw.put(k, 4);
+      for (int i = (p == 0) ? plan.order : p * ps; i < (p + 1) * ps; i++) {
+        bw.put_rice(zigzag(plan.residual[i]), k);
+      }
+    }
+    break;
+  }
+  }
+}
+
+void put_utf8(BitWriter &bw, uint32_t v) {
+  if (v < 0x80) {
+    bw.put(v, 8);
+    return;
+  }
+  int extra = (v < 0x800) ? 1 : (v < 0x10000) ? 2 : (v < 0x200000) ? 3 : (v < 0x4000000) ? 4 : 5;
+  bw.put((0xff00 >> (extra + 1)) | (v >> (6 * extra)), 8);
+  while (extra--) {
+    bw.put(0x80 | ((v >> (6 * extra)) & 0x3f), 8);
+  }
+}
+
+} // namespace
+
+struct _flac_file {
+  OSD_FILE *fp;
+  int sample_rate;
+  int channels;
+
+  /* emulation thread -> encoder */
+  std::mutex lock;
+  std::condition_variable cv;
+  std::deque<std::vector<int16_t>> queue;
+  bool quit;
+  std::thread worker;
+
+  /* encoder state, owned by the worker */
+  std::vector<int16_t> pending;
+  size_t pending_pos;
+  uint64_t total_frames;
+  uint32_t frame_number;
+  uint32_t min_frame_size;
+  uint32_t max_frame_size;
+  BitWriter bw;
+  std::vector<int32_t> chan[4];
+  SubframePlan plan[4];
+};
+
+namespace {
+
+void write_streaminfo(flac_file *flac) {
+  BitWriter bw;
+
+  bw.put(BLOCK_SIZE, 16);
+  bw.put(BLOCK_SIZE, 16);
+  bw.put(flac->min_frame_size, 24);
+  bw.put(flac->max_frame_size, 24);
+  bw.put(flac->sample_rate, 20);
+  bw.put(flac->channels - 1, 3);
+  bw.put(16 - 1, 5);
+  bw.put(uint32_t(flac->total_frames >> 32), 4);
+  bw.put(uint32_t(flac->total_frames), 32);
+  for (int i = 0; i < 16; i++) {
+    bw.put(0, 8); /* MD5 unknown */
+  }
+  osd_fwrite(bw.bytes().data(), 1, bw.size(), flac->fp);
+}
+
+void encode_frame(flac_file *flac, const int16_t *pcm, int n) {
+  const int nch = flac->channels;
+  BitWriter &bw = flac->bw;
+  int assignment = nch - 1;
+  int use[2] = {0, 1};
+  int bps[4] = {16, 16, 16, 17};
+
+  for (int c = 0; c < nch; c++) {
+    flac->chan[c].resize(n);
+    for (int i = 0; i < n; i++) {
+      flac->chan[c][i] = pcm[i * nch + c];
+    }
+    plan_subframe(flac->chan[c].data(), n, 16, flac->plan[c]);
+  }
+
+  if (nch == 2) {
+    /* chan[2] = mid, chan[3] = side */
+    flac->chan[2].resize(n);
+    flac->chan[3].resize(n);
+    for (int i = 0; i < n; i++) {
+      int32_t l = flac->chan[0][i];
+      int32_t r = flac->chan[1][i];
+      flac->chan[2][i] = (l + r) >> 1;
+      flac->chan[3][i] = l - r;
+    }
+    plan_subframe(flac->chan[2].data(), n, 16, flac->plan[2]);
+    plan_subframe(flac->chan[3].data(), n, 17, flac->plan[3]);
+
+    uint64_t cost_lr = flac->plan[0].bits + flac->plan[1].bits;
+    uint64_t cost_ls = flac->plan[0].bits + flac->plan[3].bits;
+    uint64_t cost_rs = flac->plan[3].bits + flac->plan[1].bits;
+    uint64_t cost_ms = flac->plan[2].bits + flac->plan[3].bits;
+    uint64_t best = cost_lr;
+
+    if (cost_ls < best) {
+      best = cost_ls;
+      assignment = CHANNEL_LEFT_SIDE;
+      use[0] = 0;
+      use[1] = 3;
+    }
+    if (cost_rs < best) {
+      best = cost_rs;
+      assignment = CHANNEL_RIGHT_SIDE;
+      use[0] = 3;
+      use[1] = 1;
+    }
+    if (cost_ms < best) {
+      assignment = CHANNEL_MID_SIDE;
+      use[0] = 2;
+      use[1] = 3;
+    }
+  }
+
+  /* frame header */
+  bw.clear();
+  bw.put(0xfff8, 16);                                   /* sync, fixed blocksize */
+  bw.put(0x7, 4);                                       /* blocksize: 16 bits at end of header */
+  bw.put(0x0, 4);                                       /* sample rate: from STREAMINFO */
+  bw.put(assignment, 4);
+  bw.put(0x4, 3);                                       /* 16 bits per sample */
+  bw.put(0, 1);
+  put_utf8(bw, flac->frame_number++);
+  bw.put(n - 1, 16);
+  bw.put(crc8(bw.bytes().data(), bw.size()), 8);
+
+  for (int c = 0; c < nch; c++) {
+    int s = (nch == 2) ? use[c] : c;
+    write_subframe(bw, flac->chan[s].data(), n, bps[s], flac->plan[s]);
+  }
+
+  bw.align();
+  bw.put(crc16(bw.bytes().data(), bw.size()), 16);
+
+  uint32_t size = uint32_t(bw.size());
+  if (flac->min_frame_size == 0 || size < flac->min_frame_size) {
+    flac->min_frame_size = size;
+  }
+  if (size > flac->max_frame_size) {
+    flac->max_frame_size = size;
+  }
+  flac->total_frames += n;
+
+  osd_fwrite(bw.bytes().data(), 1, bw.size(), flac->fp);
+}
+
+/* Encode every complete block in pending; with flush, the tail as well */
+void encode_pending(flac_file *flac, bool flush) {
+  const size_t block = size_t(BLOCK_SIZE) * flac->channels;
+
+  while (flac->pending.size() - flac->pending_pos >= block) {
+    encode_frame(flac, &flac->pending[flac->pending_pos], BLOCK_SIZE);
+    flac->pending_pos += block;
+  }
+  if (flush && flac->pending.size() > flac->pending_pos) {
+    int n = int((flac->pending.size() - flac->pending_pos) / flac->channels);
+    if (n > 0) {
+      encode_frame(flac, &flac->pending[flac->pending_pos], n);
+    }
+    flac->pending_pos = flac->pending.size();
+  }
+
+  flac->pending.erase(flac->pending.begin(), flac->pending.begin() + flac->pending_pos);
+  flac->pending_pos = 0;
+}
+
+void worker_main(flac_file *flac) {
+  for (;;) {
+    std::deque<std::vector<int16_t>> work;
+    bool quit;
+    {
+      std::unique_lock<std::mutex> lk(flac->lock);
+      flac->cv.wait(lk, [flac] { return flac->quit || !flac->queue.empty(); });
+      work.swap(flac->queue);
+      quit = flac->quit;
+    }
+
+    for (auto &b : work) {
+      flac->pending.insert(flac->pending.end(), b.begin(), b.end());
+    }
+    encode_pending(flac, quit);
+
+    if (quit) {
+      return;
+    }
+  }
+}
+
+} // namespace
+
+flac_file *flac_open(const char *filename, int sample_rate, int channels) {
+  if (channels < 1 || channels > 2) {
+    return nullptr;
+  }
+
+  OSD_FILE *fp = osd_fopen(FTYPE_WRITE, filename, "wb");
+  if (fp == nullptr) {
+    return nullptr;
+  }
+
+  flac_file *flac = new flac_file();
+  flac->fp = fp;
+  flac->sample_rate = sample_rate;
+  flac->channels = channels;
+  flac->quit = false;
+  flac->pending_pos = 0;
+  flac->total_frames = 0;
+  flac->frame_number = 0;
+  flac->min_frame_size = 0;
+  flac->max_frame_size = 0;
+
+  /* marker and the (only) metadata block; STREAMINFO is rewritten on close */
+  static const uint8_t marker[8] = {'f', 'L', 'a', 'C', 0x80, 0, 0, STREAMINFO_LENGTH};
+  osd_fwrite(marker, 1, sizeof(marker), fp);
+  write_streaminfo(flac);
+
+  try {
+    flac->worker = std::thread(worker_main, flac);
+  } catch (const std::system_error &) {
+    osd_fclose(fp);
+    delete flac;
+    return nullptr;
+  }
+  return flac;
+}
+
+void flac_close(flac_file *flac) {
+  if (flac == nullptr) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lk(flac->lock);
+    flac->quit = true;
+  }
+  flac->cv.notify_one();
+  flac->worker.join();
+
+  osd_fseek(flac->fp, STREAMINFO_OFFSET, SEEK_SET);
+  write_streaminfo(flac);
+  osd_fclose(flac->fp);
+
+  delete flac;
+}
+
+void flac_add_data_16(flac_file *flac, const int16_t *data, int samples) {
+  if (flac == nullptr || samples <= 0) {
+    return;
+  }
+
+  std::vector<int16_t> block(data, data + samples);
+  {
+    std::lock_guard<std::mutex> lk(flac->lock);
+    flac->queue.push_back(std::move(block));
+  }
+  flac->cv.notify_one();
+}
@@ -0,0 +1,28 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#pragma once
+
+/*
+ * Lossless sound recording in FLAC format.
+ *
+ * Same interface as wavwrite.h. PCM blocks are only copied on the calling
+ * thread; encoding (fixed predictors + Rice coding) and file writes are done
+ * on a background thread, so a slow disk never stalls the emulation.
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct _flac_file flac_file;
+
+flac_file *flac_open(const char *filename, int sample_rate, int channels);
+void flac_close(flac_file *flac);
+
+/* samples is the number of values in data (frames x channels) */
+void flac_add_data_16(flac_file *flac, const int16_t *data, int samples);
+
+#ifdef __cplusplus
+}
+#endif
@@ -12,6 +12,7 @@
 
 #include "beepintf.h"
 #include "samples.h"
+#include "sound-thread.h"
 
 #ifdef USE_FMGEN
 #include "2203fmgen.h"
@@ -32,6 +33,8 @@ int samplevol = 50;            /* level of SAMPLE(0-100)[%] */
 int use_fmgen = false;         /* 1:use fmgen / 0:not use */
 int has_samples = false;       /* 1:use samples / 0:not use */
 int quasi88_is_paused = false; /* for mame_is_paused() */
+int use_sound_thread = false;  /* 1:use sound thread / 0:not use */
+int resample_quality = 1;      /* quality of resampler (0-3) */
 
 typedef struct {               /* list of mame-sound-I/F functions */
 
@@ -66,6 +69,28 @@ static T_XMAME_FUNC xmame_func_nosound = {
 
 static T_XMAME_FUNC *xmame_func = &xmame_func_nosound;
 
+/* サウンドスレッドに渡すコマンド (0 は SNDTHREAD_FRAME) */
+enum {
+  XMAME_CMD_FRAME = SNDTHREAD_FRAME,
+  XMAME_CMD_SOUND_IN_DATA,
+  XMAME_CMD_SOUND_IN_STATUS,
+  XMAME_CMD_SOUND_OUT_REG,
+  XMAME_CMD_SOUND_OUT_DATA,
+  XMAME_CMD_SOUND2_IN_STATUS,
+  XMAME_CMD_SOUND2_OUT_REG,
+  XMAME_CMD_SOUND2_OUT_DATA,
+  XMAME_CMD_BEEP_OUT_DATA,
+  XMAME_CMD_BEEP_OUT_CTRL,
+  XMAME_CMD_SAMPLE_MOTORON,
+  XMAME_CMD_SAMPLE_MOTOROFF,
+  XMAME_CMD_SAMPLE_HEADDOWN,
+  XMAME_CMD_SAMPLE_HEADUP,
+  XMAME_CMD_SAMPLE_SEEK,
+  XMAME_CMD_TIMER_OVER,
+};
+
+static void xmame_exec_command(int cmd, int data);
+
 /****************************************************************
  * 起動時／終了時に呼ぶ
  ****************************************************************/
@@ -651,6 +676,13 @@ int xmame_sound_start(void) {
 
     sound_reset();
 
+    if (use_sound_thread) {
+      if (sound_thread_start(xmame_exec_command) == false) {
+        if (verbose_proc)
+          printf("(sound thread not available)\n");
+      }
+    }
+
     return 1;
 
   } else {
@@ -667,8 +699,13 @@ int xmame_sound_start(void) {
 
 void xmame_sound_update(void) {
   if (use_sound) {
-    /* ↓ 内部で osd_update_audio_stream() が呼び出される */
-    sound_frame_update();
+    if (sound_thread_running()) {
+      /* サウンドスレッドが1フレーム遅れで処理する */
+      sound_thread_frame();
+    } else {
+      /* ↓ 内部で osd_update_audio_stream() が呼び出される */
+      sound_frame_update();
+    }
   }
 }
 
@@ -680,6 +717,8 @@ void xmame_update_video_and_audio(void) {
 
 void xmame_sound_stop(void) {
   if (use_sound) {
+    sound_thread_stop();
+
     /* ↓ 内部で osd_stop_audio_stream() が呼び出される */
     sound_exit();
 
@@ -689,6 +728,8 @@ void xmame_sound_stop(void) {
 
 void xmame_sound_suspend(void) {
   if (use_sound) {
+    sound_thread_sync();
+
     if (close_device) {
       sound_pause(1);
     }
@@ -703,6 +744,8 @@ void xmame_sound_suspend(void) {
 }
 void xmame_sound_resume(void) {
   if (use_sound) {
+    sound_thread_sync();
+
     if (close_device) {
       sound_pause(0);
     }
@@ -712,33 +755,132 @@ void xmame_sound_resume(void) {
 }
 void xmame_sound_reset(void) {
   if (use_sound) {
+    sound_thread_sync();
     sound_reset();
   }
 }
 
 /****************************************************************
  * サウンドポート入出力毎に呼ぶ
+ *      サウンドスレッド使用時は、コマンドをキューに積むだけ。
+ *      (読み出し値は QUASI88 側では使っていないので、固定値を返す)
  ****************************************************************/
+static void xmame_exec_command(int cmd, int data) {
+  switch (cmd) {
+  case XMAME_CMD_FRAME:
+    /* ↓ 内部で osd_update_audio_stream() が呼び出される */
+    sound_frame_update();
+    break;
+
+  case XMAME_CMD_SOUND_IN_DATA:
+    if (xmame_func->sound_in_data)
+      (xmame_func->sound_in_data)(0);
+    break;
+  case XMAME_CMD_SOUND_IN_STATUS:
+    if (xmame_func->sound_in_status)
+      (xmame_func->sound_in_status)(0);
+    break;
+  case XMAME_CMD_SOUND_OUT_REG:
+    if (xmame_func->sound_out_reg)
+      (xmame_func->sound_out_reg)(0, (UINT8)data);
+    break;
+  case XMAME_CMD_SOUND_OUT_DATA:
+    if (xmame_func->sound_out_data)
+      (xmame_func->sound_out_data)(0, (UINT8)data);
+    break;
+
+  case XMAME_CMD_SOUND2_IN_STATUS:
+    if (xmame_func->sound2_in_status)
+      (xmame_func->sound2_in_status)(0);
+    break;
+  case XMAME_CMD_SOUND2_OUT_REG:
+    if (xmame_func->sound2_out_reg)
+      (xmame_func->sound2_out_reg)(0, (UINT8)data);
+    break;
+  case XMAME_CMD_SOUND2_OUT_DATA:
+    if (xmame_func->sound2_out_data)
+      (xmame_func->sound2_out_data)(0, (UINT8)data);
+    break;
+
+  case XMAME_CMD_BEEP_OUT_DATA:
+    if (xmame_func->beep_out_data)
+      (xmame_func->beep_out_data)(0, (UINT8)data);
+    break;
+  case XMAME_CMD_BEEP_OUT_CTRL:
+    if (xmame_func->beep_out_ctrl)
+      (xmame_func->beep_out_ctrl)(0, (UINT8)data);
+    break;
+
+  case XMAME_CMD_SAMPLE_MOTORON:
+    if (xmame_func->sample_motoron)
+      (xmame_func->sample_motoron)();
+    break;
+  case XMAME_CMD_SAMPLE_MOTOROFF:
+    if (xmame_func->sample_motoroff)
+      (xmame_func->sample_motoroff)();
+    break;
+  case XMAME_CMD_SAMPLE_HEADDOWN:
+    if (xmame_func->sample_headdown)
+      (xmame_func->sample_headdown)();
+    break;
+  case XMAME_CMD_SAMPLE_HEADUP:
+    if (xmame_func->sample_headup)
+      (xmame_func->sample_headup)();
+    break;
+  case XMAME_CMD_SAMPLE_SEEK:
+    if (xmame_func->sample_seek)
+      (xmame_func->sample_seek)();
+    break;
+
+  case XMAME_CMD_TIMER_OVER:
+    if (xmame_func->sound_timer_over)
+      (xmame_func->sound_timer_over)(data);
+    break;
+  }
+}
+
+/* 真の間は、デバイスへの入出力を捨てる (先行実行の隠しフレーム用) */
+static int dev_suppressed = false;
+
+static void xmame_dev_command(int cmd, int data) {
+  if (dev_suppressed) {
+    return;
+  }
+  if (sound_thread_running()) {
+    sound_thread_push(cmd, data);
+  } else {
+    xmame_exec_command(cmd, data);
+  }
+}
+
 uint8_t xmame_dev_sound_in_data(void) {
+  if (dev_suppressed) {
+    return 0xff;
+  }
+  if (sound_thread_running()) {
+    sound_thread_push(XMAME_CMD_SOUND_IN_DATA, 0);
+    return 0xff;
+  }
   if (xmame_func->sound_in_data)
     return (xmame_func->sound_in_data)(0);
   else
     return 0xff;
 }
 uint8_t xmame_dev_sound_in_status(void) {
+  if (dev_suppressed) {
+    return 0;
+  }
+  if (sound_thread_running()) {
+    sound_thread_push(XMAME_CMD_SOUND_IN_STATUS, 0);
+    return 0;
+  }
   if (xmame_func->sound_in_status)
     return (xmame_func->sound_in_status)(0);
   else
     return 0;
 }
-void xmame_dev_sound_out_reg(uint8_t data) {
-  if (xmame_func->sound_out_reg)
-    (xmame_func->sound_out_reg)(0, data);
-}
-void xmame_dev_sound_out_data(uint8_t data) {
-  if (xmame_func->sound_out_data)
-    (xmame_func->sound_out_data)(0, data);
-}
+void xmame_dev_sound_out_reg(uint8_t data) { xmame_dev_command(XMAME_CMD_SOUND_OUT_REG, data); }
+void xmame_dev_sound_out_data(uint8_t data) { xmame_dev_command(XMAME_CMD_SOUND_OUT_DATA, data); }
 
 uint8_t xmame_dev_sound2_in_data(void) {
   if (use_sound) {
@@ -751,58 +893,43 @@ uint8_t xmame_dev_sound2_in_data(void) {
   }
 }
 uint8_t xmame_dev_sound2_in_status(void) {
+  if (dev_suppressed) {
+    return 0xff;
+  }
+  if (sound_thread_running()) {
+    sound_thread_push(XMAME_CMD_SOUND2_IN_STATUS, 0);
+    return 0xff;
+  }
   if (xmame_func->sound2_in_status)
     return (xmame_func->sound2_in_status)(0);
   else
     return 0xff;
 }
-void xmame_dev_sound2_out_reg(uint8_t data) {
-  if (xmame_func->sound2_out_reg)
-    (xmame_func->sound2_out_reg)(0, data);
-}
-void xmame_dev_sound2_out_data(uint8_t data) {
-  if (xmame_func->sound2_out_data)
-    (xmame_func->sound2_out_data)(0, data);
-}
+void xmame_dev_sound2_out_reg(uint8_t data) { xmame_dev_command(XMAME_CMD_SOUND2_OUT_REG, data); }
+void xmame_dev_sound2_out_data(uint8_t data) { xmame_dev_command(XMAME_CMD_SOUND2_OUT_DATA, data); }
 
-void xmame_dev_beep_out_data(uint8_t data) {
-  if (xmame_func->beep_out_data)
-    (xmame_func->beep_out_data)(0, data);
-}
-void xmame_dev_beep_cmd_sing(uint8_t flag) {
-  if (xmame_func->beep_out_ctrl)
-    (xmame_func->beep_out_ctrl)(0, flag);
-}
+void xmame_dev_beep_out_data(uint8_t data) { xmame_dev_command(XMAME_CMD_BEEP_OUT_DATA, data); }
+void xmame_dev_beep_cmd_sing(uint8_t flag) { xmame_dev_command(XMAME_CMD_BEEP_OUT_CTRL, flag); }
 
-void xmame_dev_sample_motoron(void) {
-  if (xmame_func->sample_motoron)
-    (xmame_func->sample_motoron)();
-}
-void xmame_dev_sample_motoroff(void) {
-  if (xmame_func->sample_motoroff)
-    (xmame_func->sample_motoroff)();
-}
-void xmame_dev_sample_headdown(void) {
-  if (xmame_func->sample_headdown)
-    (xmame_func->sample_headdown)();
-}
-void xmame_dev_sample_headup(void) {
-  if (xmame_func->sample_headup)
-    (xmame_func->sample_headup)();
-}
-void xmame_dev_sample_seek(void) {
-  if (xmame_func->sample_seek)
-    (xmame_func->sample_seek)();
-}
+void xmame_dev_sample_motoron(void) { xmame_dev_command(XMAME_CMD_SAMPLE_MOTORON, 0); }
+void xmame_dev_sample_motoroff(void) { xmame_dev_command(XMAME_CMD_SAMPLE_MOTOROFF, 0); }
+void xmame_dev_sample_headdown(void) { xmame_dev_command(XMAME_CMD_SAMPLE_HEADDOWN, 0); }
+void xmame_dev_sample_headup(void) { xmame_dev_command(XMAME_CMD_SAMPLE_HEADUP, 0); }
+void xmame_dev_sample_seek(void) { xmame_dev_command(XMAME_CMD_SAMPLE_SEEK, 0); }
 
 /****************************************************************
  * サウンドのタイマーオーバーフロー時に呼ぶ
  *      timer = 0 TimerAOver / 1 TimerBOver
  ****************************************************************/
-void xmame_dev_sound_timer_over(int timer) {
-  if (xmame_func->sound_timer_over)
-    (xmame_func->sound_timer_over)(timer);
-}
+void xmame_dev_sound_timer_over(int timer) { xmame_dev_command(XMAME_CMD_TIMER_OVER, timer); }
+
+/****************************************************************
+ * サウンドデバイスへの入出力を止める／再開する
+ *      先行実行の隠しフレームでは、レジスタ書き込みも音に反映しない。
+ *      ステートを戻せば QUASI88 側のレジスタ値は元通りになるので、
+ *      デバイス側は本番のフレームの書き込みだけを受け取ればよい。
+ ****************************************************************/
+void xmame_dev_suppress(int suppress) { dev_suppressed = suppress; }
 
 /****************************************************************
  * サウンド機能有無を取得
@@ -849,6 +976,8 @@ void xmame_cfg_set_mastervolume(int vol) {
  ****************************************************************/
 void xmame_cfg_set_mixer_volume(int ch, int level) {
   if (use_sound) {
+    sound_thread_sync();
+
     switch (ch) {
     case XMAME_MIXER_PSG:
       if (level < PSGVOL_MIN)
@@ -1033,6 +1162,7 @@ int xmame_cfg_set_use_samples(int enable) {
  ****************************************************************/
 int xmame_wavout_open(const char *filename) {
   if (use_sound) {
+    sound_thread_sync();
     return sound_wavfile_open(filename);
   } else {
     return false;
@@ -1040,6 +1170,7 @@ int xmame_wavout_open(const char *filename) {
 }
 int xmame_wavout_opened(void) {
   if (use_sound) {
+    sound_thread_sync();
     return sound_wavfile_opened();
   } else {
     return false;
@@ -1047,17 +1178,31 @@ int xmame_wavout_opened(void) {
 }
 void xmame_wavout_close(void) {
   if (use_sound) {
+    sound_thread_sync();
     sound_wavfile_close();
   }
 }
 int xmame_wavout_damaged(void) {
   if (use_sound) {
+    sound_thread_sync();
     return sound_wavfile_damaged();
   } else {
     return false;
   }
 }
 
+/****************************************************************
+ * 動画記録用のサウンド出力 (戻り値はサンプリングレート、0 ならサウンドなし)
+ ****************************************************************/
+int xmame_audio_capture(void (*callback)(const int16_t *data, int samples)) {
+  if (use_sound) {
+    sound_thread_sync();
+    return sound_capture_set(callback);
+  } else {
+    return 0;
+  }
+}
+
 /****************************************************************
  * MAMEバージョン取得関数
  ****************************************************************/
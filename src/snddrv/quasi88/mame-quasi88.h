@@ -328,6 +328,14 @@ extern int samplevol;         /* level of SAMPLE (0-100)[%] */
 extern int use_fmgen;         /* 1:use fmgen / 0:not use */
 extern int has_samples;       /* 1:use samples / 0:not use */
 extern int quasi88_is_paused; /* for mame_is_paused() */
+extern int use_sound_thread;  /* 1:use sound thread / 0:not use */
+extern int resample_quality;  /* quality of resampler (0-3) */
+
+/* サウンドチップが参照する CPU ステート (sound-thread.cpp)
+   サウンドスレッドでは、コマンド発行時点の値を返す */
+int xmame_state_of_cpu(void); /* state_of_cpu       */
+int xmame_cpu_state0(void);   /* z80main_cpu.state0 */
+int xmame_boost_cnt(void);    /* boost_cnt          */
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,167 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "mame-quasi88.h"
+#include "sound-thread.h"
+
+namespace {
+
+/* CPU state counters as seen by the emulation thread at access time */
+struct T_SNDTHREAD_CLOCK {
+  int state_of_cpu;
+  int state0;
+  int boost_cnt;
+};
+
+struct T_SNDTHREAD_CMD {
+  int cmd;
+  int data;
+  T_SNDTHREAD_CLOCK clock;
+};
+
+/* Must hold a full frame of ADPCM transfers in -nowait mode without stalling */
+constexpr uint32_t QUEUE_SIZE = 0x10000;
+constexpr uint32_t QUEUE_MASK = QUEUE_SIZE - 1;
+
+T_SNDTHREAD_CMD queue[QUEUE_SIZE];
+std::atomic<uint32_t> queue_head{0}; /* written by emulation thread */
+std::atomic<uint32_t> queue_tail{0}; /* advanced by worker after execution */
+std::atomic<int> frames_queued{0};
+
+std::mutex worker_lock;
+std::condition_variable wake_cv; /* emulation thread -> worker */
+std::condition_variable done_cv; /* worker -> emulation thread */
+bool worker_quit = false;
+std::thread worker;
+sound_thread_exec_t worker_exec = nullptr;
+
+/* Clock of the command being replayed, set only on the worker thread */
+thread_local const T_SNDTHREAD_CLOCK *replay_clock = nullptr;
+
+bool queue_empty() { return queue_tail.load(std::memory_order_acquire) == queue_head.load(std::memory_order_acquire); }
+
+void worker_main() {
+  for (;;) {
+    uint32_t tail = queue_tail.load(std::memory_order_relaxed);
+
+    if (tail == queue_head.load(std::memory_order_acquire)) {
+      std::unique_lock<std::mutex> lk(worker_lock);
+      done_cv.notify_all();
+      wake_cv.wait(lk, [] { return worker_quit || !queue_empty(); });
+      if (worker_quit && queue_empty()) {
+        return;
+      }
+      continue;
+    }
+
+    const T_SNDTHREAD_CMD *cmd = &queue[tail & QUEUE_MASK];
+    replay_clock = &cmd->clock;
+    (worker_exec)(cmd->cmd, cmd->data);
+    replay_clock = nullptr;
+
+    bool frame = (cmd->cmd == SNDTHREAD_FRAME);
+    queue_tail.store(tail + 1, std::memory_order_release);
+
+    if (frame) {
+      std::lock_guard<std::mutex> lk(worker_lock);
+      frames_queued--;
+      done_cv.notify_all();
+    }
+  }
+}
+
+void wake_worker() {
+  std::lock_guard<std::mutex> lk(worker_lock);
+  wake_cv.notify_one();
+}
+
+} // namespace
+
+int sound_thread_start(sound_thread_exec_t exec) {
+  if (worker.joinable()) {
+    return true;
+  }
+
+  worker_exec = exec;
+  worker_quit = false;
+  queue_head = 0;
+  queue_tail = 0;
+  frames_queued = 0;
+
+  try {
+    worker = std::thread(worker_main);
+  } catch (const std::system_error &) {
+    worker_exec = nullptr;
+    return false;
+  }
+  return true;
+}
+
+void sound_thread_stop(void) {
+  if (!worker.joinable()) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lk(worker_lock);
+    worker_quit = true;
+    wake_cv.notify_one();
+  }
+  worker.join();
+  worker_exec = nullptr;
+}
+
+int sound_thread_running(void) { return worker_exec != nullptr; }
+
+void sound_thread_sync(void) {
+  if (!sound_thread_running()) {
+    return;
+  }
+
+  std::unique_lock<std::mutex> lk(worker_lock);
+  wake_cv.notify_one();
+  done_cv.wait(lk, [] { return queue_empty(); });
+}
+
+void sound_thread_push(int cmd, int data) {
+  uint32_t head = queue_head.load(std::memory_order_relaxed);
+
+  /* Queue is full: let the worker catch up */
+  while (head - queue_tail.load(std::memory_order_acquire) >= QUEUE_SIZE) {
+    wake_worker();
+    std::this_thread::yield();
+  }
+
+  T_SNDTHREAD_CMD *p = &queue[head & QUEUE_MASK];
+  p->cmd = cmd;
+  p->data = data;
+  p->clock.state_of_cpu = state_of_cpu;
+  p->clock.state0 = z80main_cpu.state0;
+  p->clock.boost_cnt = boost_cnt;
+
+  queue_head.store(head + 1, std::memory_order_release);
+}
+
+void sound_thread_frame(void) {
+  frames_queued++;
+  sound_thread_push(SNDTHREAD_FRAME, 0);
+
+  std::unique_lock<std::mutex> lk(worker_lock);
+  wake_cv.notify_one();
+
+  /* Previous frame must be finished before the emulation goes on */
+  done_cv.wait(lk, [] { return frames_queued <= 1; });
+}
+
+/*
+ * Accessors for the CPU state counters used by the sound chips. On the worker
+ * they return the values recorded with the command being replayed.
+ */
+int xmame_state_of_cpu(void) { return replay_clock ? replay_clock->state_of_cpu : state_of_cpu; }
+int xmame_cpu_state0(void) { return replay_clock ? replay_clock->state0 : z80main_cpu.state0; }
+int xmame_boost_cnt(void) { return replay_clock ? replay_clock->boost_cnt : boost_cnt; }
@@ -0,0 +1,31 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#pragma once
+
+/*
+ * Worker thread for sound chip synthesis and mixing.
+ *
+ * The emulation thread only records chip accesses (register writes, timer
+ * overflows, frame ends) into a single-producer/single-consumer queue. Every
+ * entry carries the CPU state counters at the moment of the access, so the
+ * worker replays it with exactly the same timing as the synchronous path.
+ * The worker runs at most one frame behind the emulation thread.
+ */
+
+/* Reserved command: end of the current frame */
+#define SNDTHREAD_FRAME (0)
+
+/* Callback executed on the worker for every queued command */
+typedef void (*sound_thread_exec_t)(int cmd, int data);
+
+int sound_thread_start(sound_thread_exec_t exec);
+void sound_thread_stop(void);
+int sound_thread_running(void);
+
+/* Wait until the worker has executed all queued commands */
+void sound_thread_sync(void);
+
+/* Queue a chip access with the current CPU state */
+void sound_thread_push(int cmd, int data);
+
+/* Queue the end of frame; blocks if the worker is more than a frame behind */
+void sound_thread_frame(void);
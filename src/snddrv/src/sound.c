@@ -19,10 +19,12 @@
 #include "streams.h"
 #include "config.h"
 #include "profiler.h"
+#include <ctype.h>
 #if 0       /* QUASI88 (for MrC, SC) */
 #include "sound/wavwrite.h"
 #else       /* QUASI88 */
 #include "wavwrite.h"
+#include "flacwrite.h"
 #endif      /* QUASI88 */
 
 
@@ -115,6 +117,10 @@ static int global_sound_enabled;
 static int nosound_mode;
 
 static wav_file *wavfile;
+#if 1       /* QUASI88 */
+static flac_file *flacfile;
+static void (*capture_callback)(const INT16 *data, int samples);
+#endif      /* QUASI88 */
 
 
 
@@ -761,6 +767,12 @@ void sound_frame_update(void)
 
     if (wavfile && !mame_is_paused(Machine))
         wav_add_data_16(wavfile, finalmix, samples_this_frame * 2);
+#if 1       /* QUASI88 */
+    if (flacfile && !mame_is_paused(Machine))
+        flac_add_data_16(flacfile, finalmix, samples_this_frame * 2);
+    if (capture_callback && !mame_is_paused(Machine))
+        (*capture_callback)(finalmix, samples_this_frame);
+#endif      /* QUASI88 */
 
     /* play the result */
     samples_this_frame = osd_update_audio_stream(finalmix);
@@ -787,6 +799,7 @@ static void mixer_update(void *param, stream_sample_t **inputs, stream_sample_t
 
     VPRINTF(("Mixer_update(%d)\n", length));
 
+#if 0       /* QUASI88 */
     /* loop over samples */
     for (pos = 0; pos < length; pos++)
     {
@@ -798,6 +811,31 @@ static void mixer_update(void *param, stream_sample_t **inputs, stream_sample_t
             sample += inputs[inp][pos];
         buffer[0][pos] = sample;
     }
+#else       /* QUASI88 */
+    {
+        stream_sample_t *dest = buffer[0];
+        int inp, mixed = 0;
+
+        /* add up all the inputs, skipping silent ones */
+        for (inp = 0; inp < numinputs; inp++)
+        {
+            if (stream_input_is_silent(speaker_in->mixer_stream, inp))
+                continue;
+
+            if (mixed++ == 0)
+                memcpy(dest, inputs[inp], length * sizeof(*dest));
+            else
+                for (pos = 0; pos < length; pos++)
+                    dest[pos] += inputs[inp][pos];
+        }
+
+        if (mixed == 0)
+        {
+            memset(dest, 0, length * sizeof(*dest));
+            stream_mark_silent(speaker_in->mixer_stream);
+        }
+    }
+#endif      /* QUASI88 */
 }
 
 
@@ -834,7 +872,7 @@ int sound_scalebufferpos(int value)
 #if 0   /* ~ ver 0.6.2 */
     int result = (int)((double)(state_of_cpu + get_z80main_cpu_state0()/state_of_vsync * value);
 #else   /* ver 0.6.3 ~ */
-    int result = (int)((double)(state_of_cpu + get_z80main_cpu_state0() + (boost_cnt * state_of_vsync) )
+    int result = (int)((double)(xmame_state_of_cpu() + xmame_cpu_state0() + (xmame_boost_cnt() * state_of_vsync) )
                                     / (boost * state_of_vsync) * value);
 #endif
     return (result < value) ? result : value;
@@ -972,6 +1010,23 @@ const char *sound_get_user_gain_name(int index)
 #if 1       /* QUASI88 */
 static  int wavfile_sample_rate;
 
+/* a filename ending with .flac is recorded in FLAC, otherwise in WAV */
+static int is_flac_filename(const char *filename)
+{
+    static const char suffix[] = ".flac";
+    size_t len = strlen(filename);
+    int i;
+
+    if (len < sizeof(suffix) - 1)
+        return false;
+
+    filename += len - (sizeof(suffix) - 1);
+    for (i = 0; suffix[i]; i++)
+        if (tolower((unsigned char)filename[i]) != suffix[i])
+            return false;
+    return true;
+}
+
 int sound_wavfile_open(const char *filename)
 {
     /* to avoid conflicts */
@@ -979,17 +1034,19 @@ int sound_wavfile_open(const char *filename)
         return false;
 
     /* close if already opened */
-    if (wavfile)
-        wav_close(wavfile);
+    sound_wavfile_close();
 
     /* open and start recording */
-    wavfile = wav_open(filename, Machine->sample_rate, 2);
+    if (is_flac_filename(filename))
+        flacfile = flac_open(filename, Machine->sample_rate, 2);
+    else
+        wavfile = wav_open(filename, Machine->sample_rate, 2);
 
-    if (wavfile) wavfile_sample_rate = Machine->sample_rate;
-    else         wavfile_sample_rate = 0;
+    if (wavfile || flacfile) wavfile_sample_rate = Machine->sample_rate;
+    else                     wavfile_sample_rate = 0;
 
-    if (wavfile) return true;
-    else         return false;
+    if (wavfile || flacfile) return true;
+    else                     return false;
 }
 
 int sound_wavfile_opened(void)
@@ -997,8 +1054,8 @@ int sound_wavfile_opened(void)
     if (MAKE_WAVS)
         return false;
 
-    if (wavfile) return true;
-    else         return false;
+    if (wavfile || flacfile) return true;
+    else                     return false;
 }
 
 void sound_wavfile_close(void)
@@ -1008,8 +1065,11 @@ void sound_wavfile_close(void)
 
     if (wavfile)
         wav_close(wavfile);
+    if (flacfile)
+        flac_close(flacfile);
 
     wavfile = NULL;
+    flacfile = NULL;
 
     wavfile_sample_rate = 0;
 }
@@ -1019,10 +1079,17 @@ int sound_wavfile_damaged(void)
     if (MAKE_WAVS)
         return false;
 
-    if (wavfile == NULL)
+    if (wavfile == NULL && flacfile == NULL)
         return false;
 
     if (wavfile_sample_rate == Machine->sample_rate) return false;
     else                                             return true;
 }
+
+/* the final mix (stereo) is also passed to callback, for video capture */
+int sound_capture_set(void (*callback)(const INT16 *data, int samples))
+{
+    capture_callback = callback;
+    return Machine->sample_rate;
+}
 #endif
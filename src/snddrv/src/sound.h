@@ -79,6 +79,7 @@ int sound_wavfile_open(const char *filename);
 int sound_wavfile_opened(void);
 void sound_wavfile_close(void);
 int sound_wavfile_damaged(void);
+int sound_capture_set(void (*callback)(const INT16 *data, int samples));
 #endif      /* QUASI88 */
 void sound_frame_update(void);
 int sound_scalebufferpos(int value);
@@ -512,7 +512,14 @@ static void sample_update_sound(void *param, stream_sample_t **inputs, stream_sa
         chan->frac = frac;
     }
     else
+#if 0       /* QUASI88 */
+        memset(buffer, 0, length * sizeof(*buffer));
+#else       /* QUASI88 */
+    {
         memset(buffer, 0, length * sizeof(*buffer));
+        stream_mark_silent(chan->stream);
+    }
+#endif      /* QUASI88 */
 }
 
 
@@ -579,6 +586,9 @@ static void *samples_start(int sndindex, int clock, const void *config)
     for (i = 0; i < info->numchannels; i++)
     {
         info->channel[i].stream = stream_create(0, 1, Machine->sample_rate, &info->channel[i], sample_update_sound);
+#if 1       /* QUASI88 */
+        stream_set_skip_muted(info->channel[i].stream, TRUE);
+#endif      /* QUASI88 */
 
         info->channel[i].source = NULL;
         info->channel[i].source_num = -1;
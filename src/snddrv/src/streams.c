@@ -34,12 +34,40 @@
 #define FRAC_ONE                        (1 << FRAC_BITS)
 #define FRAC_MASK                       (FRAC_ONE - 1)
 
+#if 1       /* QUASI88 */
+/* polyphase FIR resampler: the filter for an input needs at most
+   RESAMPLE_MAX_TAPS source samples before the current position, which
+   must fit in the OUTPUT_KEEP_SAMPLES history kept on toss */
+#define RESAMPLE_PHASE_BITS             8
+#define RESAMPLE_PHASES                 (1 << RESAMPLE_PHASE_BITS)
+#define RESAMPLE_COEF_BITS              14
+#define RESAMPLE_MAX_TAPS               128
+
+#ifndef M_PI
+#define M_PI                            3.14159265358979323846
+#endif
+
+/* silent_from value of a buffer whose tail is not known to be silent */
+#define SILENT_NONE                     0xffffffff
+#endif      /* QUASI88 */
+
 
 
 /***************************************************************************
     TYPE DEFINITIONS
 ***************************************************************************/
 
+#if 1       /* QUASI88 */
+struct resample_filter
+{
+    struct resample_filter *next;               /* next filter in the cache */
+    UINT32          step_frac;                  /* source stepping rate this filter is made for */
+    int             taps;                       /* number of source samples per output sample */
+    INT32 *         coef;                       /* coefficients, RESAMPLE_PHASES x taps */
+};
+#endif      /* QUASI88 */
+
+
 struct stream_input
 {
     sound_stream *stream;                       /* pointer to the input stream */
@@ -50,6 +78,11 @@ struct stream_input
     UINT32          resample_in_pos;            /* resample index where next sample will be written */
     UINT32          resample_out_pos;           /* resample index where next sample will be read */
     INT16           gain;                       /* gain to apply to this input */
+#if 1       /* QUASI88 */
+    struct resample_filter *filter;             /* FIR filter for the current step_frac */
+    UINT32          silent_from;                /* resample index from which all samples are zero */
+    UINT8           silent;                     /* input is silent for the current callback */
+#endif      /* QUASI88 */
 };
 
 
@@ -60,6 +93,9 @@ struct stream_output
     UINT32          cur_out_pos;                /* sample index where next sample will be read */
     int             dependents;                 /* number of dependents */
     INT16           gain;                       /* gain to apply to the output */
+#if 1       /* QUASI88 */
+    UINT32          silent_from;                /* sample index from which all samples are zero */
+#endif      /* QUASI88 */
 };
 
 
@@ -88,6 +124,12 @@ struct _sound_stream
     /* callback information */
     void *          param;
     stream_callback callback;                   /* callback function */
+
+#if 1       /* QUASI88 */
+    /* silence information */
+    UINT8           skip_muted;                 /* don't call the callback while all outputs are muted */
+    UINT8           marked_silent;              /* callback reported a silent block */
+#endif      /* QUASI88 */
 };
 
 
@@ -99,6 +141,12 @@ struct _sound_stream
 static sound_stream *stream_head;
 static void *stream_current_tag;
 static int stream_index;
+#if 1       /* QUASI88 */
+static struct resample_filter *resample_filter_head;
+
+/* filter length (in output-rate samples) for each resample_quality */
+static const int resample_taps[] = { 0, 8, 16, 32 };
+#endif      /* QUASI88 */
 
 
 
@@ -107,7 +155,13 @@ static int stream_index;
 ***************************************************************************/
 
 static void stream_generate_samples(sound_stream *stream, int samples);
+#if 1       /* QUASI88 */
+static int stream_is_muted(sound_stream *stream);
+#endif      /* QUASI88 */
 static void resample_input_stream(struct stream_input *input, int samples);
+#if 1       /* QUASI88 */
+static void resample_input_stream_fir(struct stream_input *input, int samples, INT16 gain);
+#endif      /* QUASI88 */
 
 
 
@@ -127,6 +181,9 @@ int streams_init(void)
     stream_head = NULL;
     stream_current_tag = NULL;
     stream_index = 0;
+#if 1       /* QUASI88 */
+    resample_filter_head = NULL;    /* tables are auto_malloc'ed */
+#endif      /* QUASI88 */
 
     return 0;
 }
@@ -181,6 +238,10 @@ void streams_frame_update(void)
                     memmove(&input->resample[0], &input->resample[samples_to_remove], RESAMPLE_KEEP_SAMPLES * sizeof(*input->resample));
                 input->resample_in_pos -= samples_to_remove;
                 input->resample_out_pos -= samples_to_remove;
+#if 1       /* QUASI88 */
+                if (input->silent_from != SILENT_NONE)
+                    input->silent_from = (input->silent_from > samples_to_remove) ? input->silent_from - samples_to_remove : 0;
+#endif      /* QUASI88 */
             }
         }
 
@@ -206,6 +267,10 @@ void streams_frame_update(void)
                     output->cur_out_pos -= samples_to_remove;
                 else
                     output->cur_out_pos = 0;
+#if 1       /* QUASI88 */
+                if (output->silent_from != SILENT_NONE)
+                    output->silent_from = (output->silent_from > samples_to_remove) ? output->silent_from - samples_to_remove : 0;
+#endif      /* QUASI88 */
             }
 
             /* now scan for any dependent inputs and fix up their source pointer */
@@ -327,6 +392,9 @@ sound_stream *stream_create(int inputs, int outputs, int sample_rate, void *para
     {
         stream->input[inputnum].resample = auto_malloc(RESAMPLE_BUFFER_SAMPLES * sizeof(*stream->input[inputnum].resample));
         stream->input[inputnum].gain = 0x100;
+#if 1       /* QUASI88 */
+        stream->input[inputnum].silent_from = SILENT_NONE;
+#endif      /* QUASI88 */
         state_save_register_item(statetag, inputnum, stream->input[inputnum].gain);
     }
 
@@ -335,6 +403,9 @@ sound_stream *stream_create(int inputs, int outputs, int sample_rate, void *para
     {
         stream->output[outputnum].buffer = auto_malloc(OUTPUT_BUFFER_SAMPLES * sizeof(*stream->output[outputnum].buffer));
         stream->output[outputnum].gain = 0x100;
+#if 1       /* QUASI88 */
+        stream->output[outputnum].silent_from = SILENT_NONE;
+#endif      /* QUASI88 */
         state_save_register_item(statetag, outputnum, stream->output[outputnum].gain);
     }
 
@@ -539,6 +610,48 @@ stream_sample_t *stream_consume_output(sound_stream *stream, int outputnum, int
 
 
 
+#if 1       /* QUASI88 */
+/*************************************
+ *
+ *  Silence handling
+ *
+ *************************************/
+
+/* called from a stream callback: the samples just generated are all zero */
+void stream_mark_silent(sound_stream *stream)
+{
+    stream->marked_silent = TRUE;
+}
+
+
+/* called from a stream callback: the given input is all zero this time */
+int stream_input_is_silent(sound_stream *stream, int input)
+{
+    return stream->input[input].silent;
+}
+
+
+/* don't render the stream while all its outputs have zero gain;
+   only for sources whose state is not visible to the emulated CPU */
+void stream_set_skip_muted(sound_stream *stream, int skip)
+{
+    stream->skip_muted = skip;
+}
+
+
+static int stream_is_muted(sound_stream *stream)
+{
+    int outputnum;
+
+    for (outputnum = 0; outputnum < stream->outputs; outputnum++)
+        if (stream->output[outputnum].gain != 0)
+            return FALSE;
+    return TRUE;
+}
+#endif      /* QUASI88 */
+
+
+
 /*************************************
  *
  *  Generate the requested number of
@@ -601,6 +714,9 @@ static void stream_generate_samples(sound_stream *stream, int samples)
 
         /* set the input pointer */
         stream->input_array[inputnum] = &input->resample[input->resample_out_pos];
+#if 1       /* QUASI88 */
+        input->silent = (input->resample_out_pos >= input->silent_from);
+#endif      /* QUASI88 */
         input->resample_out_pos += samples;
     }
 
@@ -621,7 +737,34 @@ static void stream_generate_samples(sound_stream *stream, int samples)
         logerror("samples > sample rate?! %d %d\n", samples, stream->sample_rate);
         samples = stream->sample_rate;
     }
+#if 0       /* QUASI88 */
     (*stream->callback)(stream->param, stream->input_array, stream->output_array, samples);
+#else       /* QUASI88 */
+    stream->marked_silent = FALSE;
+    if (stream->skip_muted && stream_is_muted(stream))
+    {
+        /* nothing of this stream can be heard: don't render it at all */
+        for (outputnum = 0; outputnum < stream->outputs; outputnum++)
+            memset(stream->output_array[outputnum], 0, samples * sizeof(stream_sample_t));
+        stream->marked_silent = TRUE;
+    }
+    else
+        (*stream->callback)(stream->param, stream->input_array, stream->output_array, samples);
+
+    /* keep track of where the silent tail of each output starts */
+    for (outputnum = 0; outputnum < stream->outputs; outputnum++)
+    {
+        struct stream_output *output = &stream->output[outputnum];
+
+        if (stream->marked_silent || output->gain == 0)
+        {
+            if (output->silent_from == SILENT_NONE)
+                output->silent_from = output->cur_in_pos - samples;
+        }
+        else
+            output->silent_from = SILENT_NONE;
+    }
+#endif      /* QUASI88 */
     VPRINTF(("  callback done\n"));
 }
 
@@ -646,6 +789,32 @@ static void resample_input_stream(struct stream_input *input, int samples)
 
     VPRINTF(("    resample_input_stream -- step = %d\n", step));
 
+#if 1       /* QUASI88 */
+    /* the whole source window (including filter history) is silent, or
+       the gain is zero: the result is all zero */
+    {
+        UINT32 silent_from = input->source->silent_from;
+        INT32 first = (INT32)(pos >> FRAC_BITS) - ((step != FRAC_ONE && resample_quality > 0) ? RESAMPLE_MAX_TAPS : 0);
+
+        if (gain == 0 || (silent_from != SILENT_NONE && (first < 0 ? silent_from == 0 : (UINT32)first >= silent_from)))
+        {
+            memset(dest, 0, samples * sizeof(*dest));
+            if (input->silent_from == SILENT_NONE)
+                input->silent_from = input->resample_in_pos;
+            input->resample_in_pos += samples;
+            input->source_frac = pos + step * samples;
+            return;
+        }
+        input->silent_from = SILENT_NONE;
+    }
+
+    if (step != FRAC_ONE && resample_quality > 0)
+    {
+        resample_input_stream_fir(input, samples, gain);
+        return;
+    }
+#endif      /* QUASI88 */
+
     /* perfectly matching */
     if (step == FRAC_ONE)
     {
@@ -705,3 +874,140 @@ static void resample_input_stream(struct stream_input *input, int samples)
     input->resample_in_pos = dest - input->resample;
     input->source_frac = pos;
 }
+
+
+
+#if 1       /* QUASI88 */
+/*************************************
+ *
+ *  Build (or find in the cache) a
+ *  windowed-sinc polyphase filter
+ *  for the given step
+ *
+ *************************************/
+
+static struct resample_filter *resample_get_filter(UINT32 step)
+{
+    struct resample_filter *filter;
+    int quality = resample_quality;
+    int taps, phase, tap;
+    double cutoff;
+
+    if (quality >= (int)(sizeof(resample_taps) / sizeof(resample_taps[0])))
+        quality = sizeof(resample_taps) / sizeof(resample_taps[0]) - 1;
+
+    /* when decimating, the kernel has to cover more source samples */
+    taps = resample_taps[quality];
+    if (step > FRAC_ONE)
+        taps = (int)(((UINT32)taps * step + FRAC_ONE - 1) >> FRAC_BITS);
+    taps = (taps + 3) & ~3;
+    if (taps > RESAMPLE_MAX_TAPS)
+        taps = RESAMPLE_MAX_TAPS;
+
+    for (filter = resample_filter_head; filter != NULL; filter = filter->next)
+        if (filter->step_frac == step && filter->taps == taps)
+            return filter;
+
+    filter = auto_malloc(sizeof(*filter));
+    filter->coef = auto_malloc(RESAMPLE_PHASES * taps * sizeof(*filter->coef));
+    filter->step_frac = step;
+    filter->taps = taps;
+
+    /* cut off at the lower of the two Nyquist frequencies, with some margin */
+    cutoff = 0.9;
+    if (step > FRAC_ONE)
+        cutoff = cutoff * FRAC_ONE / step;
+
+    for (phase = 0; phase < RESAMPLE_PHASES; phase++)
+    {
+        INT32 *coef = &filter->coef[phase * taps];
+        double frac = (double)phase / RESAMPLE_PHASES;
+        double h[RESAMPLE_MAX_TAPS];
+        double sum = 0;
+        INT32 isum = 0;
+
+        for (tap = 0; tap < taps; tap++)
+        {
+            /* distance from the interpolated point, in source samples */
+            double t = (tap - taps / 2 + 1) - frac;
+            double x = t / (taps / 2);
+            double w = 0.42 + 0.5 * cos(M_PI * x) + 0.08 * cos(2 * M_PI * x);   /* Blackman */
+            double a = M_PI * cutoff * t;
+
+            h[tap] = w * ((a == 0) ? 1.0 : sin(a) / a);
+            sum += h[tap];
+        }
+
+        /* normalize to unity DC gain; put the rounding error on the centre tap */
+        for (tap = 0; tap < taps; tap++)
+        {
+            coef[tap] = (INT32)floor(h[tap] / sum * (1 << RESAMPLE_COEF_BITS) + 0.5);
+            isum += coef[tap];
+        }
+        coef[taps / 2 - 1] += (1 << RESAMPLE_COEF_BITS) - isum;
+    }
+
+    filter->next = resample_filter_head;
+    resample_filter_head = filter;
+
+    VPRINTF(("    resample_get_filter -- step = %d, taps = %d\n", step, taps));
+    return filter;
+}
+
+
+
+/*************************************
+ *
+ *  Resample an input stream with the
+ *  polyphase filter
+ *
+ *  The filter only looks at source
+ *  samples up to the current position,
+ *  i.e. the output is delayed by
+ *  taps/2 source samples.
+ *
+ *************************************/
+
+static void resample_input_stream_fir(struct stream_input *input, int samples, INT16 gain)
+{
+    stream_sample_t *dest = input->resample + input->resample_in_pos;
+    stream_sample_t *source = input->source->buffer;
+    UINT32 pos = input->source_frac;
+    UINT32 step = input->step_frac;
+    struct resample_filter *filter = input->filter;
+    int taps, tap;
+
+    if (filter == NULL || filter->step_frac != step)
+        filter = input->filter = resample_get_filter(step);
+    taps = filter->taps;
+
+    while (samples--)
+    {
+        INT32 base = (INT32)(pos >> FRAC_BITS) - taps + 1;
+        const INT32 *coef = &filter->coef[((pos & FRAC_MASK) >> (FRAC_BITS - RESAMPLE_PHASE_BITS)) * taps];
+        INT32 sample = 0;
+
+        if (base >= 0)
+        {
+            /* plain multiply-accumulate; the compiler vectorizes this */
+            const stream_sample_t *src = &source[base];
+            for (tap = 0; tap < taps; tap++)
+                sample += src[tap] * coef[tap];
+        }
+        else
+        {
+            /* no history yet at the start of the stream */
+            for (tap = -base; tap < taps; tap++)
+                sample += source[base + tap] * coef[tap];
+        }
+        sample >>= RESAMPLE_COEF_BITS;
+
+        *dest++ = (sample * gain) >> 8;
+        pos += step;
+    }
+
+    /* update the input parameters */
+    input->resample_in_pos = dest - input->resample;
+    input->source_frac = pos;
+}
+#endif      /* QUASI88 */
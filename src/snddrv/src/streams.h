@@ -47,4 +47,11 @@ void stream_set_input_gain(sound_stream *stream, int input, float gain);
 void stream_set_output_gain(sound_stream *stream, int output, float gain);
 void stream_set_sample_rate(sound_stream *stream, int sample_rate);
 
+#if 1       /* QUASI88 */
+/* silence handling */
+void stream_mark_silent(sound_stream *stream);
+int stream_input_is_silent(sound_stream *stream, int input);
+void stream_set_skip_muted(sound_stream *stream, int skip);
+#endif      /* QUASI88 */
+
 #endif
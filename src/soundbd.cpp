@@ -10,6 +10,7 @@
 
 #include "Core/Log.h"
 
+#include "hash64.h"
 #include "initval.h"
 #include "intr.h"
 #include "pc88main.h"
@@ -635,6 +636,15 @@ int stateload_sound(void) {
   return true;
 }
 
+uint64_t statehash_sound() {
+  uint64_t h = statehash_table(suspend_sound_work, 0);
+  h = statehash_table(suspend_sound_work2, h);
+  if (sound_board == SOUND_II) {
+    h = hash64(sound2_adpcm, 0x40000, h); /* ADPCM 用 DRAM */
+  }
+  return h;
+}
+
 #ifdef USE_SOUND
 
 void sound_output_after_stateload(void) {
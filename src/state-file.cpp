@@ -0,0 +1,296 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#include "state-file.h"
+
+#include "Core/Log.h"
+#include "archive.h"
+#include "lodepng.h"
+
+#if defined(QUASI88_FUNIX)
+#include <unistd.h>
+#elif defined(QUASI88_FWIN)
+#include <io.h>
+#endif
+
+namespace {
+
+/*
+ * File format:
+ *
+ *   Header       32 bytes, as in memory, with TAG at offset 24
+ *   Block        ID           4 bytes
+ *                Size         4 bytes, of the contents
+ *                Stored size  4 bytes. Equal to Size if stored raw, else deflated
+ *                CRC-32       4 bytes, of the contents
+ *                Data         Stored size bytes
+ *     :
+ *   End          16 bytes of zero, except the CRC-32 of the header
+ *
+ * All integers are little endian. The header of the state (suspend.cpp) only
+ * uses the first 16 bytes, so the tag doesn't disturb it.
+ */
+constexpr size_t HEADER_SIZE = 32;
+constexpr size_t TAG_OFFSET = 24;
+constexpr char TAG[4] = {'Z', 'C', 'R', 'C'};
+constexpr size_t RECORD_SIZE = 16;
+
+void put32(uint8_t *p, uint32_t v) {
+  p[0] = v & 0xff;
+  p[1] = (v >> 8) & 0xff;
+  p[2] = (v >> 16) & 0xff;
+  p[3] = (v >> 24) & 0xff;
+}
+
+uint32_t get32(const uint8_t *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+
+bool is_end(const uint8_t *id) { return memcmp(id, "\0\0\0\0", 4) == 0; }
+
+/* Get the written contents onto the disk, before the file is renamed over the old one */
+bool sync_file(FILE *fp) {
+  if (fflush(fp) != 0) {
+    return false;
+  }
+#if defined(QUASI88_FUNIX)
+  return fsync(fileno(fp)) == 0;
+#elif defined(QUASI88_FWIN)
+  return _commit(_fileno(fp)) == 0;
+#else
+  return true;
+#endif
+}
+
+} // namespace
+
+bool state_file_pack(const std::vector<uint8_t> &state, std::vector<uint8_t> &file) {
+  if (state.size() < HEADER_SIZE) {
+    return false;
+  }
+  file.assign(state.begin(), state.begin() + HEADER_SIZE);
+  memcpy(&file[TAG_OFFSET], TAG, sizeof(TAG));
+
+  size_t pos = HEADER_SIZE;
+  for (;;) {
+    if (state.size() - pos < 8) {
+      return false;
+    }
+    const uint8_t *id = &state[pos];
+    uint32_t size = get32(&state[pos + 4]);
+    pos += 8;
+    if (is_end(id)) {
+      break;
+    }
+    if (size > state.size() - pos) {
+      return false;
+    }
+    const uint8_t *data = &state[pos];
+    pos += size;
+
+    unsigned char *z = nullptr;
+    size_t z_size = 0;
+    bool deflated = (size > 0 && lodepng_deflate(&z, &z_size, data, size, &lodepng_default_compress_settings) == 0 &&
+                     z_size < size);
+
+    uint8_t record[RECORD_SIZE];
+    memcpy(record, id, 4);
+    put32(&record[4], size);
+    put32(&record[8], deflated ? (uint32_t)z_size : size);
+    put32(&record[12], archive_crc32(data, size));
+    file.insert(file.end(), record, record + RECORD_SIZE);
+    if (deflated) {
+      file.insert(file.end(), z, z + z_size);
+    } else {
+      file.insert(file.end(), data, data + size);
+    }
+    free(z);
+  }
+
+  uint8_t end[RECORD_SIZE] = {};
+  put32(&end[12], archive_crc32(file.data(), HEADER_SIZE));
+  file.insert(file.end(), end, end + RECORD_SIZE);
+  return true;
+}
+
+bool state_file_unpack(std::vector<uint8_t> &file, std::vector<uint8_t> &state) {
+  if (file.size() < HEADER_SIZE || memcmp(&file[TAG_OFFSET], TAG, sizeof(TAG)) != 0) {
+    state.swap(file); /* Older format: the file is the state */
+    return true;
+  }
+  state.assign(file.begin(), file.begin() + HEADER_SIZE);
+  memset(&state[TAG_OFFSET], 0, sizeof(TAG));
+
+  size_t pos = HEADER_SIZE;
+  for (;;) {
+    if (file.size() - pos < RECORD_SIZE) {
+      return false; /* Cut short */
+    }
+    const uint8_t *record = &file[pos];
+    uint32_t size = get32(&record[4]);
+    uint32_t stored = get32(&record[8]);
+    uint32_t crc = get32(&record[12]);
+    pos += RECORD_SIZE;
+
+    if (is_end(record)) {
+      if (crc != archive_crc32(file.data(), HEADER_SIZE)) {
+        return false;
+      }
+      state.insert(state.end(), record, record + 8);
+      return true;
+    }
+    if (stored > size || stored > file.size() - pos) {
+      return false;
+    }
+
+    state.insert(state.end(), record, record + 8);
+    size_t at = state.size();
+    if (stored == size) {
+      state.insert(state.end(), &file[pos], &file[pos] + size);
+    } else {
+      unsigned char *buf = nullptr;
+      size_t buf_size = 0;
+      bool ok = (lodepng_inflate(&buf, &buf_size, &file[pos], stored, &lodepng_default_decompress_settings) == 0 &&
+                 buf_size == size);
+      if (ok) {
+        state.insert(state.end(), buf, buf + buf_size);
+      }
+      free(buf);
+      if (!ok) {
+        return false;
+      }
+    }
+    if (archive_crc32(&state[at], size) != crc) {
+      return false;
+    }
+    pos += stored;
+  }
+}
+
+StateFileWriter::~StateFileWriter() {
+  if (worker.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stop = true;
+    }
+    cv_work.notify_one();
+    worker.join(); /* Everything queued is still written */
+  }
+}
+
+void StateFileWriter::write(const char *path, std::vector<uint8_t> &state) {
+  std::unique_lock<std::mutex> lock(mutex);
+
+  if (!started) {
+    started = true;
+    try {
+      worker = std::thread(&StateFileWriter::run, this);
+    } catch (const std::system_error &) {
+      QLOG_WARN("proc", "Can't start state file thread, writing synchronously");
+    }
+  }
+
+  if (!worker.joinable()) {
+    Job job{path, std::move(state)};
+    done(job.path, store(job));
+    state.swap(job.state);
+    state.clear();
+    return;
+  }
+
+  auto same = std::find_if(queue.begin(), queue.end(), [&](const Job &job) { return job.path == path; });
+  if (same != queue.end()) {
+    same->state.swap(state); /* Not started yet. Write the newer one only */
+    state.clear();
+  } else {
+    queue.push_back({path, std::move(state)});
+    state.clear();
+    if (!spare.empty()) {
+      state.swap(spare.back());
+      spare.pop_back();
+    }
+  }
+  lock.unlock();
+  cv_work.notify_one();
+}
+
+void StateFileWriter::wait() {
+  std::unique_lock<std::mutex> lock(mutex);
+  cv_idle.wait(lock, [&] { return queue.empty() && !busy; });
+}
+
+bool StateFileWriter::take_failure(std::string &path) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!failed) {
+    return false;
+  }
+  failed = false;
+  path = failed_path;
+  return true;
+}
+
+/* Called with the mutex held */
+void StateFileWriter::done(const std::string &path, bool ok) {
+  if (!ok) {
+    failed = true;
+    failed_path = path;
+  } else if (failed && failed_path == path) {
+    failed = false; /* The file was written after all; the failure is stale */
+  }
+}
+
+void StateFileWriter::run() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    cv_work.wait(lock, [&] { return stop || !queue.empty(); });
+    if (queue.empty()) {
+      break; /* stop, and everything is written */
+    }
+    Job job = std::move(queue.front());
+    queue.pop_front();
+    busy = true;
+    lock.unlock();
+
+    bool ok = store(job);
+
+    lock.lock();
+    done(job.path, ok);
+    job.state.clear();
+    spare.push_back(std::move(job.state));
+    busy = false;
+    if (queue.empty()) {
+      cv_idle.notify_all();
+    }
+  }
+}
+
+/* Write to "<path>.tmp", then replace the file with it */
+bool StateFileWriter::store(const Job &job) {
+  if (!state_file_pack(job.state, packed)) {
+    return false;
+  }
+
+  std::string tmp = job.path + ".tmp";
+  FILE *fp = fopen(tmp.c_str(), "wb");
+  if (fp == nullptr) {
+    return false;
+  }
+  bool ok = (fwrite(packed.data(), 1, packed.size(), fp) == packed.size() && sync_file(fp));
+  if (fclose(fp) != 0) {
+    ok = false;
+  }
+
+  std::error_code ec;
+  if (ok) {
+    std::filesystem::rename(tmp, job.path, ec);
+    ok = !ec;
+  }
+  if (!ok) {
+    std::filesystem::remove(tmp, ec);
+  }
+  return ok;
+}
@@ -0,0 +1,84 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#pragma once
+
+/*
+ * State files on disk.
+ *
+ * A state is serialized in memory first (statesave_buffer()). In the file,
+ * each block of it is deflated and carries the CRC-32 of its contents, so a
+ * file that is cut short or damaged is found before anything is loaded.
+ *
+ * Files are written by a background thread: the state is packed, written to
+ * "<file>.tmp", synced and renamed over the old file when complete. A crash in the
+ * middle of a save leaves the previous file as it was, and saving costs the
+ * emulation only the serialization.
+ *
+ * Files in the older, uncompressed format are still read.
+ */
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Pack a state (as made by statesave_buffer()) into the file format */
+bool state_file_pack(const std::vector<uint8_t> &state, std::vector<uint8_t> &file);
+
+/*
+ * Unpack a file into a state for stateload_buffer(). A file in the older
+ * format is taken over as is. False if the file is damaged.
+ */
+bool state_file_unpack(std::vector<uint8_t> &file, std::vector<uint8_t> &state);
+
+class StateFileWriter {
+public:
+  StateFileWriter() = default;
+  ~StateFileWriter();
+
+  StateFileWriter(const StateFileWriter &) = delete;
+  StateFileWriter &operator=(const StateFileWriter &) = delete;
+
+  /*
+   * Queue the state to be written to path. The contents are taken over, and
+   * state gets an unused buffer back. A write to the same path that has not
+   * started yet is replaced.
+   */
+  void write(const char *path, std::vector<uint8_t> &state);
+
+  /* Wait until everything queued is written */
+  void wait();
+
+  /*
+   * True once after a write failed, unless the same file has been written
+   * since. Its file name is set to path
+   */
+  bool take_failure(std::string &path);
+
+private:
+  struct Job {
+    std::string path;
+    std::vector<uint8_t> state;
+  };
+
+  void run();
+  bool store(const Job &job);
+  void done(const std::string &path, bool ok);
+
+  std::thread worker;
+  std::mutex mutex;
+  std::condition_variable cv_work; /* Something queued, or stop */
+  std::condition_variable cv_idle; /* The worker has nothing to do */
+  std::deque<Job> queue;
+  std::vector<std::vector<uint8_t>> spare;
+  bool busy = false;
+  bool stop = false;
+  bool started = false;
+  bool failed = false;
+  std::string failed_path;
+
+  std::vector<uint8_t> packed; /* Used by the worker */
+};
@@ -9,13 +9,17 @@
 #include <cmath>    // for double_t on Windows
 #include <cstring>
 #include <cctype>
+#include <vector>
 
 #include "quasi88.h"
 
 #include "Core/Log.h"
 
+#include "archive.h"
 #include "byteswap.h"
 #include "file-op.h"
+#include "hash64.h"
+#include "state-file.h"
 #include "suspend.h"
 #include "utility.h"
 
@@ -59,6 +63,54 @@ char file_state[QUASI88_MAX_FILENAME]; /* ステートファイル名   */
 
 #define SZ_HEADER (32)
 
+/*
+  ステートの読み書きは、すべてメモリ上のバッファに対して行う。
+
+  セーブは statesave_buffer() でバッファに書き出す。ファイルへは、その
+  バッファを一度に書き込む。ロードは、ファイルをバッファに読み込んでから
+  stateload_buffer() で取り出す。このとき、データ部の ID と位置の一覧を
+  一度だけ作っておき、各 ID の検索はこの一覧から行う。
+
+  ファイルを介さないので、巻き戻しやランアヘッド、テストなどで、メモリ上に
+  ステートを保存・復元する用途にも使える。
+
+  ファイルには、データ部ごとに圧縮し CRC を付けた形式で保存する (詳細は
+  state-file.cpp)。書き込みは別スレッドで一時ファイルに行い、完了したら
+  元のファイルと置き換える。ロード時は CRC を確認してから展開する。
+  圧縮していない以前の形式のファイルも、そのまま読み込める。
+*/
+
+static std::vector<uint8_t> *statesave_buf; /* セーブ先のバッファ   */
+
+static StateFileWriter state_writer; /* ステートファイルの書き込み */
+
+static const uint8_t *stateload_buf; /* ロード元のバッファ   */
+static size_t stateload_size;        /*   そのサイズ         */
+static size_t stateload_pos;         /*   読み込み位置       */
+
+typedef struct {
+  char id[4];    /* ID                */
+  int size;      /* データ長          */
+  size_t offset; /* データの位置      */
+} T_STATE_DIR;
+
+static std::vector<T_STATE_DIR> stateload_dir; /* データ部の一覧       */
+static int stateload_dir_complete;             /* 終端部まで揃ったか */
+
+static bool state_write(const void *ptr, size_t size) {
+  const uint8_t *p = static_cast<const uint8_t *>(ptr);
+  statesave_buf->insert(statesave_buf->end(), p, p + size);
+  return true;
+}
+
+static bool state_read(void *ptr, size_t size) {
+  if (stateload_size - stateload_pos < size)
+    return false;
+  memcpy(ptr, &stateload_buf[stateload_pos], size);
+  stateload_pos += size;
+  return true;
+}
+
 /*----------------------------------------------------------------------
  * ステートファイルにデータを記録する関数
  * ステートファイルに記録されたデータを取り出す関数
@@ -66,66 +118,54 @@ char file_state[QUASI88_MAX_FILENAME]; /* ステートファイル名   */
  *      int 型、 short 型、char 型、pair 型、256バイトブロック、
  *      文字列(1023文字まで)、double型 (1000000倍してintに変換)
  *----------------------------------------------------------------------*/
-INLINE bool statesave_int(OSD_FILE *fp, const int32_t *val) {
+INLINE bool statesave_int(const int32_t *val) {
   int32_t r = QUASI88::convert_le(*val);
-  return (osd_fwrite(&r, sizeof(r), 1, fp) == 1);
+  return state_write(&r, sizeof(r));
 }
 
-INLINE bool stateload_int(OSD_FILE *fp, int32_t *val) {
+INLINE bool stateload_int(int32_t *val) {
   int32_t r;
-  if (osd_fread(&r, sizeof(r), 1, fp) != 1)
+  if (!state_read(&r, sizeof(r)))
     return false;
   *val = QUASI88::convert_le(r);
   return true;
 }
 
-INLINE bool statesave_short(OSD_FILE *fp, const int16_t *val) {
+INLINE bool statesave_short(const int16_t *val) {
   int16_t r = QUASI88::convert_le(*val);
-  return (osd_fwrite(&r, sizeof(r), 1, fp) == 1);
+  return state_write(&r, sizeof(r));
 }
 
-INLINE int stateload_short(OSD_FILE *fp, int16_t *val) {
+INLINE int stateload_short(int16_t *val) {
   int16_t r;
-  if (osd_fread(&r, sizeof(r), 1, fp) != 1)
+  if (!state_read(&r, sizeof(r)))
     return false;
   *val = QUASI88::convert_le(r);
   return true;
 }
 
-INLINE int statesave_char(OSD_FILE *fp, int8_t *val) {
-  return (osd_fwrite(val, sizeof(int8_t), 1, fp) == 1);
-}
+INLINE int statesave_char(int8_t *val) { return state_write(val, sizeof(int8_t)); }
 
-INLINE int stateload_char(OSD_FILE *fp, int8_t *val) {
-  if (osd_fread(val, sizeof(int8_t), 1, fp) != 1)
-    return false;
-  return true;
-}
+INLINE int stateload_char(int8_t *val) { return state_read(val, sizeof(int8_t)); }
 
-INLINE int statesave_pair(OSD_FILE *fp, pair *val) {
+INLINE int statesave_pair(pair *val) {
   uint16_t r = QUASI88::convert_le(val->W);
-  return (osd_fwrite(QUASI88::convert_le(&r), sizeof(r), 1, fp) == 1);
+  return state_write(&r, sizeof(r));
 }
 
-INLINE int stateload_pair(OSD_FILE *fp, pair *val) {
+INLINE int stateload_pair(pair *val) {
   uint16_t r;
-  if (osd_fread(&r, sizeof(r), 1, fp) != 1)
+  if (!state_read(&r, sizeof(r)))
     return false;
   (*val).W = QUASI88::convert_le(r);
   return true;
 }
 
-INLINE int statesave_256(OSD_FILE *fp, char *array) {
-  return (osd_fwrite(array, sizeof(char), 256, fp) == 256);
-}
+INLINE int statesave_256(char *array) { return state_write(array, 256); }
 
-INLINE int stateload_256(OSD_FILE *fp, char *array) {
-  if (osd_fread(array, sizeof(char), 256, fp) != 256)
-    return false;
-  return true;
-}
+INLINE int stateload_256(char *array) { return state_read(array, 256); }
 
-INLINE int statesave_str(OSD_FILE *fp, char *str) {
+INLINE int statesave_str(char *str) {
   char wk[1024];
 
   if (strlen(str) >= 1024 - 1)
@@ -134,66 +174,75 @@ INLINE int statesave_str(OSD_FILE *fp, char *str) {
   memset(wk, 0, 1024);
   strcpy(wk, str);
 
-  return (osd_fwrite(wk, sizeof(char), 1024, fp) == 1024);
+  return state_write(wk, 1024);
 }
 
-INLINE int stateload_str(OSD_FILE *fp, char *str) {
-  if (osd_fread(str, sizeof(char), 1024, fp) != 1024)
-    return false;
-  return true;
-}
+INLINE int stateload_str(char *str) { return state_read(str, 1024); }
 
-INLINE int statesave_double(OSD_FILE *fp, double_t *val) {
-  auto r = (int32_t)(*val * 1000000.0);
-  return (osd_fwrite(QUASI88::convert_le(&r), sizeof(r), 1, fp) == 1);
+INLINE int statesave_double(double_t *val) {
+  auto r = QUASI88::convert_le((int32_t)(*val * 1000000.0));
+  return state_write(&r, sizeof(r));
 }
 
-INLINE int stateload_double(OSD_FILE *fp, double_t *val) {
+INLINE int stateload_double(double_t *val) {
   int32_t r;
-  if (osd_fread(&r, sizeof(r), 1, fp) != 1)
+  if (!state_read(&r, sizeof(r)))
     return false;
   *val = QUASI88::convert_le(r) / 1000000.0;
   return true;
 }
 
 /*----------------------------------------------------------------------
+ * データ部の一覧を作る関数
  * IDを検索する関数  戻り値：データサイズ (-1でエラー、-2でデータなし)
  * IDを書き込む関数  戻り値：データサイズ (-1でエラー)
  *----------------------------------------------------------------------*/
 
-static int read_id(OSD_FILE *fp, const char id[4]) {
-  char c[4];
-  int size;
+static void make_dir() {
+  T_STATE_DIR d;
 
-  /* ファイル先頭から検索。まずはヘッダをスキップ */
-  if (osd_fseek(fp, SZ_HEADER, SEEK_SET) != 0)
-    return -1;
+  stateload_dir.clear();
+  stateload_dir_complete = false;
 
-  /* ID が合致するまで SEEK していく */
+  /* ヘッダをスキップし、終端部まで順に登録 */
+  stateload_pos = SZ_HEADER;
   for (;;) {
-    if (osd_fread(c, sizeof(char), 4, fp) != 4)
-      return -1;
-    if (!stateload_int(fp, &size))
-      return -1;
-
-    if (memcmp(c, id, 4) == 0) { /* ID合致した */
-      return size;
+    if (!state_read(d.id, 4))
+      return;
+    if (!stateload_int(&d.size))
+      return;
+
+    if (memcmp(d.id, "\0\0\0\0", 4) == 0) {
+      stateload_dir_complete = true; /* データ終端 */
+      return;
     }
 
-    if (memcmp(c, "\0\0\0\0", 4) == 0)
-      return -2; /* データ終端 */
+    d.offset = stateload_pos;
+    stateload_dir.push_back(d);
 
-    if (osd_fseek(fp, size, SEEK_CUR) != 0)
-      return -1;
+    if (d.size < 0 || stateload_size - stateload_pos < (size_t)d.size)
+      return;
+    stateload_pos += d.size;
   }
 }
 
-static int write_id(OSD_FILE *fp, const char id[4], int size) {
-  /* ファイル現在位置に、書き込む */
+static int read_id(const char id[4]) {
+  /* 同じ ID が複数あれば、先頭のものを使う */
+  for (const auto &d : stateload_dir) {
+    if (memcmp(d.id, id, 4) == 0) { /* ID合致した */
+      stateload_pos = d.offset;
+      return d.size;
+    }
+  }
+  return (stateload_dir_complete) ? -2 : -1;
+}
+
+static int write_id(const char id[4], int size) {
+  /* バッファ末尾に、書き込む */
 
-  if (osd_fwrite(id, sizeof(char), 4, fp) != 4)
+  if (!state_write(id, 4))
     return -1;
-  if (!statesave_int(fp, &size))
+  if (!statesave_int(&size))
     return -1;
 
   return size;
@@ -204,13 +253,11 @@ static int write_id(OSD_FILE *fp, const char id[4], int size) {
  * ステートファイルにデータを記録
  *
  *======================================================================*/
-static OSD_FILE *statesave_fp;
 
 /* ヘッダ情報を書き込む */
 static int statesave_header() {
   size_t off;
   char header[SZ_HEADER];
-  OSD_FILE *fp = statesave_fp;
 
   memset(header, 0, SZ_HEADER);
   off = 0;
@@ -220,7 +267,7 @@ static int statesave_header() {
   off += sizeof(STATE_VER);
   memcpy(&header[off], STATE_REV, sizeof(STATE_REV));
 
-  if (osd_fseek(fp, 0, SEEK_SET) == 0 && osd_fwrite(header, sizeof(char), SZ_HEADER, fp) == SZ_HEADER) {
+  if (state_write(header, SZ_HEADER)) {
     return STATE_OK;
   }
 
@@ -229,9 +276,7 @@ static int statesave_header() {
 
 /* メモリブロックを書き込む */
 int statesave_block(const char id[4], void *top, int size) {
-  OSD_FILE *fp = statesave_fp;
-
-  if (write_id(fp, id, size) == size && osd_fwrite((char *)top, sizeof(char), size, fp) == (size_t)size) {
+  if (write_id(id, size) == size && state_write(top, size)) {
     return STATE_OK;
   }
 
@@ -240,7 +285,6 @@ int statesave_block(const char id[4], void *top, int size) {
 
 /* テーブル情報に従い、書き込む */
 int statesave_table(const char id[4], T_SUSPEND_W *tbl) {
-  OSD_FILE *fp = statesave_fp;
   T_SUSPEND_W *p = tbl;
   int size = 0;
   int loop = true;
@@ -274,7 +318,7 @@ int statesave_table(const char id[4], T_SUSPEND_W *tbl) {
     p++;
   }
 
-  if (write_id(fp, id, size) != size)
+  if (write_id(id, size) != size)
     return STATE_ERR;
 
   for (;;) {
@@ -285,39 +329,39 @@ int statesave_table(const char id[4], T_SUSPEND_W *tbl) {
 
     case TYPE_INT:
     case TYPE_LONG:
-      if (!statesave_int(fp, (int32_t *)tbl->work))
+      if (!statesave_int((int32_t *)tbl->work))
         return STATE_ERR;
       break;
 
     case TYPE_SHORT:
     case TYPE_WORD:
-      if (!statesave_short(fp, (int16_t *)tbl->work))
+      if (!statesave_short((int16_t *)tbl->work))
         return STATE_ERR;
       break;
 
     case TYPE_CHAR:
     case TYPE_BYTE:
-      if (!statesave_char(fp, (int8_t *)tbl->work))
+      if (!statesave_char((int8_t *)tbl->work))
         return STATE_ERR;
       break;
 
     case TYPE_PAIR:
-      if (!statesave_pair(fp, (pair *)tbl->work))
+      if (!statesave_pair((pair *)tbl->work))
         return STATE_ERR;
       break;
 
     case TYPE_DOUBLE:
-      if (!statesave_double(fp, (double_t *)tbl->work))
+      if (!statesave_double((double_t *)tbl->work))
         return STATE_ERR;
       break;
 
     case TYPE_STR:
-      if (!statesave_str(fp, (char *)tbl->work))
+      if (!statesave_str((char *)tbl->work))
         return STATE_ERR;
       break;
 
     case TYPE_256:
-      if (!statesave_256(fp, (char *)tbl->work))
+      if (!statesave_256((char *)tbl->work))
         return STATE_ERR;
       break;
 
@@ -329,21 +373,73 @@ int statesave_table(const char id[4], T_SUSPEND_W *tbl) {
   }
 }
 
+/*
+ * テーブルの内容のハッシュ (-hashlog)
+ *      ステートファイルと同じ並びに変換してからハッシュを求めるので、
+ *      エンディアンが違っても同じ値になる。ファイル名 (TYPE_STR) は環境で
+ *      変わるので含めない。
+ */
+uint64_t statehash_table(T_SUSPEND_W *tbl, uint64_t seed) {
+  uint8_t buf[2048];
+  size_t n = 0;
+
+  for (; tbl->type != TYPE_END; tbl++) {
+    if (sizeof(buf) - n < 256) {
+      seed = hash64(buf, n, seed);
+      n = 0;
+    }
+    switch (tbl->type) {
+    case TYPE_INT:
+    case TYPE_LONG: {
+      int32_t v = QUASI88::convert_le(*(int32_t *)tbl->work);
+      memcpy(&buf[n], &v, 4);
+      n += 4;
+    } break;
+    case TYPE_SHORT:
+    case TYPE_WORD: {
+      int16_t v = QUASI88::convert_le(*(int16_t *)tbl->work);
+      memcpy(&buf[n], &v, 2);
+      n += 2;
+    } break;
+    case TYPE_CHAR:
+    case TYPE_BYTE:
+      buf[n++] = *(uint8_t *)tbl->work;
+      break;
+    case TYPE_PAIR: {
+      uint16_t v = QUASI88::convert_le(((pair *)tbl->work)->W);
+      memcpy(&buf[n], &v, 2);
+      n += 2;
+    } break;
+    case TYPE_DOUBLE: {
+      int32_t v = QUASI88::convert_le((int32_t)(*(double_t *)tbl->work * 1000000.0));
+      memcpy(&buf[n], &v, 4);
+      n += 4;
+    } break;
+    case TYPE_256:
+      memcpy(&buf[n], tbl->work, 256);
+      n += 256;
+      break;
+    default:
+      break;
+    }
+  }
+  return hash64(buf, n, seed);
+}
+
 /*======================================================================
  *
  * ステートファイルからデータを取り出す
  *
  *======================================================================*/
-static OSD_FILE *stateload_fp;
 static int statefile_rev = 0;
 
 /* ヘッダ情報を取り出す */
 static int stateload_header() {
   char header[SZ_HEADER + 1];
   char *title, *ver, *rev;
-  OSD_FILE *fp = stateload_fp;
 
-  if (osd_fseek(fp, 0, SEEK_SET) == 0 && osd_fread(header, sizeof(char), SZ_HEADER, fp) == SZ_HEADER) {
+  stateload_pos = 0;
+  if (state_read(header, SZ_HEADER)) {
     header[SZ_HEADER] = '\0';
 
     title = header;
@@ -378,9 +474,7 @@ static int stateload_header() {
 
 /* メモリブロックを取り出す */
 int stateload_block(const char id[4], void *top, int size) {
-  OSD_FILE *fp = stateload_fp;
-
-  int s = read_id(fp, id);
+  int s = read_id(id);
 
   if (s == -1)
     return STATE_ERR;
@@ -389,7 +483,7 @@ int stateload_block(const char id[4], void *top, int size) {
   if (s != size)
     return STATE_ERR_SIZE;
 
-  if (osd_fread((char *)top, sizeof(char), size, fp) == (size_t)size) {
+  if (state_read(top, size)) {
     return STATE_OK;
   }
 
@@ -398,9 +492,8 @@ int stateload_block(const char id[4], void *top, int size) {
 
 /* テーブル情報に従い、取り出す */
 int stateload_table(const char id[4], T_SUSPEND_W *tbl) {
-  OSD_FILE *fp = stateload_fp;
   int size = 0;
-  int s = read_id(fp, id);
+  int s = read_id(id);
 
   if (s == -1)
     return STATE_ERR;
@@ -418,45 +511,45 @@ int stateload_table(const char id[4], T_SUSPEND_W *tbl) {
 
     case TYPE_INT:
     case TYPE_LONG:
-      if (!stateload_int(fp, (int *)tbl->work))
+      if (!stateload_int((int *)tbl->work))
         return STATE_ERR;
       size += 4;
       break;
 
     case TYPE_SHORT:
     case TYPE_WORD:
-      if (!stateload_short(fp, (short *)tbl->work))
+      if (!stateload_short((short *)tbl->work))
         return STATE_ERR;
       size += 2;
       break;
 
     case TYPE_CHAR:
     case TYPE_BYTE:
-      if (!stateload_char(fp, (int8_t *)tbl->work))
+      if (!stateload_char((int8_t *)tbl->work))
         return STATE_ERR;
       size += 1;
       break;
 
     case TYPE_PAIR:
-      if (!stateload_pair(fp, (pair *)tbl->work))
+      if (!stateload_pair((pair *)tbl->work))
         return STATE_ERR;
       size += 2;
       break;
 
     case TYPE_DOUBLE:
-      if (!stateload_double(fp, (double *)tbl->work))
+      if (!stateload_double((double *)tbl->work))
         return STATE_ERR;
       size += 4;
       break;
 
     case TYPE_STR:
-      if (!stateload_str(fp, (char *)tbl->work))
+      if (!stateload_str((char *)tbl->work))
         return STATE_ERR;
       size += 1024;
       break;
 
     case TYPE_256:
-      if (!stateload_256(fp, (char *)tbl->work))
+      if (!stateload_256((char *)tbl->work))
         return STATE_ERR;
       size += 256;
       break;
@@ -604,6 +697,8 @@ void filename_set_state_serial(int serial) {
 int statesave_check_file_exist() {
   OSD_FILE *fp;
 
+  state_writer.wait();
+
   if (file_state[0] && (fp = osd_fopen(FTYPE_STATE_LOAD, file_state, "rb"))) {
     osd_fclose(fp);
     return true;
@@ -611,9 +706,162 @@ int statesave_check_file_exist() {
   return false;
 }
 
-int statesave() {
+/*
+ * ステートをバッファに保存する / バッファから復元する
+ *      buf の内容はステートファイルと同じ。buf は使い回すと速い。
+ */
+int statesave_buffer(std::vector<uint8_t> &buf) {
+  int success = false;
+
+  buf.clear();
+  statesave_buf = &buf;
+
+  if (statesave_header() == STATE_OK) {
+    do {
+      if (!statesave_emu())
+        break;
+      if (!statesave_memory())
+        break;
+      if (!statesave_pc88main())
+        break;
+      if (!statesave_crtcdmac())
+        break;
+      if (!statesave_sound())
+        break;
+      if (!statesave_pio())
+        break;
+      if (!statesave_screen())
+        break;
+      if (!statesave_intr())
+        break;
+      if (!statesave_keyboard())
+        break;
+      if (!statesave_pc88sub())
+        break;
+      if (!statesave_fdc())
+        break;
+      if (!statesave_system())
+        break;
+
+      success = true;
+    } while (false);
+  }
+
+  statesave_buf = nullptr;
+  return success;
+}
+
+int stateload_buffer(const uint8_t *data, size_t size) {
   int success = false;
 
+  stateload_buf = data;
+  stateload_size = size;
+
+  if (stateload_header() == STATE_OK) {
+    make_dir();
+    do {
+      if (!stateload_emu())
+        break;
+      if (!stateload_sound())
+        break;
+      if (!stateload_memory())
+        break;
+      if (!stateload_pc88main())
+        break;
+      if (!stateload_crtcdmac())
+        break;
+      /*if( stateload_sound()    == false ) break; memoryの前に！ */
+      if (!stateload_pio())
+        break;
+      if (!stateload_screen())
+        break;
+      if (!stateload_intr())
+        break;
+      if (!stateload_keyboard())
+        break;
+      if (!stateload_pc88sub())
+        break;
+      if (!stateload_fdc())
+        break;
+      if (!stateload_system())
+        break;
+
+      success = true;
+    } while (false);
+  }
+
+  stateload_buf = nullptr;
+  stateload_size = 0;
+  stateload_dir.clear();
+  return success;
+}
+
+/*
+ * ステートのハッシュ (リプレイの同期確認用)
+ *      RAM、VRAM、CPU のレジスタなど、エミュレーションの結果で決まる部分の
+ *      CRC。ファイル名や表示の設定など、環境で変わる部分は含めない。
+ */
+uint32_t statesave_hash(const std::vector<uint8_t> &buf) {
+  static const struct {
+    char id[4];
+    int skip; /* 先頭から除く大きさ */
+  } blocks[] = {
+      {{'M', 'E', 'M', '0'}, 0},        {{'M', 'E', 'M', '1'}, 0}, {{'M', 'E', 'M', '2'}, 0},
+      {{'M', 'E', 'M', '3'}, 0},        {{'M', 'E', 'M', '4'}, 0}, {{'M', 'E', 'M', 'A'}, 0},
+      {{'M', 'E', 'M', 'B'}, 0},        {{'M', 'A', 'I', '2'}, 0}, {{'S', 'U', 'B', ' '}, 0},
+      {{'M', 'A', 'I', 'N'}, 2 * 1024}, /* 先頭はテープのファイル名 */
+  };
+  static std::vector<uint8_t> work;
+
+  work.clear();
+  stateload_buf = buf.data();
+  stateload_size = buf.size();
+  make_dir();
+  for (const auto &b : blocks) {
+    int size = read_id(b.id);
+    if (size > b.skip) {
+      const uint8_t *p = &stateload_buf[stateload_pos + b.skip];
+      work.insert(work.end(), p, p + size - b.skip);
+    }
+  }
+  stateload_buf = nullptr;
+  stateload_size = 0;
+  stateload_dir.clear();
+
+  return archive_crc32(work.data(), work.size());
+}
+
+/* ファイルを読み込み、CRC を確認して展開する */
+static int read_state_file(std::vector<uint8_t> &buf) {
+  std::vector<uint8_t> file;
+  OSD_FILE *fp;
+  long size;
+  int success = false;
+
+  state_writer.wait(); /* 書き込み中なら、終わるのを待つ */
+
+  if ((fp = osd_fopen(FTYPE_STATE_LOAD, file_state, "rb"))) {
+    if (osd_fseek(fp, 0, SEEK_END) == 0 && (size = osd_ftell(fp)) >= 0 && osd_fseek(fp, 0, SEEK_SET) == 0) {
+      file.resize(size);
+      success = (osd_fread(file.data(), sizeof(char), size, fp) == (size_t)size);
+    }
+    osd_fclose(fp);
+  }
+  if (success && !state_file_unpack(file, buf)) {
+    QLOG_WARN("suspend", "Stateload: {} is broken (CRC error)", file_state);
+    success = false;
+  }
+  return success;
+}
+
+/*
+ * ステートをバッファに保存し、ファイルへの書き込みを依頼する。
+ * 書き込みは別スレッドで行うので、ここではその結果はわからない。
+ * 結果は statesave_wait() か statesave_write_failed() で確認する。
+ */
+int statesave() {
+  static std::vector<uint8_t> buf;
+
   if (file_state[0] == '\0') {
     QLOG_WARN("suspend", "state-file name not defined");
     return false;
@@ -621,52 +869,46 @@ int statesave() {
 
   QLOG_DEBUG("suspend", "statesave: {}", file_state);
 
-  if ((statesave_fp = osd_fopen(FTYPE_STATE_SAVE, file_state, "wb"))) {
-    if (statesave_header() == STATE_OK) {
-      do {
-        if (!statesave_emu())
-          break;
-        if (!statesave_memory())
-          break;
-        if (!statesave_pc88main())
-          break;
-        if (!statesave_crtcdmac())
-          break;
-        if (!statesave_sound())
-          break;
-        if (!statesave_pio())
-          break;
-        if (!statesave_screen())
-          break;
-        if (!statesave_intr())
-          break;
-        if (!statesave_keyboard())
-          break;
-        if (!statesave_pc88sub())
-          break;
-        if (!statesave_fdc())
-          break;
-        if (!statesave_system())
-          break;
-
-        success = true;
-      } while (false);
-    }
-
-    osd_fclose(statesave_fp);
+  if (statesave_buffer(buf)) {
+    state_writer.write(file_state, buf);
+    return true;
   }
 
-  return success;
+  return false;
+}
+
+/* 書き込みが全て終わるのを待つ。失敗したものがあれば偽 (報告した失敗は消す) */
+int statesave_wait() {
+  state_writer.wait();
+  return (statesave_write_failed() == false);
+}
+
+/* 書き込みに失敗していたら、一度だけ真を返す (待たない) */
+int statesave_write_failed() {
+  std::string path;
+
+  if (state_writer.take_failure(path)) {
+    QLOG_ERROR("suspend", "Statesave: can't write {}", path);
+    return true;
+  }
+  return false;
 }
 
+/* ファイルがあり、壊れていなければ真 (全体を読んで確認する) */
 int stateload_check_file_exist() {
+  std::vector<uint8_t> buf;
   int success = false;
 
-  if (file_state[0] && (stateload_fp = osd_fopen(FTYPE_STATE_LOAD, file_state, "rb"))) {
-    if (stateload_header() == STATE_OK) { /* ヘッダだけチェック */
-      success = true;
+  if (file_state[0] && read_state_file(buf)) {
+    stateload_buf = buf.data();
+    stateload_size = buf.size();
+    if (stateload_header() == STATE_OK) {
+      make_dir(); /* 終端部まで揃っているか */
+      success = stateload_dir_complete;
     }
-    osd_fclose(stateload_fp);
+    stateload_buf = nullptr;
+    stateload_size = 0;
+    stateload_dir.clear();
   }
 
   QLOG_DEBUG("suspend", "Stateload: file check ... {}", (success) ? "OK" : "FAILED");
@@ -674,7 +916,7 @@ int stateload_check_file_exist() {
 }
 
 int stateload() {
-  int success = false;
+  std::vector<uint8_t> buf;
 
   if (file_state[0] == '\0') {
     printf("state-file name not defined\n");
@@ -683,44 +925,11 @@ int stateload() {
 
   QLOG_DEBUG("suspend", "Stateload: {}", file_state);
 
-  if ((stateload_fp = osd_fopen(FTYPE_STATE_LOAD, file_state, "rb"))) {
-
-    if (stateload_header() == STATE_OK) {
-      do {
-        if (!stateload_emu())
-          break;
-        if (!stateload_sound())
-          break;
-        if (!stateload_memory())
-          break;
-        if (!stateload_pc88main())
-          break;
-        if (!stateload_crtcdmac())
-          break;
-        /*if( stateload_sound()    == false ) break; memoryの前に！ */
-        if (!stateload_pio())
-          break;
-        if (!stateload_screen())
-          break;
-        if (!stateload_intr())
-          break;
-        if (!stateload_keyboard())
-          break;
-        if (!stateload_pc88sub())
-          break;
-        if (!stateload_fdc())
-          break;
-        if (!stateload_system())
-          break;
-
-        success = true;
-      } while (false);
-    }
-
-    osd_fclose(stateload_fp);
+  if (read_state_file(buf)) {
+    return stateload_buffer(buf.data(), buf.size());
   }
 
-  return success;
+  return false;
 }
 
 /***********************************************************************
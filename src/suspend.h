@@ -2,6 +2,8 @@
 #define SUSPEND_H_INCLUDED
 
 #include <stdio.h>
+#include <stdint.h>
+#include <vector>
 #include "file-op.h"
 
 extern int resume_flag;  /* 起動時のレジューム  */
@@ -67,7 +69,12 @@ void filename_set_state_serial(int serial);
 
 void stateload_init();
 int statesave();
+int statesave_wait();
+int statesave_write_failed();
 int stateload();
+int statesave_buffer(std::vector<uint8_t> &buf);
+int stateload_buffer(const uint8_t *data, size_t size);
+uint32_t statesave_hash(const std::vector<uint8_t> &buf);
 int statesave_check_file_exist();
 int stateload_check_file_exist();
 
@@ -83,4 +90,11 @@ int stateload_block(const char id[4], void *top, int size);
 int statesave_table(const char id[4], T_SUSPEND_W *tbl);
 int stateload_table(const char id[4], T_SUSPEND_W *tbl);
 
+/* フレームごとのハッシュ (-hashlog)。seed を続けて渡せば、複数を一つにできる */
+uint64_t statehash_table(T_SUSPEND_W *tbl, uint64_t seed);
+uint64_t statehash_pc88main();
+uint64_t statehash_pc88sub();
+uint64_t statehash_fdc();
+uint64_t statehash_sound();
+
 #endif /* SUSPEND_H_INCLUDED */
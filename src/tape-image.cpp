@@ -0,0 +1,197 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "tape-image.h"
+
+#include "Core/Log.h"
+
+namespace {
+
+/* Header of a T88 image, including the terminating NUL */
+constexpr char T88_HEADER[] = "PC-8801 Tape Image(T88)";
+
+enum : uint16_t {
+  T88_END = 0x0000,
+  T88_BLANK = 0x0100,
+  T88_DATA = 0x0101,
+  T88_SPACE = 0x0102,
+  T88_MARK = 0x0103,
+};
+
+uint32_t get16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+uint32_t get32(const uint8_t *p) { return get16(p) | (get16(p + 2) << 16); }
+
+} // namespace
+
+void TapeImage::clear() {
+  image.clear();
+  list.clear();
+  next_data.clear();
+  t88 = false;
+  block = 0;
+  pos = 0;
+}
+
+void TapeImage::load(std::vector<uint8_t> &&file) {
+  clear();
+  image = std::move(file);
+
+  const uint8_t *p = image.data();
+  size_t size = image.size();
+  size_t chars = 0;
+
+  if (size < sizeof(T88_HEADER) || memcmp(p, T88_HEADER, sizeof(T88_HEADER)) != 0) {
+    /* CMT: the whole file is data */
+    list.push_back({TapeBlockType::Data, 0, 0, size, 0, 0});
+
+  } else {
+    t88 = true;
+
+    size_t tag = sizeof(T88_HEADER);
+    while (tag + 4 <= size) {
+      uint32_t id = get16(&p[tag]);
+      if (id == T88_END) {
+        break;
+      }
+      size_t len = get16(&p[tag + 2]);
+      size_t body = tag + 4;
+
+      if (id == T88_DATA) {
+        /* 12 bytes of information (time, baud rate, ...) are ignored */
+        if (len < 12 || body + 12 > size) {
+          break;
+        }
+        /* A data tag cut short by the end of file still gives its bytes */
+        size_t data_size = std::min(len - 12, size - body - 12);
+        list.push_back({TapeBlockType::Data, tag, body + 12, data_size, chars, 0});
+        chars += data_size;
+
+      } else if (id == T88_BLANK || id == T88_SPACE || id == T88_MARK) {
+        /* Start time and length. Only the length is used */
+        if (len != 8 || body + 8 > size) {
+          break;
+        }
+        TapeBlockType type = (id == T88_BLANK)   ? TapeBlockType::Blank
+                             : (id == T88_SPACE) ? TapeBlockType::Space
+                                                 : TapeBlockType::Mark;
+        list.push_back({type, tag, 0, 0, chars, get32(&p[body + 4])});
+
+      } else if (body + len > size) { /* Other tags are skipped */
+        break;
+      }
+      tag = body + len;
+    }
+    if (tag + 4 <= size && get16(&p[tag]) != T88_END) {
+      QLOG_WARN("proc", "Tape image: broken tag at {:#x}, ignored after it", tag);
+    }
+  }
+
+  next_data.resize(list.size());
+  size_t next = list.size();
+  for (size_t i = list.size(); i-- > 0;) {
+    next_data[i] = next;
+    if (list[i].type == TapeBlockType::Data) {
+      next = i;
+    }
+  }
+}
+
+int TapeImage::get(int *tick) {
+  /* Pass gaps and finished data blocks, adding up the gap lengths */
+  while (block < list.size() && !in_data()) {
+    if (list[block].type != TapeBlockType::Data && tick) {
+      *tick += list[block].time;
+    }
+    block++;
+    pos = 0;
+  }
+  if (block == list.size()) {
+    return EOF;
+  }
+  return image[list[block].offset + pos++];
+}
+
+size_t TapeImage::chars() const {
+  if (block == list.size()) {
+    return list.empty() ? 0 : list.back().chars + list.back().size;
+  }
+  return list[block].chars + pos;
+}
+
+size_t TapeImage::file_pos() const {
+  if (block == list.size()) {
+    return image.size();
+  }
+  const TapeBlock &b = list[block];
+  return (b.type == TapeBlockType::Data) ? b.offset + pos : b.file_offset;
+}
+
+bool TapeImage::seek_block(size_t n) {
+  if (n > list.size()) {
+    return false;
+  }
+  block = n;
+  pos = 0;
+  return true;
+}
+
+bool TapeImage::seek_next_data() {
+  return seek_block(block < list.size() ? next_data[block] : list.size());
+}
+
+bool TapeImage::seek_chars(size_t n) {
+  /*
+   * The data bytes read up to the end of each block never decrease, so the
+   * first block where they reach n is found by binary search. For n > 0 it
+   * is the data block holding the n-th byte, and the position is left at
+   * that byte like get() does (gaps after it are passed on the next read).
+   */
+  auto it = std::lower_bound(list.begin(), list.end(), n, [](const TapeBlock &b, size_t value) {
+    return b.chars + (b.type == TapeBlockType::Data ? b.size : 0) < value;
+  });
+  if (it == list.end()) {
+    seek_block(list.size());
+    return n == 0;
+  }
+  block = it - list.begin();
+  pos = n - it->chars;
+  return true;
+}
+
+const uint8_t *TapeImage::peek(size_t *size) const {
+  if (!in_data()) {
+    *size = 0;
+    return nullptr;
+  }
+  *size = list[block].size - pos;
+  return &image[list[block].offset + pos];
+}
+
+void TapeImage::skip(size_t size) {
+  if (in_data()) {
+    pos += std::min(size, list[block].size - pos);
+  }
+}
+
+size_t TapeImage::read(uint8_t *buf, size_t size) {
+  size_t done = 0;
+  while (done < size) {
+    size_t len;
+    const uint8_t *p = peek(&len);
+    if (p == nullptr) {
+      if (block == list.size() || next_data[block] == list.size()) {
+        break;
+      }
+      seek_next_data();
+      continue;
+    }
+    len = std::min(len, size - done);
+    memcpy(buf + done, p, len);
+    skip(len);
+    done += len;
+  }
+  return done;
+}
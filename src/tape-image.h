@@ -0,0 +1,79 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#pragma once
+
+/*
+ * Tape images (CMT and T88) for loading.
+ *
+ * The whole image is parsed once into a list of blocks. Playback reads from
+ * memory, and the read position can be moved to any block, or to a given
+ * number of data bytes from the start, without reading the tape through.
+ *
+ * A CMT image is a single data block. In a T88 image, data tags are data
+ * blocks, and blank, space and mark tags are gaps whose length (in 1/4800s)
+ * is reported by get() when the next data byte is read.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class TapeBlockType : uint8_t { Data, Blank, Space, Mark };
+
+struct TapeBlock {
+  TapeBlockType type;
+  size_t file_offset; /* Position of the tag in the file */
+  size_t offset;      /* Data: position of the data in the file */
+  size_t size;        /* Data: number of bytes */
+  size_t chars;       /* Number of data bytes in the preceding blocks */
+  uint32_t time;      /* Gap: length */
+};
+
+class TapeImage {
+public:
+  /* Parse the image. A broken T88 tag ends the tape there */
+  void load(std::vector<uint8_t> &&file);
+  void clear();
+
+  bool is_t88() const { return t88; }
+  size_t file_size() const { return image.size(); }
+  const std::vector<TapeBlock> &blocks() const { return list; }
+
+  /* Next data byte, or EOF at the end. Gaps passed over are added to *tick */
+  int get(int *tick);
+
+  /* True if the position is inside a data block (not at its end) */
+  bool in_data() const { return block < list.size() && list[block].type == TapeBlockType::Data && pos < list[block].size; }
+
+  /* Data bytes read from the start, and the position in the file */
+  size_t chars() const;
+  size_t file_pos() const;
+
+  /* Current block. Equals blocks().size() at the end of the tape */
+  size_t current_block() const { return block; }
+
+  /* Move to the start of block n (n == blocks().size() is the end) */
+  bool seek_block(size_t n);
+  /* Move to the start of the next data block after the current one */
+  bool seek_next_data();
+  /* Move to where chars() == n, as if n bytes had been read from the start */
+  bool seek_chars(size_t n);
+
+  /*
+   * Contiguous data bytes from the current position up to the end of the
+   * current data block (nullptr and 0 if not in data). skip() consumes them.
+   */
+  const uint8_t *peek(size_t *size) const;
+  void skip(size_t size);
+
+  /* Copy up to size data bytes, across blocks and gaps. Returns the count */
+  size_t read(uint8_t *buf, size_t size);
+
+private:
+  std::vector<uint8_t> image;
+  std::vector<TapeBlock> list;
+  std::vector<size_t> next_data; /* Per block: index of the next data block */
+  bool t88 = false;
+
+  size_t block = 0; /* Current block */
+  size_t pos = 0;   /* Bytes read in the current data block */
+};
@@ -0,0 +1,117 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+/*
+ * quasi88-diskconv: convert disk images between the formats of disk-format.h
+ *
+ *   quasi88-diskconv <input> <output>
+ *      Convert one file. The output format is chosen by its extension.
+ *
+ *   quasi88-diskconv -t <d88|raw|qdi> <input>...
+ *      Convert every input to a file of the same name with the extension
+ *      of the format (.2d/.2dd/.2hd for raw, by disk size).
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "disk-format.h"
+
+static bool read_file(const std::string &path, std::vector<uint8_t> &buf) {
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (fp == nullptr) {
+    return false;
+  }
+  uint8_t block[65536];
+  size_t n;
+  while ((n = fread(block, 1, sizeof(block), fp)) > 0) {
+    buf.insert(buf.end(), block, block + n);
+  }
+  bool ok = !ferror(fp);
+  fclose(fp);
+  return ok;
+}
+
+static bool write_file(const std::string &path, const std::vector<uint8_t> &buf) {
+  FILE *fp = fopen(path.c_str(), "wb");
+  if (fp == nullptr) {
+    return false;
+  }
+  bool ok = (fwrite(buf.data(), 1, buf.size(), fp) == buf.size());
+  return (fclose(fp) == 0) && ok;
+}
+
+static std::string replace_extension(const std::string &path, const char *ext) {
+  size_t dot = path.find_last_of('.');
+  size_t sep = path.find_last_of("/\\");
+  if (dot == std::string::npos || (sep != std::string::npos && dot < sep)) {
+    return path + ext;
+  }
+  return path.substr(0, dot) + ext;
+}
+
+static bool convert(const std::string &input, const std::string &output, const DiskImageFormat *to) {
+  std::vector<uint8_t> src, dst;
+
+  if (!read_file(input, src)) {
+    fprintf(stderr, "%s: can't read\n", input.c_str());
+    return false;
+  }
+  const DiskImageFormat *from = disk_format_probe(src.data(), src.size(), input);
+  if (!disk_format_convert(from, src.data(), src.size(), to, dst)) {
+    fprintf(stderr, "%s: can't convert from %s to %s\n", input.c_str(), from->name(), to->name());
+    return false;
+  }
+
+  std::string path = output;
+  if (path.empty()) {
+    const char *ext = to->extension();
+    if (to == disk_format_by_name("raw")) {
+      ext = (dst.size() <= 327680) ? ".2d" : (dst.size() <= 655360) ? ".2dd" : ".2hd";
+    }
+    path = replace_extension(input, ext);
+    if (path == input) {
+      fprintf(stderr, "%s: already in %s format\n", input.c_str(), to->name());
+      return false;
+    }
+  }
+  if (!write_file(path, dst)) {
+    fprintf(stderr, "%s: can't write\n", path.c_str());
+    return false;
+  }
+  printf("%s (%s) -> %s (%s)\n", input.c_str(), from->name(), path.c_str(), to->name());
+  return true;
+}
+
+static int usage() {
+  fprintf(stderr, "usage: quasi88-diskconv <input> <output>\n"
+                  "       quasi88-diskconv -t <d88|raw|qdi> <input>...\n");
+  return 2;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc >= 3 && strcmp(argv[1], "-t") == 0) {
+    const DiskImageFormat *to = disk_format_by_name(argv[2]);
+    if (to == nullptr || argc < 4) {
+      return usage();
+    }
+    int failed = 0;
+    for (int i = 3; i < argc; i++) {
+      if (!convert(argv[i], "", to)) {
+        failed++;
+      }
+    }
+    return (failed) ? 1 : 0;
+  }
+
+  if (argc != 3) {
+    return usage();
+  }
+  const DiskImageFormat *to = disk_format_by_extension(argv[2]);
+  if (to == nullptr) {
+    fprintf(stderr, "%s: unknown format\n", argv[2]);
+    return 2;
+  }
+  return convert(argv[1], argv[2], to) ? 0 : 1;
+}
@@ -0,0 +1,147 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+/*
+ * quasi88-hashcmp: compare two frame hash logs (-hashlog, see hash-log.h)
+ *
+ *   quasi88-hashcmp <log1> <log2>
+ *      Print the first frame where the logs differ and the blocks that
+ *      differ in it. Exits with 0 if the logs are the same, 1 if they
+ *      differ, 2 if a log can't be read or is cut short before they differ.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "hash-log.h"
+
+namespace {
+
+uint32_t get32(const uint8_t *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+
+struct HashLog {
+  std::string path;
+  std::vector<uint8_t> data;
+  std::vector<std::string> ids;
+  size_t pos = 0;
+  std::vector<uint64_t> hash; /* Of the current frame */
+
+  bool open();
+  /* Read the next frame into hash. False at the end */
+  bool next(bool &broken);
+};
+
+bool HashLog::open() {
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (fp == nullptr) {
+    return false;
+  }
+  uint8_t block[65536];
+  size_t n;
+  while ((n = fread(block, 1, sizeof(block), fp)) > 0) {
+    data.insert(data.end(), block, block + n);
+  }
+  bool ok = !ferror(fp);
+  fclose(fp);
+
+  if (!ok || data.size() < HASH_LOG_HEADER_SIZE || memcmp(data.data(), HASH_LOG_MAGIC, sizeof(HASH_LOG_MAGIC)) != 0 ||
+      get32(&data[8]) != HASH_LOG_VERSION) {
+    return false;
+  }
+  uint32_t nblocks = get32(&data[12]);
+  if (nblocks > HASH_LOG_MAX_BLOCKS || data.size() < HASH_LOG_HEADER_SIZE + 4 * nblocks) {
+    return false;
+  }
+  for (uint32_t i = 0; i < nblocks; i++) {
+    std::string id((const char *)&data[HASH_LOG_HEADER_SIZE + 4 * i], 4);
+    id.erase(id.find_last_not_of(' ') + 1);
+    ids.push_back(id);
+  }
+  pos = HASH_LOG_HEADER_SIZE + 4 * nblocks;
+  hash.assign(nblocks, 0);
+  return true;
+}
+
+bool HashLog::next(bool &broken) {
+  broken = false;
+  if (pos >= data.size()) {
+    return false;
+  }
+  uint8_t mask = data[pos++];
+  for (size_t i = 0; i < ids.size(); i++) {
+    if (mask & (1 << i)) {
+      if (data.size() - pos < 8) {
+        broken = true; /* Cut short, e.g. the emulator was killed */
+        return false;
+      }
+      hash[i] = get32(&data[pos]) | ((uint64_t)get32(&data[pos + 4]) << 32);
+      pos += 8;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    fprintf(stderr, "usage: %s <log1> <log2>\n", argv[0]);
+    return 2;
+  }
+
+  HashLog log[2];
+  for (int i = 0; i < 2; i++) {
+    log[i].path = argv[i + 1];
+    if (!log[i].open()) {
+      fprintf(stderr, "%s: can't read, or not a hash log\n", argv[i + 1]);
+      return 2;
+    }
+  }
+
+  /* Blocks are matched by ID. Those in one log only are not compared */
+  std::vector<std::pair<size_t, size_t>> pairs;
+  for (size_t i = 0; i < log[0].ids.size(); i++) {
+    for (size_t j = 0; j < log[1].ids.size(); j++) {
+      if (log[0].ids[i] == log[1].ids[j]) {
+        pairs.emplace_back(i, j);
+      }
+    }
+  }
+  if (pairs.size() != log[0].ids.size() || pairs.size() != log[1].ids.size()) {
+    fprintf(stderr, "warning: the logs have different blocks, comparing %zu of them\n", pairs.size());
+  }
+
+  for (unsigned long frame = 0;; frame++) {
+    bool broken[2];
+    bool more[2] = {log[0].next(broken[0]), log[1].next(broken[1])};
+    for (int i = 0; i < 2; i++) {
+      if (broken[i]) {
+        fprintf(stderr, "%s: cut short at frame %lu\n", log[i].path.c_str(), frame);
+      }
+    }
+
+    if (!more[0] || !more[1]) {
+      if (broken[0] || broken[1]) {
+        return 2; /* Where the logs end says nothing */
+      }
+      if (more[0] == more[1]) {
+        printf("same: %lu frames\n", frame);
+        return 0;
+      }
+      printf("frame %lu: %s ends\n", frame, log[more[0] ? 1 : 0].path.c_str());
+      return 1;
+    }
+
+    std::string differ;
+    for (const auto &p : pairs) {
+      if (log[0].hash[p.first] != log[1].hash[p.second]) {
+        differ += " " + log[0].ids[p.first];
+      }
+    }
+    if (!differ.empty()) {
+      printf("frame %lu: differs in%s\n", frame, differ.c_str());
+      return 1;
+    }
+  }
+}
@@ -0,0 +1,471 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <system_error>
+
+#include "video-capture.h"
+
+#include "Core/Log.h"
+#include "byteswap.h"
+
+namespace {
+
+constexpr int MAX_QUEUED_FRAMES = 8;
+constexpr int KEYFRAME_SECONDS = 5;
+/* RIFF sizes are 32 bits, and some players take them as signed */
+constexpr uint32_t SIZE_LIMIT = 0x7f000000;
+
+constexpr uint32_t AVIF_HASINDEX = 0x10;
+constexpr uint32_t AVIIF_KEYFRAME = 0x10;
+constexpr uint32_t AVIIF_NO_TIME = 0x100;
+constexpr uint32_t BI_RLE8 = 1;
+
+uint32_t fourcc(const char id[4]) {
+  return (uint8_t)id[0] | ((uint8_t)id[1] << 8) | ((uint8_t)id[2] << 16) | ((uint32_t)(uint8_t)id[3] << 24);
+}
+
+void append16(std::vector<uint8_t> &out, uint16_t v) {
+  out.push_back(v & 0xff);
+  out.push_back(v >> 8);
+}
+
+void append32(std::vector<uint8_t> &out, uint32_t v) {
+  append16(out, v & 0xffff);
+  append16(out, v >> 16);
+}
+
+void append_id(std::vector<uint8_t> &out, const char id[4]) { out.insert(out.end(), id, id + 4); }
+
+void set32(std::vector<uint8_t> &out, size_t at, uint32_t v) {
+  out[at] = v & 0xff;
+  out[at + 1] = (v >> 8) & 0xff;
+  out[at + 2] = (v >> 16) & 0xff;
+  out[at + 3] = v >> 24;
+}
+
+/*
+ * Encode a frame in BI_RLE8. Lines are stored bottom up. With prev, pixels
+ * that didn't change are skipped with delta escapes; without, the whole
+ * frame is stored (a keyframe).
+ */
+void encode_rle8(const uint8_t *cur, const uint8_t *prev, std::vector<uint8_t> &out) {
+  constexpr int W = VideoCapture::WIDTH;
+  constexpr int H = VideoCapture::HEIGHT;
+  int cx = 0, cl = 0; /* Where the decoder is */
+
+  out.clear();
+  for (int line = 0; line < H; line++) {
+    const uint8_t *c = &cur[(H - 1 - line) * W];
+    const uint8_t *p = prev ? &prev[(H - 1 - line) * W] : nullptr;
+
+    for (int x = 0; x < W;) {
+      if (p && c[x] == p[x]) {
+        x++;
+        continue;
+      }
+
+      /* Move to (x, line) */
+      if (line > cl) {
+        out.insert(out.end(), {0, 0}); /* End of line */
+        cl++;
+        cx = 0;
+        while (line > cl) {
+          int dy = std::min(line - cl, 255);
+          out.insert(out.end(), {0, 2, 0, (uint8_t)dy});
+          cl += dy;
+        }
+      }
+      while (x > cx) {
+        int dx = std::min(x - cx, 255);
+        out.insert(out.end(), {0, 2, (uint8_t)dx, 0});
+        cx += dx;
+      }
+
+      int n = 1;
+      while (x + n < W && n < 255 && c[x + n] == c[x]) {
+        n++;
+      }
+      out.insert(out.end(), {(uint8_t)n, c[x]});
+      x += n;
+      cx = x;
+    }
+  }
+  out.insert(out.end(), {0, 1}); /* End of bitmap */
+}
+
+} // namespace
+
+bool VideoCapture::start(OSD_FILE *file, double rate, int audio_rate, const uint8_t (*palette)[3], int colors) {
+  if (fp) {
+    return false;
+  }
+  fp = file;
+  fps = rate;
+  sample_rate = audio_rate;
+  quit = false;
+  error = false;
+  io_error = false;
+  full = false;
+  repeated = 0;
+  queued_frames = 0;
+  pos = 0;
+  frames = 0;
+  samples = 0;
+  prev.clear();
+  prev_palette.assign(&palette[0][0], &palette[0][0] + 3 * std::min(colors, MAX_COLORS));
+  index.clear();
+
+  write_header();
+  if (io_error) {
+    fp = nullptr;
+    return false;
+  }
+
+  try {
+    worker = std::thread(&VideoCapture::run, this);
+  } catch (const std::system_error &) {
+    QLOG_WARN("proc", "Can't start video capture thread, encoding synchronously");
+  }
+  return true;
+}
+
+bool VideoCapture::stop() {
+  if (fp == nullptr) {
+    return true;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    quit = true; /* Nothing more is queued */
+  }
+  if (worker.joinable()) {
+    cv_data.notify_one();
+    worker.join(); /* Everything queued is still written */
+  }
+
+  /* The index, then the sizes and counts in the headers */
+  std::vector<uint8_t> idx;
+  append_id(idx, "idx1");
+  append32(idx, index.size() * 16);
+  for (const auto &e : index) {
+    append32(idx, e.id);
+    append32(idx, e.flags);
+    append32(idx, e.offset);
+    append32(idx, e.size);
+  }
+  uint32_t movi_end = pos;
+  put(idx.data(), idx.size());
+
+  patch32(4, pos - 8);                        /* RIFF */
+  patch32(movi_pos - 4, movi_end - movi_pos); /* movi LIST */
+  patch32(at_total_frames, frames);           /* avih */
+  patch32(at_video_length, frames);           /* strh (video) */
+  if (sample_rate) {
+    patch32(at_audio_length, samples); /* strh (audio) */
+  }
+
+  bool ok = !io_error;
+  if (full) {
+    QLOG_INFO("proc", "Video capture: stopped at the size limit of an AVI file");
+  }
+  if (repeated) {
+    QLOG_INFO("proc", "Video capture: {} frames were stored unchanged (encoding fell behind)", repeated);
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  fp = nullptr;
+  queue.clear();
+  spare.clear();
+  prev.clear();
+  index.clear();
+  return ok;
+}
+
+bool VideoCapture::failed() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return error;
+}
+
+void VideoCapture::frame(const uint8_t *pixels, const uint8_t (*palette)[3], int colors) {
+  std::unique_lock<std::mutex> lock(mutex);
+  if (fp == nullptr || quit || error) {
+    return;
+  }
+
+  Job job;
+  if (worker.joinable() && queued_frames >= MAX_QUEUED_FRAMES) {
+    job.type = JOB_REPEAT;
+    repeated++;
+  } else {
+    job.type = JOB_FRAME;
+    if (!spare.empty()) {
+      job.data.swap(spare.back());
+      spare.pop_back();
+    }
+    job.data.assign(pixels, pixels + WIDTH * HEIGHT);
+    job.palette.assign(&palette[0][0], &palette[0][0] + 3 * std::min(colors, MAX_COLORS));
+  }
+
+  if (!worker.joinable()) {
+    write_job(job);
+    error = io_error || full;
+    return;
+  }
+  queue.push_back(std::move(job));
+  queued_frames++;
+  lock.unlock();
+  cv_data.notify_one();
+}
+
+void VideoCapture::audio(const int16_t *data, int count) {
+  std::unique_lock<std::mutex> lock(mutex);
+  if (fp == nullptr || quit || error || sample_rate == 0 || count <= 0) {
+    return;
+  }
+
+  Job job;
+  job.type = JOB_AUDIO;
+  job.data.resize(count * 4);
+  for (int i = 0; i < count * 2; i++) {
+    int16_t v = QUASI88::convert_le(data[i]);
+    memcpy(&job.data[i * 2], &v, 2);
+  }
+
+  if (!worker.joinable()) {
+    write_job(job);
+    error = io_error || full;
+    return;
+  }
+  queue.push_back(std::move(job));
+  lock.unlock();
+  cv_data.notify_one();
+}
+
+void VideoCapture::run() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    cv_data.wait(lock, [&] { return quit || !queue.empty(); });
+    if (queue.empty()) {
+      break; /* quit, and everything is written */
+    }
+    Job job = std::move(queue.front());
+    queue.pop_front();
+    lock.unlock();
+
+    write_job(job);
+
+    lock.lock();
+    if (job.type != JOB_AUDIO) {
+      queued_frames--;
+    }
+    if (job.type == JOB_FRAME) {
+      spare.push_back(std::move(job.data));
+    }
+    if (io_error || full) {
+      error = true;
+    }
+  }
+}
+
+void VideoCapture::write_job(Job &job) {
+  if (io_error || full) {
+    return;
+  }
+
+  switch (job.type) {
+  case JOB_FRAME: {
+    if (job.palette != prev_palette) {
+      std::vector<uint8_t> pc;
+      int colors = job.palette.size() / 3;
+      pc.push_back(0);                                /* First entry */
+      pc.push_back(colors == MAX_COLORS ? 0 : colors); /* Number (0: 256) */
+      append16(pc, 0);
+      for (int i = 0; i < colors; i++) {
+        pc.insert(pc.end(), &job.palette[i * 3], &job.palette[i * 3] + 3);
+        pc.push_back(0);
+      }
+      write_chunk("00pc", pc, AVIIF_NO_TIME);
+      prev_palette = job.palette;
+    }
+
+    uint32_t key_interval = std::max(1, (int)std::lround(fps * KEYFRAME_SECONDS));
+    bool key = (frames % key_interval == 0 || prev.empty());
+    encode_rle8(job.data.data(), key ? nullptr : prev.data(), encoded);
+    write_chunk("00dc", encoded, key ? AVIIF_KEYFRAME : 0);
+    prev.swap(job.data);
+    frames++;
+  } break;
+
+  case JOB_REPEAT:
+    encoded.assign({0, 1}); /* Nothing changed */
+    write_chunk("00dc", encoded, 0);
+    frames++;
+    break;
+
+  case JOB_AUDIO:
+    write_chunk("01wb", job.data, AVIIF_KEYFRAME);
+    samples += job.data.size() / 4;
+    break;
+  }
+}
+
+void VideoCapture::write_header() {
+  const int streams = sample_rate ? 2 : 1;
+  const uint32_t rate = (uint32_t)std::lround(fps * 1000);
+  std::vector<uint8_t> h;
+
+  append_id(h, "RIFF");
+  append32(h, 0); /* Patched by stop() */
+  append_id(h, "AVI ");
+
+  append_id(h, "LIST");
+  size_t hdrl = h.size();
+  append32(h, 0);
+  append_id(h, "hdrl");
+
+  append_id(h, "avih");
+  append32(h, 56);
+  append32(h, (uint32_t)std::lround(1000000.0 / fps)); /* us per frame */
+  append32(h, 0);                                      /* Max bytes per second */
+  append32(h, 0);                                      /* Padding granularity */
+  append32(h, AVIF_HASINDEX);
+  at_total_frames = h.size();
+  append32(h, 0); /* Total frames */
+  append32(h, 0); /* Initial frames */
+  append32(h, streams);
+  append32(h, 0); /* Suggested buffer size */
+  append32(h, WIDTH);
+  append32(h, HEIGHT);
+  h.insert(h.end(), 16, 0);
+
+  /* Video stream */
+  append_id(h, "LIST");
+  size_t strl = h.size();
+  append32(h, 0);
+  append_id(h, "strl");
+  append_id(h, "strh");
+  append32(h, 56);
+  append_id(h, "vids");
+  append32(h, 0); /* Handler */
+  append32(h, 0); /* Flags */
+  append32(h, 0); /* Priority, language */
+  append32(h, 0); /* Initial frames */
+  append32(h, 1000);
+  append32(h, rate); /* Frames per 1000 seconds */
+  append32(h, 0);    /* Start */
+  at_video_length = h.size();
+  append32(h, 0);          /* Length */
+  append32(h, 0);          /* Suggested buffer size */
+  append32(h, 0xffffffff); /* Quality */
+  append32(h, 0);          /* Sample size */
+  append16(h, 0);
+  append16(h, 0);
+  append16(h, WIDTH);
+  append16(h, HEIGHT);
+  append_id(h, "strf");
+  append32(h, 40 + 4 * MAX_COLORS);
+  append32(h, 40);
+  append32(h, WIDTH);
+  append32(h, HEIGHT); /* Bottom up */
+  append16(h, 1);      /* Planes */
+  append16(h, 8);      /* Bits per pixel */
+  append32(h, BI_RLE8);
+  append32(h, WIDTH * HEIGHT);
+  append32(h, 0);
+  append32(h, 0);
+  append32(h, MAX_COLORS); /* Colors used */
+  append32(h, 0);
+  for (int i = 0; i < MAX_COLORS; i++) { /* RGBQUAD */
+    size_t c = i * 3;
+    bool set = (c + 2 < prev_palette.size());
+    h.push_back(set ? prev_palette[c + 2] : 0);
+    h.push_back(set ? prev_palette[c + 1] : 0);
+    h.push_back(set ? prev_palette[c] : 0);
+    h.push_back(0);
+  }
+  set32(h, strl, h.size() - strl - 4);
+
+  /* Sound stream */
+  if (sample_rate) {
+    append_id(h, "LIST");
+    strl = h.size();
+    append32(h, 0);
+    append_id(h, "strl");
+    append_id(h, "strh");
+    append32(h, 56);
+    append_id(h, "auds");
+    append32(h, 0);
+    append32(h, 0);
+    append32(h, 0);
+    append32(h, 0);
+    append32(h, 4);               /* Scale: bytes per sample */
+    append32(h, sample_rate * 4); /* Rate: bytes per second */
+    append32(h, 0);
+    at_audio_length = h.size();
+    append32(h, 0); /* Length in samples */
+    append32(h, 0);
+    append32(h, 0xffffffff);
+    append32(h, 4); /* Sample size */
+    h.insert(h.end(), 8, 0);
+    append_id(h, "strf");
+    append32(h, 18);
+    append16(h, 1); /* PCM */
+    append16(h, 2); /* Channels */
+    append32(h, sample_rate);
+    append32(h, sample_rate * 4);
+    append16(h, 4);  /* Block align */
+    append16(h, 16); /* Bits per sample */
+    append16(h, 0);
+    set32(h, strl, h.size() - strl - 4);
+  }
+
+  set32(h, hdrl, h.size() - hdrl - 4);
+
+  append_id(h, "LIST");
+  append32(h, 0); /* Patched by stop() */
+  append_id(h, "movi");
+  movi_pos = h.size() - 4;
+
+  put(h.data(), h.size());
+}
+
+void VideoCapture::write_chunk(const char id[4], const std::vector<uint8_t> &data, uint32_t flags) {
+  /* Leave room for the index stop() writes: its header, and an entry per chunk */
+  uint64_t end = (uint64_t)pos + 8 + data.size() + 1 + 8 + (index.size() + 1) * 16;
+  if (end > SIZE_LIMIT) {
+    full = true; /* Too large for an AVI file */
+    return;
+  }
+  index.push_back({fourcc(id), flags, pos - movi_pos, (uint32_t)data.size()});
+
+  std::vector<uint8_t> h;
+  append_id(h, id);
+  append32(h, data.size());
+  put(h.data(), h.size());
+  put(data.data(), data.size());
+  if (data.size() & 1) {
+    uint8_t pad = 0;
+    put(&pad, 1);
+  }
+}
+
+void VideoCapture::put(const void *data, size_t size) {
+  if (io_error || size == 0) {
+    return;
+  }
+  if (osd_fwrite(data, 1, size, fp) != size) {
+    io_error = true;
+    return;
+  }
+  pos += size;
+}
+
+void VideoCapture::patch32(uint32_t at, uint32_t v) {
+  uint8_t b[4] = {(uint8_t)(v & 0xff), (uint8_t)((v >> 8) & 0xff), (uint8_t)((v >> 16) & 0xff), (uint8_t)(v >> 24)};
+  if (osd_fseek(fp, at, SEEK_SET) != 0 || osd_fwrite(b, 1, 4, fp) != 4) {
+    io_error = true;
+  }
+  osd_fseek(fp, 0, SEEK_END);
+}
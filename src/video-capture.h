@@ -0,0 +1,108 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#pragma once
+
+/*
+ * Continuous capture of the screen (and sound) to an AVI file.
+ *
+ * Frames are the 640x400 palette-indexed images made for snapshots. They
+ * are stored as 8-bit RLE (BI_RLE8), which is lossless: a keyframe every few
+ * seconds, and otherwise only the pixels that changed since the previous
+ * frame. Palette changes are stored as palette change chunks. Sound, when
+ * given, is stored as 16-bit stereo PCM. Common players and ffmpeg read the
+ * result.
+ *
+ * Encoding and writing are done by a background thread. If it falls
+ * behind, a frame is stored as "no change" instead of waiting, so capturing
+ * never holds up the emulation; the number of such frames is logged at the
+ * end.
+ */
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "file-op.h"
+
+class VideoCapture {
+public:
+  static constexpr int WIDTH = 640;
+  static constexpr int HEIGHT = 400;
+  static constexpr int MAX_COLORS = 256;
+
+  VideoCapture() = default;
+  ~VideoCapture() { stop(); }
+
+  VideoCapture(const VideoCapture &) = delete;
+  VideoCapture &operator=(const VideoCapture &) = delete;
+
+  /*
+   * Start writing to fp (owned by the caller, which closes it after stop()).
+   * sample_rate is 0 for no sound. The palette is the one in the header.
+   */
+  bool start(OSD_FILE *fp, double fps, int sample_rate, const uint8_t (*palette)[3], int colors);
+  /* Finish the file. False if anything failed to be written */
+  bool stop();
+
+  bool active() const { return fp != nullptr; }
+  /* True once the file can't be written any more (error, or size limit) */
+  bool failed();
+
+  /* Queue a frame: WIDTH*HEIGHT palette indices, and colors RGB entries */
+  void frame(const uint8_t *pixels, const uint8_t (*palette)[3], int colors);
+  /* Queue sound: count samples of interleaved 16-bit stereo. Any thread */
+  void audio(const int16_t *samples, int count);
+
+private:
+  enum { JOB_FRAME, JOB_REPEAT, JOB_AUDIO };
+  struct Job {
+    int type;
+    std::vector<uint8_t> data;    /* Pixels or samples */
+    std::vector<uint8_t> palette; /* RGB */
+  };
+  struct Index {
+    uint32_t id;
+    uint32_t flags;
+    uint32_t offset; /* From the "movi" list type */
+    uint32_t size;
+  };
+
+  void run();
+  void write_job(Job &job);
+  void write_header();
+  void write_chunk(const char id[4], const std::vector<uint8_t> &data, uint32_t flags);
+  void put(const void *data, size_t size);
+  void patch32(uint32_t pos, uint32_t v);
+
+  OSD_FILE *fp = nullptr;
+  double fps = 0;
+  int sample_rate = 0;
+
+  std::thread worker;
+  std::mutex mutex;
+  std::condition_variable cv_data;
+  std::deque<Job> queue;
+  std::vector<std::vector<uint8_t>> spare; /* Frame buffers to reuse */
+  int queued_frames = 0;
+  bool quit = false;
+  bool error = false; /* io_error or full, seen by the caller */
+  size_t repeated = 0;
+
+  /* Used by the worker (or by the caller if there is no worker) */
+  bool io_error = false;
+  bool full = false;     /* The next chunk would pass SIZE_LIMIT */
+  uint32_t pos = 0;      /* Bytes written */
+  uint32_t movi_pos = 0; /* Of the "movi" list type */
+  uint32_t at_total_frames = 0; /* Header fields patched by stop() */
+  uint32_t at_video_length = 0;
+  uint32_t at_audio_length = 0;
+  uint32_t frames = 0;
+  uint32_t samples = 0;
+  std::vector<uint8_t> prev;
+  std::vector<uint8_t> prev_palette;
+  std::vector<uint8_t> encoded;
+  std::vector<Index> index;
+};
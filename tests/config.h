@@ -0,0 +1,12 @@
+#ifndef CONFIG_H_INCLUDED
+#define CONFIG_H_INCLUDED
+
+/*----------------------------------------------------------------------*/
+/* テスト用 (フロントエンドなしで、コアの一部をビルドする) の定義       */
+/*----------------------------------------------------------------------*/
+
+/* エンディアンネスは、CMake が LSB_FIRST を定義する */
+
+#define Q_COMMENT "test"
+
+#endif /* CONFIG_H_INCLUDED */
@@ -0,0 +1,213 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+/*
+ * Round-trips of the disk image formats (disk-format.cpp): a file converted
+ * to another format and back must come out byte for byte the same, and a
+ * disk that a format can't hold must be refused rather than changed.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "disk-format.h"
+#include "drive.h"
+
+namespace {
+
+/* A disk built from a list of sectors, to save in any format */
+class TestDisk : public DiskImage {
+public:
+  struct Sector {
+    DiskSectorId id;
+    std::vector<uint8_t> data;
+  };
+
+  std::string name() const override { return "TEST DISK"; }
+  bool write_protected() const override { return protect; }
+  int media_type() const override { return type; }
+
+  bool get_track(int trk, std::vector<DiskSectorId> &ids) const override {
+    ids.clear();
+    if (trk < 0 || trk >= DISK_FORMAT_NR_TRACK) {
+      return false;
+    }
+    for (const auto &s : track[trk]) {
+      ids.push_back(s.id);
+    }
+    return true;
+  }
+
+  bool read_sector(int trk, int index, std::vector<uint8_t> &data) const override {
+    if (trk < 0 || trk >= DISK_FORMAT_NR_TRACK || index < 0 || (size_t)index >= track[trk].size()) {
+      return false;
+    }
+    data = track[trk][index].data;
+    return true;
+  }
+
+  bool write_sector(int, int, const uint8_t *, size_t) override { return false; }
+
+  /* Sectors 1..sectors of n on the first tracks, each filled by a pattern */
+  void format(int tracks, int sectors, uint8_t n) {
+    for (int trk = 0; trk < tracks; trk++) {
+      for (int r = 1; r <= sectors; r++) {
+        add(trk, {(uint8_t)(trk / 2), (uint8_t)(trk % 2), (uint8_t)r, n, DISK_DENSITY_DOUBLE, DISK_DELETED_FALSE, 0,
+                  (uint16_t)(128 << n)});
+      }
+    }
+  }
+
+  void add(int trk, const DiskSectorId &id) {
+    Sector s{id, std::vector<uint8_t>(id.size)};
+    for (size_t i = 0; i < s.data.size(); i++) {
+      s.data[i] = (uint8_t)(trk * 7 + id.r * 13 + i);
+    }
+    track[trk].push_back(std::move(s));
+  }
+
+  bool protect = false;
+  int type = DISK_TYPE_2D;
+  std::vector<Sector> track[DISK_FORMAT_NR_TRACK];
+};
+
+std::vector<uint8_t> save(const DiskImageFormat *format, const DiskImageSet &disks) {
+  std::vector<uint8_t> file;
+  EXPECT_TRUE(format->save(disks, file)) << format->name();
+  return file;
+}
+
+/* from -> to -> from, which must give the same bytes */
+void expect_round_trip(const DiskImageFormat *from, const std::vector<uint8_t> &file, const DiskImageFormat *to) {
+  std::vector<uint8_t> middle, back;
+  ASSERT_TRUE(disk_format_convert(from, file.data(), file.size(), to, middle)) << from->name() << " to " << to->name();
+  ASSERT_TRUE(disk_format_convert(to, middle.data(), middle.size(), from, back)) << to->name() << " to " << from->name();
+  EXPECT_TRUE(back == file) << from->name() << " -> " << to->name() << " -> " << from->name();
+}
+
+const DiskImageFormat *d88() { return disk_format_d88(); }
+const DiskImageFormat *raw() { return disk_format_by_name("raw"); }
+const DiskImageFormat *qdi() { return disk_format_by_name("qdi"); }
+
+} // namespace
+
+TEST(DiskFormat, Lookup) {
+  ASSERT_NE(raw(), nullptr);
+  ASSERT_NE(qdi(), nullptr);
+  EXPECT_EQ(disk_format_by_name("d88"), d88());
+  EXPECT_EQ(disk_format_by_extension("game.D88"), d88());
+  EXPECT_EQ(disk_format_by_extension("game.2hd"), raw());
+  EXPECT_EQ(disk_format_by_extension("game.qdi"), qdi());
+  EXPECT_EQ(disk_format_by_extension("game.txt"), nullptr);
+}
+
+/* Every raw geometry: raw -> D88 -> raw, and raw -> QDI -> raw */
+TEST(DiskFormat, RawRoundTrip) {
+  const struct {
+    const char *path;
+    int cylinder, sector;
+    uint8_t n;
+    int type;
+  } geometry[] = {
+      {"a.2d", 40, 16, 1, DISK_TYPE_2D},
+      {"a.2dd", 80, 16, 1, DISK_TYPE_2DD},
+      {"a.2hd", 77, 26, 1, DISK_TYPE_2HD},
+      {"b.2hd", 77, 8, 3, DISK_TYPE_2HD},
+  };
+  for (const auto &g : geometry) {
+    std::vector<uint8_t> file((size_t)g.cylinder * 2 * g.sector * (128 << g.n));
+    for (size_t i = 0; i < file.size(); i++) {
+      file[i] = (uint8_t)(i * 31 + i / 4096);
+    }
+    EXPECT_EQ(disk_format_probe(file.data(), file.size(), g.path), raw()) << g.path;
+
+    DiskImageSet disks;
+    ASSERT_TRUE(raw()->open(file.data(), file.size(), disks)) << g.path;
+    EXPECT_EQ(disks[0]->media_type(), g.type) << g.path;
+
+    expect_round_trip(raw(), file, d88());
+    expect_round_trip(raw(), file, qdi());
+  }
+}
+
+/* Sectors raw can't hold survive D88 -> QDI -> D88 unchanged */
+TEST(DiskFormat, D88QdiRoundTrip) {
+  DiskImageSet disks;
+  for (int i = 0; i < 2; i++) {
+    auto disk = std::make_unique<TestDisk>();
+    disk->format(80, 16, 1);
+    disk->type = (i == 0) ? DISK_TYPE_2D : DISK_TYPE_2DD;
+    disk->protect = (i == 1);
+    disk->track[4].clear(); /* Unformatted */
+    disk->track[5].clear();
+    disk->add(5, {2, 1, 0xf5, 3, DISK_DENSITY_DOUBLE, DISK_DELETED_TRUE, 0, 1024});
+    disk->add(5, {2, 1, 0x01, 0, DISK_DENSITY_SINGLE, DISK_DELETED_FALSE, 0xa0, 128});
+    disk->add(5, {2, 1, 0x01, 0, DISK_DENSITY_SINGLE, DISK_DELETED_FALSE, 0, 128}); /* Same ID twice */
+    disk->track[6][3].data.assign(256, 0xe5); /* Stored as a fill byte in QDI */
+    disks.push_back(std::move(disk));
+  }
+
+  std::vector<uint8_t> file = save(d88(), disks);
+  EXPECT_EQ(disk_format_probe(file.data(), file.size(), "x.d88"), d88());
+  expect_round_trip(d88(), file, qdi());
+
+  std::vector<uint8_t> q = save(qdi(), disks);
+  EXPECT_EQ(disk_format_probe(q.data(), q.size(), "x.d88"), qdi()); /* By contents, not by name */
+  expect_round_trip(qdi(), q, d88());
+
+  DiskImageSet back;
+  ASSERT_TRUE(qdi()->open(q.data(), q.size(), back));
+  ASSERT_EQ(back.size(), 2u);
+  EXPECT_EQ(back[0]->name(), "TEST DISK");
+  EXPECT_FALSE(back[0]->write_protected());
+  EXPECT_TRUE(back[1]->write_protected());
+  EXPECT_EQ(back[1]->media_type(), DISK_TYPE_2DD);
+}
+
+/* A disk that doesn't fit a raw geometry is refused */
+TEST(DiskFormat, RawRefusesIrregularDisks) {
+  std::vector<uint8_t> out;
+
+  auto refused = [&](void (*change)(TestDisk &)) {
+    DiskImageSet disks;
+    auto disk = std::make_unique<TestDisk>();
+    disk->format(160, 16, 1);
+    disk->type = DISK_TYPE_2DD;
+    change(*disk);
+    disks.push_back(std::move(disk));
+    return !raw()->save(disks, out);
+  };
+
+  EXPECT_FALSE(refused([](TestDisk &) {}));
+  EXPECT_TRUE(refused([](TestDisk &d) { d.track[10].pop_back(); }));
+  EXPECT_TRUE(refused([](TestDisk &d) { d.track[10][2].id.deleted = DISK_DELETED_TRUE; }));
+  EXPECT_TRUE(refused([](TestDisk &d) { d.track[10][2].id.status = 0xa0; }));
+  EXPECT_TRUE(refused([](TestDisk &d) { d.track[10][2].data.resize(128); }));
+  EXPECT_TRUE(refused([](TestDisk &d) { d.add(161, {80, 1, 1, 1, DISK_DENSITY_DOUBLE, DISK_DELETED_FALSE, 0, 256}); }));
+
+  DiskImageSet two;
+  two.push_back(std::make_unique<TestDisk>());
+  two.push_back(std::make_unique<TestDisk>());
+  static_cast<TestDisk &>(*two[0]).format(80, 16, 1);
+  static_cast<TestDisk &>(*two[1]).format(80, 16, 1); /* Each fits 2D */
+  EXPECT_FALSE(raw()->save(two, out)); /* One disk per file */
+}
+
+/* Damaged files are refused, not read past their end */
+TEST(DiskFormat, BrokenFiles) {
+  DiskImageSet disks;
+  auto disk = std::make_unique<TestDisk>();
+  disk->format(4, 16, 1);
+  disks.push_back(std::move(disk));
+
+  for (const DiskImageFormat *format : {d88(), qdi()}) {
+    std::vector<uint8_t> file = save(format, disks);
+    for (size_t cut : {file.size() / 2, file.size() - 1}) {
+      DiskImageSet opened;
+      std::vector<uint8_t> part(file.begin(), file.begin() + cut);
+      EXPECT_FALSE(format->open(part.data(), part.size(), opened)) << format->name() << " cut at " << cut;
+    }
+  }
+}
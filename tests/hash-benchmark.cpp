@@ -0,0 +1,59 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+/*
+ * Cost of the frame hash log (-hashlog): the hash64() calls that
+ * hash_log_frame() makes every frame, for a few machine configurations.
+ * The time is per frame; 2% of a 60Hz frame is 333us.
+ *
+ * Extended RAM is hashed bank by bank, and only the banks written since the
+ * previous frame are hashed again: usually just the one the CPU can write.
+ * The "all" cases are the frames after a reset or a state load, which hash
+ * every bank.
+ *
+ *   hash-benchmark --benchmark_repetitions=5
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#include "hash64.h"
+
+namespace {
+
+/* Main RAM, high RAM, VRAM, sub RAM and the FDC data buffer */
+constexpr size_t BASE_SIZE = 0x10000 + 0x1000 + 4 * 0x4000 + 0x4000 + 0x4000;
+constexpr size_t ADPCM_SIZE = 0x40000; /* SOUND_II */
+constexpr size_t BANK_SIZE = 0x8000;   /* 4 banks per card of extended RAM */
+
+void BM_HashFrame(benchmark::State &state, bool sound2, int extram, bool all_banks) {
+  size_t banks = extram * 4;
+  size_t size = BASE_SIZE + (sound2 ? ADPCM_SIZE : 0);
+  std::vector<uint8_t> memory(size + BANK_SIZE * banks);
+  for (size_t i = 0; i < memory.size(); i++) {
+    memory[i] = (uint8_t)(i * 31 + i / 4096);
+  }
+  std::vector<uint64_t> bank_hash(banks);
+
+  for (auto _ : state) {
+    uint64_t h = hash64(memory.data(), size);
+    for (size_t i = 0; i < banks; i++) {
+      if (all_banks || i == 0) {
+        bank_hash[i] = hash64(&memory[size + BANK_SIZE * i], BANK_SIZE);
+      }
+    }
+    if (banks) {
+      h = hash64(bank_hash.data(), bank_hash.size() * 8, h);
+    }
+    benchmark::DoNotOptimize(h);
+  }
+}
+
+BENCHMARK_CAPTURE(BM_HashFrame, base, false, 0, false)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_HashFrame, sound2, true, 0, false)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_HashFrame, sound2_extram4, true, 4, false)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_HashFrame, sound2_extram64, true, 64, false)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_HashFrame, sound2_extram4_all, true, 4, true)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_HashFrame, sound2_extram64_all, true, 64, true)->Unit(benchmark::kMicrosecond);
+
+} // namespace
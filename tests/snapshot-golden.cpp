@@ -0,0 +1,375 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+/*
+ * Golden image tests of the snapshot renderers (screen-snapshot.cpp).
+ *
+ * A fixed screen is set up: text written to text VRAM and shown through the
+ * CRTC/DMAC emulation (crtcdmac.cpp) with a test font, over colour bars and
+ * a checker pattern in VRAM. It is drawn with every function of the
+ * snapshot lists (normal, skip line and interlace, for colour, mono, 400
+ * line and undisplayed VRAM, 80/40 columns and 25/20 lines), and the index
+ * image is compared with tests/golden/<list>-<mode>.rle.
+ *
+ * Environment:
+ *   QUASI88_GOLDEN_TOLERANCE=<n>  Pass when at most n pixels differ [0]
+ *   QUASI88_GOLDEN_UPDATE=1       Write the goldens instead of comparing
+ *
+ * On a mismatch, <name>.actual.ppm and <name>.diff.ppm (differing pixels in
+ * red over a dimmed golden) are written to golden-diff/ in the working
+ * directory.
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "quasi88.h"
+
+#include "crtcdmac.h"
+#include "memory.h"
+#include "screen-func.h"
+#include "screen.h"
+#include "suspend.h"
+
+/* What the renderers and the CRTC use from the rest of the core */
+
+static uint8_t test_ram[0x10000];
+static uint8_t test_vram[0x4000][4];
+static uint8_t test_font[0x200 * 8 + 8];
+
+uint8_t *main_ram = test_ram;
+uint8_t (*main_vram)[4] = test_vram;
+uint8_t *font_rom = test_font;
+uint8_t grph_ctrl;
+uint8_t grph_pile;
+int screen_dirty_all;
+int screen_dirty_palette;
+char screen_snapshot[640 * 400];
+
+void frameskip_blink_reset() {}
+int statesave_table(const char[4], T_SUSPEND_W *) { return STATE_OK; }
+int stateload_table(const char[4], T_SUSPEND_W *) { return STATE_OK; }
+
+namespace {
+
+constexpr int WIDTH = 640;
+constexpr int HEIGHT = 400;
+constexpr size_t PIXELS = WIDTH * HEIGHT;
+
+/*
+ * Golden file: "Q88GOLD1", then the image as runs of
+ * (length - 1, palette index) byte pairs, from the top left.
+ */
+constexpr char GOLDEN_MAGIC[8] = {'Q', '8', '8', 'G', 'O', 'L', 'D', '1'};
+
+bool save_golden(const std::string &path, const std::vector<uint8_t> &image) {
+  std::vector<uint8_t> file(GOLDEN_MAGIC, GOLDEN_MAGIC + sizeof(GOLDEN_MAGIC));
+  for (size_t i = 0; i < image.size();) {
+    size_t n = 1;
+    while (n < 256 && i + n < image.size() && image[i + n] == image[i]) {
+      n++;
+    }
+    file.push_back((uint8_t)(n - 1));
+    file.push_back(image[i]);
+    i += n;
+  }
+  FILE *fp = fopen(path.c_str(), "wb");
+  if (fp == nullptr) {
+    return false;
+  }
+  bool ok = (fwrite(file.data(), 1, file.size(), fp) == file.size());
+  return (fclose(fp) == 0) && ok;
+}
+
+bool load_golden(const std::string &path, std::vector<uint8_t> &image) {
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (fp == nullptr) {
+    return false;
+  }
+  std::vector<uint8_t> file;
+  uint8_t block[4096];
+  size_t n;
+  while ((n = fread(block, 1, sizeof(block), fp)) > 0) {
+    file.insert(file.end(), block, block + n);
+  }
+  fclose(fp);
+
+  if (file.size() < sizeof(GOLDEN_MAGIC) || memcmp(file.data(), GOLDEN_MAGIC, sizeof(GOLDEN_MAGIC)) != 0) {
+    return false;
+  }
+  image.clear();
+  for (size_t i = sizeof(GOLDEN_MAGIC); i + 1 < file.size(); i += 2) {
+    image.insert(image.end(), file[i] + 1, file[i + 1]);
+  }
+  return image.size() == PIXELS;
+}
+
+/* Indices 0-7 are VRAM colours, 8-15 text colours (both GRB), 16 black */
+void index_rgb(uint8_t index, uint8_t rgb[3]) {
+  if (index >= 16) {
+    rgb[0] = rgb[1] = rgb[2] = 0;
+    return;
+  }
+  uint8_t level = (index & 8) ? 0xff : 0xc0;
+  rgb[0] = (index & 2) ? level : 0;
+  rgb[1] = (index & 4) ? level : 0;
+  rgb[2] = (index & 1) ? level : 0;
+}
+
+bool save_ppm(const std::string &path, const std::vector<uint8_t> &rgb) {
+  FILE *fp = fopen(path.c_str(), "wb");
+  if (fp == nullptr) {
+    return false;
+  }
+  fprintf(fp, "P6\n%d %d\n255\n", WIDTH, HEIGHT);
+  bool ok = (fwrite(rgb.data(), 1, rgb.size(), fp) == rgb.size());
+  return (fclose(fp) == 0) && ok;
+}
+
+void save_diff(const std::string &name, const std::vector<uint8_t> &actual, const std::vector<uint8_t> &golden) {
+  std::vector<uint8_t> a(PIXELS * 3), d(PIXELS * 3);
+  for (size_t i = 0; i < PIXELS; i++) {
+    index_rgb(actual[i], &a[i * 3]);
+    if (actual[i] != golden[i]) {
+      d[i * 3] = 0xff;
+      d[i * 3 + 1] = d[i * 3 + 2] = 0;
+    } else {
+      index_rgb(golden[i], &d[i * 3]);
+      for (int c = 0; c < 3; c++) {
+        d[i * 3 + c] /= 4;
+      }
+    }
+  }
+  std::error_code ec;
+  std::filesystem::create_directories("golden-diff", ec);
+  save_ppm("golden-diff/" + name + ".actual.ppm", a);
+  save_ppm("golden-diff/" + name + ".diff.ppm", d);
+}
+
+/*
+ * Test font: the real font ROM can't be shipped. Characters get a box
+ * with the code in binary inside, graphic characters a 2x4 block pattern.
+ */
+void make_font() {
+  for (int c = 0; c < 0x100; c++) {
+    uint8_t *p = &test_font[c * 8];
+    p[0] = 0x7e;
+    for (int r = 1; r < 7; r++) {
+      p[r] = 0x42 | ((c >> (r - 1)) & 1 ? 0x18 : 0);
+    }
+    p[7] = (c & 0x40) ? 0x7e : 0x00;
+
+    uint8_t *g = &test_font[(c | 0x100) * 8];
+    for (int r = 0; r < 8; r++) {
+      int bits = c >> ((r / 2) * 2);
+      g[r] = ((bits & 1) ? 0xf0 : 0) | ((bits & 2) ? 0x0f : 0);
+    }
+  }
+}
+
+constexpr uint16_t TVRAM = 0xf3c8;
+constexpr int BYTES_PER_LINE = 120; /* 80 characters, 20 attribute pairs */
+
+void put_text(int row, int column, const char *text) {
+  memcpy(&test_ram[TVRAM + row * BYTES_PER_LINE + column], text, strlen(text));
+}
+
+/* Set the attribute pairs of a row (the rest are left unused) */
+void put_attrs(int row, std::initializer_list<std::pair<int, int>> attrs) {
+  uint8_t *p = &test_ram[TVRAM + row * BYTES_PER_LINE + 80];
+  for (int i = 0; i < 20; i++) {
+    p[i * 2] = 80;
+    p[i * 2 + 1] = 0xe8;
+  }
+  int i = 0;
+  for (auto &a : attrs) {
+    p[i * 2] = a.first;
+    p[i * 2 + 1] = a.second;
+    i++;
+  }
+}
+
+void make_text() {
+  for (int row = 0; row < 25; row++) {
+    memset(&test_ram[TVRAM + row * BYTES_PER_LINE], 0, 80);
+    put_attrs(row, {{0, 0xe8}});
+  }
+
+  put_text(0, 0, "QUASI88 GOLDEN IMAGE  0123456789 ABCDEFGHIJKLMNOPQRSTUVWXYZ abcdefghijklmnopqrst");
+
+  put_text(2, 0, "COLOURS   BLUE      RED       MAGENTA   GREEN     CYAN      YELLOW    WHITE");
+  put_attrs(2, {{0, 0x08}, {10, 0x28}, {20, 0x48}, {30, 0x68}, {40, 0x88}, {50, 0xa8}, {60, 0xc8}, {70, 0xe8}});
+
+  /* Decorations last until changed, so the row ends undecorated */
+  put_text(4, 0, "REVERSE         UPPER LINE      UNDER LINE      SECRET          NORMAL          ");
+  put_attrs(4, {{0, 0x04}, {16, 0x10}, {32, 0x20}, {48, 0x01}, {64, 0x00}});
+
+  for (int i = 0; i < 80; i++) {
+    test_ram[TVRAM + 6 * BYTES_PER_LINE + i] = (uint8_t)(i * 3 + 1);
+  }
+  put_attrs(6, {{0, 0xf8}, {40, 0x98}});
+
+  put_text(19, 0, "LINE 20 (LAST LINE OF 20)");
+  put_text(24, 0, "LINE 25 (LAST LINE OF 25)");
+  put_attrs(24, {{0, 0xc8}});
+}
+
+/* Colour bars in the top half, a checker with a diagonal in the bottom */
+int vram_color(int x, int y) {
+  if (y < 100) {
+    return x / 80;
+  }
+  if (x / 3 == y || x / 3 == y - 100) {
+    return 7;
+  }
+  return ((x / 32) + (y / 16)) & 7;
+}
+
+void make_vram() {
+  for (int y = 0; y < 200; y++) {
+    for (int x = 0; x < 640; x += 8) {
+      uint8_t plane[3] = {};
+      for (int b = 0; b < 8; b++) {
+        int c = vram_color(x + b, y);
+        for (int p = 0; p < 3; p++) {
+          if (c & (1 << p)) {
+            plane[p] |= 0x80 >> b;
+          }
+        }
+      }
+      for (int p = 0; p < 3; p++) {
+        test_vram[y * 80 + x / 8][p] = plane[p];
+      }
+    }
+  }
+}
+
+/* Show the text VRAM through the CRTC and DMAC, as BASIC does */
+void setup_crtc(int lines25) {
+  crtc_out_command(0x00); /* Reset */
+  crtc_out_parameter(0xce);
+  crtc_out_parameter(lines25 ? 0x98 : 0x93);
+  crtc_out_parameter(0x6f);
+  crtc_out_parameter(0x58);
+  crtc_out_parameter(0x53);
+  crtc_out_command(0x80); /* No cursor */
+
+  dmac_init();
+  dmac_out_mode(0x04);    /* Channel 2 (text) on */
+  crtc_out_command(0x43); /* Interrupt mask */
+  crtc_out_command(0x20); /* Start display */
+}
+
+const char *const LIST_NAMES[] = {"normal", "skipln", "itlace"};
+const char *const VRAM_NAMES[] = {"C", "M", "U", "H"};
+const char *const TEXT_NAMES[] = {"80x25", "80x20", "40x25", "40x20"};
+
+struct Mode {
+  int list;
+  int vram;
+  int text;
+};
+
+std::string mode_name(const Mode &m) {
+  return std::string(LIST_NAMES[m.list]) + "-" + VRAM_NAMES[m.vram] + TEXT_NAMES[m.text];
+}
+
+void PrintTo(const Mode &m, std::ostream *os) { *os << mode_name(m); }
+
+std::vector<uint8_t> render(const Mode &m) {
+  static const uint8_t grph[] = {
+      GRPH_CTRL_VDISP | GRPH_CTRL_COLOR, /* V_COLOR */
+      GRPH_CTRL_VDISP | GRPH_CTRL_200,   /* V_MONO */
+      GRPH_CTRL_200,                     /* V_UNDISP */
+      GRPH_CTRL_VDISP,                   /* V_HIRESO */
+  };
+  grph_ctrl = grph[m.vram];
+  grph_pile = 0;
+
+  make_font();
+  make_text();
+  make_vram();
+  setup_crtc(m.text == V_80x25 || m.text == V_40x25);
+  crtc_make_text_attr();
+
+  memset(screen_snapshot, 16, sizeof(screen_snapshot));
+  int (*(*list)[4][2])(void);
+  switch (m.list) {
+  case 0:
+    list = snapshot_list_normal;
+    break;
+  case 1:
+    snapshot_clear(); /* Leaves the skipped lines black */
+    list = snapshot_list_skipln;
+    break;
+  default:
+    list = snapshot_list_itlace;
+    break;
+  }
+  (list[m.vram][m.text][V_ALL])();
+
+  return std::vector<uint8_t>(screen_snapshot, screen_snapshot + sizeof(screen_snapshot));
+}
+
+class SnapshotGolden : public ::testing::TestWithParam<Mode> {};
+
+TEST_P(SnapshotGolden, MatchesGolden) {
+  const Mode &m = GetParam();
+  std::string name = mode_name(m);
+  std::string path = std::string(GOLDEN_DIR) + "/" + name + ".rle";
+
+  std::vector<uint8_t> actual = render(m);
+
+  const char *update = getenv("QUASI88_GOLDEN_UPDATE");
+  if (update && atoi(update)) {
+    ASSERT_TRUE(save_golden(path, actual)) << "can't write " << path;
+    return;
+  }
+
+  std::vector<uint8_t> golden;
+  ASSERT_TRUE(load_golden(path, golden)) << "can't read " << path << " (QUASI88_GOLDEN_UPDATE=1 makes it)";
+
+  size_t differ = 0;
+  size_t first = PIXELS;
+  for (size_t i = 0; i < PIXELS; i++) {
+    if (actual[i] != golden[i]) {
+      if (differ++ == 0) {
+        first = i;
+      }
+    }
+  }
+
+  const char *tolerance = getenv("QUASI88_GOLDEN_TOLERANCE");
+  size_t allowed = tolerance ? strtoul(tolerance, nullptr, 0) : 0;
+  if (differ > allowed) {
+    save_diff(name, actual, golden);
+  }
+  EXPECT_LE(differ, allowed) << name << ": " << differ << " pixels differ, the first at (" << first % WIDTH << ","
+                             << first / WIDTH << "); see golden-diff/" << name << ".diff.ppm";
+}
+
+std::vector<Mode> all_modes() {
+  std::vector<Mode> modes;
+  for (int list = 0; list < 3; list++) {
+    for (int vram = 0; vram < V_VRAM_MODE; vram++) {
+      for (int text = 0; text < V_TEXT_MODE; text++) {
+        modes.push_back({list, vram, text});
+      }
+    }
+  }
+  return modes;
+}
+
+INSTANTIATE_TEST_SUITE_P(AllModes, SnapshotGolden, ::testing::ValuesIn(all_modes()),
+                         [](const ::testing::TestParamInfo<Mode> &info) {
+                           std::string name = mode_name(info.param);
+                           name[name.find('-')] = '_';
+                           return name;
+                         });
+
+} // namespace
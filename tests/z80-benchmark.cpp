@@ -0,0 +1,109 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+
+/*
+ * Emulation speed of z80_emu() on the flat 64K machine, for a few
+ * instruction mixes. Each program loops forever from 0100h; the "states"
+ * counter is emulated states per second, so "640M/s" means the emulator
+ * runs at 640 MHz (the PC-8801 runs at 4 or 8 MHz).
+ *
+ *   z80-benchmark --benchmark_repetitions=5
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#include "z80-harness.h"
+
+using namespace Z80Test;
+
+namespace {
+
+/* Register arithmetic and logic with a DJNZ loop */
+const std::vector<uint8_t> MIX_ALU = {
+    0x06, 0x00,       /* 0100: LD   B,0        */
+    0x80,             /* 0102: ADD  A,B        */
+    0x89,             /*       ADC  A,C        */
+    0x92,             /*       SUB  D          */
+    0xa3,             /*       AND  E          */
+    0xb4,             /*       OR   H          */
+    0xad,             /*       XOR  L          */
+    0xba,             /*       CP   D          */
+    0x3c,             /*       INC  A          */
+    0x0d,             /*       DEC  C          */
+    0x17,             /*       RLA             */
+    0x10, 0xf4,       /*       DJNZ 0102h      */
+    0xc3, 0x00, 0x01, /*       JP   0100h      */
+};
+
+/* Block copy and search, 1KB each */
+const std::vector<uint8_t> MIX_BLOCK = {
+    0x21, 0x00, 0x80, /* 0100: LD   HL,8000h   */
+    0x11, 0x00, 0x90, /*       LD   DE,9000h   */
+    0x01, 0x00, 0x04, /*       LD   BC,0400h   */
+    0xed, 0xb0,       /*       LDIR            */
+    0x21, 0x00, 0x90, /*       LD   HL,9000h   */
+    0x01, 0x00, 0x04, /*       LD   BC,0400h   */
+    0x3e, 0x55,       /*       LD   A,55h      */
+    0xed, 0xb1,       /*       CPIR            */
+    0xc3, 0x00, 0x01, /*       JP   0100h      */
+};
+
+/* IX-indexed loads and bit operations (DD, DD CB and CB prefixes) */
+const std::vector<uint8_t> MIX_INDEXED = {
+    0xdd, 0x21, 0x00, 0x80, /* 0100: LD   IX,8000h   */
+    0x06, 0x40,             /*       LD   B,64       */
+    0xdd, 0x7e, 0x00,       /* 0106: LD   A,(IX+0)   */
+    0xdd, 0x86, 0x01,       /*       ADD  A,(IX+1)   */
+    0xdd, 0x77, 0x02,       /*       LD   (IX+2),A   */
+    0xdd, 0xcb, 0x03, 0xc6, /*       SET  0,(IX+3)   */
+    0xdd, 0xcb, 0x03, 0x46, /*       BIT  0,(IX+3)   */
+    0xdd, 0xcb, 0x03, 0x86, /*       RES  0,(IX+3)   */
+    0xcb, 0x17,             /*       RL   A          */
+    0xcb, 0x3f,             /*       SRL  A          */
+    0xdd, 0x23,             /*       INC  IX         */
+    0x10, 0xe3,             /*       DJNZ 0106h      */
+    0xc3, 0x00, 0x01,       /*       JP   0100h      */
+};
+
+/* Calls, returns and the stack */
+const std::vector<uint8_t> MIX_CALL = {
+    0x31, 0x00, 0xf0, /* 0100: LD   SP,F000h   */
+    0x06, 0x00,       /*       LD   B,0        */
+    0xcd, 0x20, 0x01, /* 0105: CALL 0120h      */
+    0xc5,             /*       PUSH BC         */
+    0xe5,             /*       PUSH HL         */
+    0xe1,             /*       POP  HL         */
+    0xc1,             /*       POP  BC         */
+    0x10, 0xf7,       /*       DJNZ 0105h      */
+    0xc3, 0x00, 0x01, /*       JP   0100h      */
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0xd5,             /* 0120: PUSH DE         */
+    0x23,             /*       INC  HL         */
+    0xeb,             /*       EX   DE,HL      */
+    0xd1,             /*       POP  DE         */
+    0xc8,             /*       RET  Z          */
+    0xc9,             /*       RET             */
+};
+
+void BM_Z80(benchmark::State &state, const std::vector<uint8_t> &program) {
+  reset();
+  for (size_t i = 0; i < program.size(); i++) {
+    memory[0x0100 + i] = program[i];
+  }
+  cpu.PC.W = 0x0100;
+  cpu.break_if_halt = false;
+
+  int64_t states = 0;
+  for (auto _ : state) {
+    states += z80_emu(&cpu, 100000);
+  }
+  state.counters["states"] = benchmark::Counter(states, benchmark::Counter::kIsRate, benchmark::Counter::kIs1000);
+}
+
+BENCHMARK_CAPTURE(BM_Z80, alu, MIX_ALU);
+BENCHMARK_CAPTURE(BM_Z80, block, MIX_BLOCK);
+BENCHMARK_CAPTURE(BM_Z80, indexed, MIX_INDEXED);
+BENCHMARK_CAPTURE(BM_Z80, call, MIX_CALL);
+
+} // namespace
@@ -0,0 +1,90 @@
+/* SPDX-License-Identifier: BSD-3-Clause */
+#pragma once
+
+/*
+ * A flat 64K machine around z80_emu() for the Z80 tests and benchmarks.
+ *
+ * The z80arch callbacks read and write one 64K array; there are no wait
+ * states, banks or interrupts. IN returns io_input[port], and OUT is
+ * recorded in io_port/io_data and passed to io_hook when it is set.
+ */
+
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+
+#include "z80.h"
+
+namespace Z80Test {
+
+inline z80arch cpu;
+inline uint8_t memory[0x10000];
+inline uint8_t io_input[0x100];
+inline int io_port;
+inline uint8_t io_data;
+inline void (*io_hook)(uint8_t port, uint8_t data);
+
+inline uint8_t mem_read(uint16_t addr) { return memory[addr]; }
+inline void mem_write(uint16_t addr, uint8_t data) { memory[addr] = data; }
+inline uint8_t io_read(uint8_t port) { return io_input[port]; }
+inline void io_write(uint8_t port, uint8_t data) {
+  io_port = port;
+  io_data = data;
+  if (io_hook) {
+    io_hook(port, data);
+  }
+}
+
+/* No interrupts: the next check is as far away as possible */
+inline void intr_update() { cpu.icount = INT_MAX / 2; }
+inline int intr_ack() { return -1; }
+
+/* Clear the memory and reset the CPU. PC is 0 */
+inline void reset() {
+  /* z80.cpp logs unknown instructions to "z80" */
+  if (spdlog::get("z80") == nullptr) {
+    spdlog::stdout_color_mt("z80");
+  }
+
+  memset(memory, 0, sizeof(memory));
+  memset(io_input, 0xff, sizeof(io_input));
+  io_port = -1;
+  io_data = 0;
+  io_hook = nullptr;
+
+  z80_reset(&cpu);
+  cpu.fetch = mem_read;
+  cpu.mem_read = mem_read;
+  cpu.mem_write = mem_write;
+  cpu.io_read = io_read;
+  cpu.io_write = io_write;
+  cpu.intr_update = intr_update;
+  cpu.intr_ack = intr_ack;
+  cpu.log = false;
+  cpu.break_if_halt = true;
+  intr_update();
+}
+
+inline void load(uint16_t addr, std::initializer_list<uint8_t> bytes) {
+  for (uint8_t b : bytes) {
+    memory[addr++] = b;
+  }
+}
+
+/* Execute one instruction. Returns its states */
+inline int step() { return z80_emu(&cpu, 1); }
+
+/* Execute until HALT, for at most max_states. Returns the states */
+inline long run_until_halt(long max_states) {
+  long total = 0;
+  while (!cpu.HALT && total < max_states) {
+    total += z80_emu(&cpu, 10000);
+  }
+  return total;
+}
+
+} // namespace Z80Test